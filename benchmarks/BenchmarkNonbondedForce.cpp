@@ -0,0 +1,311 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This program measures the speed of NonbondedForce on one or more platforms, for a range of system sizes,
+ * nonbonded methods, and options.  The results are written as JSON.  Run it with --help to see the options.
+ */
+
+#ifdef WIN32
+  #define _USE_MATH_DEFINES // Needed to get M_PI
+#endif
+#include "NonbondedForce.h"
+#include "openmm/Context.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ExamplePlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerExampleReferenceKernelFactories();
+
+/**
+ * The number of particles per cubic nm, roughly that of water.
+ */
+static const double ParticleDensity = 100.0;
+
+/**
+ * The time step used to convert evaluations per second to ns/day, in ps.
+ */
+static const double TimeStep = 0.002;
+
+static const double CutoffDistance = 0.9;
+static const double SwitchingDistance = 0.8;
+
+struct Options {
+    vector<string> platforms;
+    vector<int> sizes;
+    vector<NonbondedForce::NonbondedMethod> methods;
+    double minTime;
+    int maxEvaluations;
+    string output;
+};
+
+struct Result {
+    string platform;
+    int numParticles;
+    NonbondedForce::NonbondedMethod method;
+    bool useSwitch, includeEnergy;
+    int evaluations;
+    double seconds, pairs;
+};
+
+static const char* methodName(NonbondedForce::NonbondedMethod method) {
+    switch (method) {
+        case NonbondedForce::NoCutoff:
+            return "NoCutoff";
+        case NonbondedForce::CutoffNonPeriodic:
+            return "CutoffNonPeriodic";
+        case NonbondedForce::CutoffPeriodic:
+            return "CutoffPeriodic";
+        case NonbondedForce::Ewald:
+            return "Ewald";
+        case NonbondedForce::PME:
+            return "PME";
+        case NonbondedForce::LJPME:
+            return "LJPME";
+    }
+    return "";
+}
+
+static NonbondedForce::NonbondedMethod parseMethod(const string& name) {
+    for (int i = NonbondedForce::NoCutoff; i <= NonbondedForce::LJPME; i++)
+        if (name == methodName((NonbondedForce::NonbondedMethod) i))
+            return (NonbondedForce::NonbondedMethod) i;
+    throw OpenMMException("Unknown nonbonded method: "+name);
+}
+
+static vector<string> splitList(const string& list) {
+    vector<string> items;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ','))
+        if (item.size() > 0)
+            items.push_back(item);
+    return items;
+}
+
+/**
+ * Build a box of three-site molecules at roughly the density of water, with exclusions between the
+ * particles of each molecule.
+ */
+static void createSystem(int numParticles, System& system, NonbondedForce*& force, vector<Vec3>& positions) {
+    int numMolecules = numParticles/3;
+    double boxSize = cbrt(3*numMolecules/ParticleDensity);
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    force = new NonbondedForce();
+    system.addForce(force);
+    int gridSize = (int) ceil(cbrt((double) numMolecules));
+    double spacing = boxSize/gridSize;
+    mt19937 random(0);
+    uniform_real_distribution<double> jitter(-0.05*spacing, 0.05*spacing);
+    positions.clear();
+    for (int i = 0; i < numMolecules; i++) {
+        Vec3 center((i%gridSize+0.5)*spacing, ((i/gridSize)%gridSize+0.5)*spacing, (i/(gridSize*gridSize)+0.5)*spacing);
+        center += Vec3(jitter(random), jitter(random), jitter(random));
+        for (int j = 0; j < 3; j++) {
+            system.addParticle(j == 0 ? 16.0 : 1.0);
+            positions.push_back(center+Vec3(j == 1 ? 0.1 : 0.0, j == 2 ? 0.1 : 0.0, 0.0));
+        }
+        force->addParticle(-0.8, 0.315, 0.65);
+        force->addParticle(0.4, 0.1, 0.0);
+        force->addParticle(0.4, 0.1, 0.0);
+        force->addException(3*i, 3*i+1, 0.0, 1.0, 0.0);
+        force->addException(3*i, 3*i+2, 0.0, 1.0, 0.0);
+        force->addException(3*i+1, 3*i+2, 0.0, 1.0, 0.0);
+    }
+}
+
+/**
+ * Estimate the number of pairs whose interaction is computed directly in each evaluation.
+ */
+static double countPairs(int numParticles, NonbondedForce::NonbondedMethod method) {
+    double allPairs = 0.5*numParticles*(numParticles-1.0);
+    if (method == NonbondedForce::NoCutoff)
+        return allPairs;
+    double cutoffVolume = 4.0*M_PI*CutoffDistance*CutoffDistance*CutoffDistance/3.0;
+    return min(allPairs, 0.5*numParticles*ParticleDensity*cutoffVolume);
+}
+
+static Result runBenchmark(Platform& platform, int numParticles, NonbondedForce::NonbondedMethod method, bool useSwitch, bool includeEnergy, const Options& options) {
+    System system;
+    NonbondedForce* force;
+    vector<Vec3> positions;
+    createSystem(numParticles, system, force, positions);
+    force->setNonbondedMethod(method);
+    force->setCutoffDistance(CutoffDistance);
+    force->setUseSwitchingFunction(useSwitch);
+    force->setSwitchingDistance(SwitchingDistance);
+    VerletIntegrator integrator(TimeStep);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    int types = State::Forces | (includeEnergy ? State::Energy : 0);
+
+    // The first evaluation includes initialization, so exclude it from the timing.
+
+    context.getState(types);
+    Result result;
+    result.platform = platform.getName();
+    result.numParticles = system.getNumParticles();
+    result.method = method;
+    result.useSwitch = useSwitch;
+    result.includeEnergy = includeEnergy;
+    result.pairs = countPairs(result.numParticles, method);
+    result.evaluations = 0;
+    auto start = chrono::steady_clock::now();
+    do {
+        context.getState(types);
+        result.evaluations++;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    } while (result.seconds < options.minTime && result.evaluations < options.maxEvaluations);
+    return result;
+}
+
+static void writeResults(ostream& out, const vector<Result>& results) {
+    out << "{\n";
+    out << "  \"benchmark\": \"NonbondedForce\",\n";
+    out << "  \"openmmVersion\": \"" << Platform::getOpenMMVersion() << "\",\n";
+    out << "  \"results\": [";
+    for (int i = 0; i < (int) results.size(); i++) {
+        const Result& r = results[i];
+        double evaluationsPerSecond = r.evaluations/r.seconds;
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"platform\": \"" << r.platform << "\", ";
+        out << "\"numParticles\": " << r.numParticles << ", ";
+        out << "\"method\": \"" << methodName(r.method) << "\", ";
+        out << "\"switchingFunction\": " << (r.useSwitch ? "true" : "false") << ", ";
+        out << "\"energy\": " << (r.includeEnergy ? "true" : "false") << ", ";
+        out << "\"evaluations\": " << r.evaluations << ", ";
+        out << "\"secondsPerEvaluation\": " << r.seconds/r.evaluations << ", ";
+        out << "\"nsPerDay\": " << evaluationsPerSecond*TimeStep*86400.0/1000.0 << ", ";
+        out << "\"pairsPerSecond\": " << r.pairs*evaluationsPerSecond << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void printUsage() {
+    cout << "Usage: BenchmarkNonbondedForce [options]\n";
+    cout << "  --platforms=A,B       platforms to benchmark (default: Reference)\n";
+    cout << "  --sizes=N,M           numbers of particles (default: 1500,6000)\n";
+    cout << "  --methods=A,B         nonbonded methods (default: NoCutoff,CutoffPeriodic,Ewald,PME,LJPME)\n";
+    cout << "  --min-time=T          minimum time in seconds to spend on each case (default: 1)\n";
+    cout << "  --max-evaluations=N   maximum number of evaluations for each case (default: 1000)\n";
+    cout << "  --plugins=DIR         load OpenMM plugins from a directory before running\n";
+    cout << "  --output=FILE         write the results to a file instead of standard output\n";
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options;
+        options.platforms.push_back("Reference");
+        options.sizes = {1500, 6000};
+        options.methods = {NonbondedForce::NoCutoff, NonbondedForce::CutoffPeriodic, NonbondedForce::Ewald, NonbondedForce::PME, NonbondedForce::LJPME};
+        options.minTime = 1.0;
+        options.maxEvaluations = 1000;
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            size_t split = arg.find('=');
+            string name = arg.substr(0, split);
+            string value = (split == string::npos ? "" : arg.substr(split+1));
+            if (name == "--help") {
+                printUsage();
+                return 0;
+            }
+            else if (name == "--platforms")
+                options.platforms = splitList(value);
+            else if (name == "--sizes") {
+                options.sizes.clear();
+                for (const string& size : splitList(value))
+                    options.sizes.push_back(atoi(size.c_str()));
+            }
+            else if (name == "--methods") {
+                options.methods.clear();
+                for (const string& method : splitList(value))
+                    options.methods.push_back(parseMethod(method));
+            }
+            else if (name == "--min-time")
+                options.minTime = atof(value.c_str());
+            else if (name == "--max-evaluations")
+                options.maxEvaluations = atoi(value.c_str());
+            else if (name == "--plugins")
+                Platform::loadPluginsFromDirectory(value);
+            else if (name == "--output")
+                options.output = value;
+            else {
+                printUsage();
+                return 1;
+            }
+        }
+        registerExampleReferenceKernelFactories();
+        vector<Result> results;
+        for (const string& platformName : options.platforms) {
+            Platform& platform = Platform::getPlatformByName(platformName);
+            for (int size : options.sizes)
+                for (NonbondedForce::NonbondedMethod method : options.methods)
+                    for (int useSwitch = 0; useSwitch < 2; useSwitch++) {
+                        // The switching function has no effect without a cutoff.
+
+                        if (useSwitch && method == NonbondedForce::NoCutoff)
+                            continue;
+                        for (int includeEnergy = 0; includeEnergy < 2; includeEnergy++) {
+                            results.push_back(runBenchmark(platform, size, method, useSwitch, includeEnergy, options));
+                            const Result& r = results.back();
+                            cerr << platformName << " " << r.numParticles << " " << methodName(method) << (useSwitch ? " switch" : "") <<
+                                    (includeEnergy ? " energy" : "") << ": " << 1000.0*r.seconds/r.evaluations << " ms" << endl;
+                        }
+                    }
+        }
+        if (options.output.size() > 0) {
+            ofstream out(options.output.c_str());
+            writeResults(out, results);
+        }
+        else
+            writeResults(cout, results);
+    }
+    catch (const exception& e) {
+        cerr << "exception: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
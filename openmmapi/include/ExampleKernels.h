@@ -35,9 +35,12 @@
 #include "ExampleForce.h"
 #include "NonbondedForce.h"
 #include "openmm/KernelImpl.h"
+#include "openmm/OpenMMException.h"
 #include "openmm/Platform.h"
 #include "openmm/System.h"
+#include <map>
 #include <string>
+#include <vector>
 
 namespace ExamplePlugin {
 
@@ -164,17 +167,19 @@ public:
         LJPME = 5
     };
     static std::string Name() {
-        return "CalcNonbondedForce";
+        return "CalcExampleNonbondedForce";
     }
     CalcNonbondedForceKernel(std::string name, const OpenMM::Platform& platform) : OpenMM::KernelImpl(name, platform) {
     }
     /**
      * Initialize the kernel.
      * 
-     * @param system     the System this kernel will be applied to
-     * @param force      the NonbondedForce this kernel will be used for
+     * @param system            the System this kernel will be applied to
+     * @param force             the NonbondedForce this kernel will be used for
+     * @param sortedExclusions  the pair of particles involved in every exception, with the smaller index first, sorted in
+     *                          ascending order.  NonbondedForceImpl has already checked that it contains no duplicates.
      */
-    virtual void initialize(const OpenMM::System& system, const NonbondedForce& force) = 0;
+    virtual void initialize(const OpenMM::System& system, const NonbondedForce& force, const std::vector<std::pair<int, int> >& sortedExclusions) = 0;
     /**
      * Execute the kernel to calculate the forces and/or energy.
      *
@@ -193,6 +198,35 @@ public:
      * @param force      the NonbondedForce to copy the parameters from
      */
     virtual void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force) = 0;
+    /**
+     * Copy changed parameters over to a context, considering only the specified particles and exceptions.
+     * All other particles and exceptions are assumed to be unchanged.
+     *
+     * @param context     the context to copy parameters to
+     * @param force       the NonbondedForce to copy the parameters from
+     * @param particles   the indices of the particles whose parameters might have changed
+     * @param exceptions  the indices of the exceptions whose parameters might have changed
+     */
+    virtual void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions) = 0;
+    /**
+     * Copy changed charges over to a context.  Only the charges of the specified particles and the
+     * charge products of the specified exceptions are copied.  Everything else is assumed to be unchanged.
+     *
+     * @param context     the context to copy charges to
+     * @param force       the NonbondedForce to copy the charges from
+     * @param particles   the indices of the particles whose charges might have changed
+     * @param exceptions  the indices of the exceptions whose charge products might have changed
+     */
+    virtual void copyChargesToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions) = 0;
+    /**
+     * Compute the energy of the force for several sets of global parameter values, without
+     * modifying the parameters stored in the context.
+     *
+     * @param context          the context in which to execute this kernel
+     * @param parameterValues  parameterValues[i][j] is the value of the j'th global parameter of the force in the i'th state
+     * @param energies         on exit, energies[i] is the potential energy of the force in the i'th state
+     */
+    virtual void computeEnergies(OpenMM::ContextImpl& context, const std::vector<std::vector<double> >& parameterValues, std::vector<double>& energies) = 0;
     /**
      * Get the parameters being used for PME.
      *
@@ -211,6 +245,60 @@ public:
      * @param nz      the number of grid points along the Z axis
      */
     virtual void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const = 0;
+    /**
+     * Set the number of threads used to compute direct space interactions and exceptions.  Platforms that
+     * do not support this keep the default implementation, which throws an exception.
+     *
+     * @param numThreads   the number of threads to use, or 0 to compute them serially
+     */
+    virtual void setNumThreads(int numThreads) {
+        throw OpenMM::OpenMMException("NonbondedForce: Setting the number of threads is not supported by this platform");
+    }
+    /**
+     * Get the number of threads used to compute direct space interactions and exceptions, or 0 if they
+     * are computed serially.
+     */
+    virtual int getNumThreads() const {
+        throw OpenMM::OpenMMException("NonbondedForce: Setting the number of threads is not supported by this platform");
+    }
+    /**
+     * Set whether to record the time spent in each phase of the calculation.  Platforms that do not
+     * support timing keep the default implementation, which throws an exception.
+     *
+     * @param enabled   true to enable timing, false to disable it
+     */
+    virtual void setTimingEnabled(bool enabled) {
+        throw OpenMM::OpenMMException("NonbondedForce: Timing is not supported by this platform");
+    }
+    /**
+     * Get the time spent in each phase of the calculation since timing was enabled or last reset.
+     *
+     * @param times            on exit, maps the name of each phase to the time spent in it, measured in seconds
+     * @param numEvaluations   on exit, the number of times the kernel was executed while timing was enabled
+     */
+    virtual void getTimingStatistics(std::map<std::string, double>& times, int& numEvaluations) const {
+        throw OpenMM::OpenMMException("NonbondedForce: Timing is not supported by this platform");
+    }
+    /**
+     * Get statistics on how the work was divided between threads since timing was enabled or last reset.
+     *
+     * @param blocks          on exit, blocks[i] is the number of blocks of interactions processed by thread i
+     * @param interactions    on exit, interactions[i] is the number of pairs and exceptions computed by thread i
+     * @param busyTimes       on exit, busyTimes[i] is the time thread i spent working, measured in seconds
+     * @param waitTimes       on exit, waitTimes[i] is the time thread i spent waiting for other threads, measured in seconds
+     * @param imbalance       on exit, the largest busy time divided by the average busy time
+     * @param lastEvaluation  if true, get the statistics for only the most recent evaluation instead of the totals
+     */
+    virtual void getThreadStatistics(std::vector<int>& blocks, std::vector<long long>& interactions, std::vector<double>& busyTimes,
+                                     std::vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const {
+        throw OpenMM::OpenMMException("NonbondedForce: Timing is not supported by this platform");
+    }
+    /**
+     * Set the accumulated times and thread statistics to zero.
+     */
+    virtual void resetTimingStatistics() {
+        throw OpenMM::OpenMMException("NonbondedForce: Timing is not supported by this platform");
+    }
 };
 
 } // namespace ExamplePlugin
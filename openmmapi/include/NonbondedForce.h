@@ -36,6 +36,7 @@
 #include "openmm/Force.h"
 #include <map>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 #include "internal/windowsExportExample.h"
@@ -313,6 +314,141 @@ public:
      * @param[out] nz      the number of grid points along the Z axis
      */
     void getLJPMEParametersInContext(const OpenMM::Context& context, double& alpha, int& nx, int& ny, int& nz) const;
+    /**
+     * Measure the error in the electrostatic forces computed by a Context that uses Ewald summation, PME, or LJPME.
+     * The parameters chosen from the Ewald error tolerance are based on an a priori estimate of the error, which is
+     * often pessimistic.  This method instead compares the forces on a sample of particles in the Context's current
+     * configuration against a high accuracy Ewald sum, so you can check whether a larger tolerance or a smaller
+     * grid would still be accurate enough for your system.
+     *
+     * Only the parts of the electrostatic force that depend on the Ewald parameters are compared.  Lennard-Jones
+     * interactions, including the dispersion term of LJPME, are not included.  The forces are computed in double
+     * precision on the CPU, so differences due to the precision used by a platform are not included either.  The
+     * reference calculation takes time proportional to the number of particles, and is much slower than evaluating
+     * the forces.
+     *
+     * @param context          the Context in which to measure the error
+     * @param[out] rmsError    the root mean square error in the force on the sampled particles, measured in kJ/mol/nm
+     * @param[out] rmsForce    the root mean square of the reference force on the sampled particles, measured in kJ/mol/nm
+     * @param numSamples       the number of particles to sample.  They are evenly spaced through the list of particles.
+     */
+    void estimateForceErrorInContext(const OpenMM::Context& context, double& rmsError, double& rmsForce, int numSamples=100) const;
+    /**
+     * Set the number of CPU threads a Context uses to compute direct space interactions and exceptions.  The
+     * work is divided into blocks that do not depend on the number of threads, and the forces are summed in fixed
+     * point, so the results are bitwise identical for any number of threads greater than 0.  A value of 0, the
+     * default, computes them serially with double precision sums, which may differ from the threaded results in the
+     * last few bits.  Only the Reference platform supports this.  On other platforms an exception is thrown.
+     *
+     * @param context      the Context to set the number of threads for
+     * @param numThreads   the number of threads to use, or 0 to compute the interactions serially
+     */
+    void setNumThreadsInContext(OpenMM::Context& context, int numThreads);
+    /**
+     * Get the number of CPU threads a Context uses to compute direct space interactions and exceptions.  See
+     * setNumThreadsInContext() for details.
+     *
+     * @param context   the Context to get the number of threads for
+     * @return the number of threads, or 0 if the interactions are computed serially
+     */
+    int getNumThreadsInContext(const OpenMM::Context& context) const;
+    /**
+     * Set whether a Context should record how much time it spends in each phase of computing this force, such as
+     * building the neighbor list, direct space interactions, and reciprocal space.  Timing is disabled by default,
+     * and costs almost nothing while disabled.  Not every platform supports timing.  If the Context's platform does
+     * not, an exception is thrown.
+     *
+     * @param context   the Context to enable or disable timing in
+     * @param enabled   true to enable timing, false to disable it
+     */
+    void setTimingEnabledInContext(OpenMM::Context& context, bool enabled);
+    /**
+     * Get the time a Context has spent in each phase of computing this force since timing was enabled or the
+     * statistics were last reset.  Which phases are reported depends on the platform.  Disabling timing does not
+     * reset the statistics.
+     *
+     * @param context              the Context to get the statistics for
+     * @param[out] times           maps the name of each phase to the time spent in it, measured in seconds
+     * @param[out] numEvaluations  the number of times the force was computed while timing was enabled.  If reciprocal space
+     *                             is in a separate force group, only evaluations that include the direct space part are counted.
+     */
+    void getTimingStatisticsInContext(const OpenMM::Context& context, std::map<std::string, double>& times, int& numEvaluations) const;
+    /**
+     * Get statistics on how a Context has divided the work of computing this force between threads, either summed over
+     * all evaluations since timing was enabled or the statistics were last reset, or for only the most recent evaluation.
+     * They are useful for choosing the number of threads and for evaluating changes to how work is scheduled.  They are
+     * only recorded while timing is enabled and multiple threads are in use, so otherwise the arrays are empty.
+     *
+     * The interactions counted are the pairs of particles in the neighbor list (or all non-excluded pairs without a
+     * cutoff) and the exceptions.  With Ewald, PME, and LJPME, the correction for excluded pairs is computed serially
+     * after the threads finish, so it is not included.
+     *
+     * @param context             the Context to get the statistics for
+     * @param[out] blocks         blocks[i] is the number of blocks of interactions processed by thread i
+     * @param[out] interactions   interactions[i] is the number of pairs and exceptions computed by thread i
+     * @param[out] busyTimes      busyTimes[i] is the time thread i spent working, measured in seconds
+     * @param[out] waitTimes      waitTimes[i] is the time thread i spent waiting for other threads to finish, measured in seconds
+     * @param[out] imbalance      the largest busy time divided by the average busy time.  A value of 1 means the work was
+     *                            divided perfectly evenly.
+     * @param lastEvaluation      if true, return the statistics for only the most recent evaluation instead of the totals
+     */
+    void getThreadStatisticsInContext(const OpenMM::Context& context, std::vector<int>& blocks, std::vector<long long>& interactions,
+                                      std::vector<double>& busyTimes, std::vector<double>& waitTimes, double& imbalance,
+                                      bool lastEvaluation=false) const;
+    /**
+     * Reset the timing statistics of a Context to zero.  This includes the statistics returned by
+     * getThreadStatisticsInContext().
+     *
+     * @param context   the Context to reset the statistics for
+     */
+    void resetTimingStatisticsInContext(OpenMM::Context& context);
+    /**
+     * Get whether the PME grid size should be tuned for speed when a Context is created.  See setUsePMETuning()
+     * for details.
+     */
+    bool getUsePMETuning() const {
+        return usePMETuning;
+    }
+    /**
+     * Set whether the PME grid size should be tuned for speed when a Context is created.  This only has an effect
+     * when the nonbonded method is PME or LJPME and the parameters are being chosen based on the Ewald error
+     * tolerance (that is, setPMEParameters() has not been called with a nonzero alpha).  The separation parameter
+     * is fixed by the cutoff and the error tolerance, and the standard grid size is the smallest one that meets the
+     * tolerance.  With tuning enabled, the reciprocal space calculation is timed for the standard grid and for
+     * several slightly larger grids whose dimensions factor into small primes, and the fastest one is used.  Every
+     * candidate meets the error tolerance.  Call getPMEParametersInContext() to find which grid was chosen.
+     *
+     * Tuning measures the CPU implementation of PME, so it is only done by the Reference platform.  Other platforms
+     * use the standard grid.  A larger grid is only chosen when it is clearly faster.  The result is remembered for
+     * the rest of the process, so every Context created for the same force and box uses the same grid.  Use
+     * setPMETuningCacheFile() to keep the choice the same between processes.
+     */
+    void setUsePMETuning(bool use) {
+        usePMETuning = use;
+    }
+    /**
+     * Get the file in which the results of PME grid tuning are cached.  See setPMETuningCacheFile() for details.
+     */
+    const std::string& getPMETuningCacheFile() const {
+        return pmeTuningCacheFile;
+    }
+    /**
+     * Set the file in which the results of PME grid tuning are cached.  If this is not empty and PME tuning is
+     * enabled (see setUsePMETuning()), the file is checked before the grids are timed.  If it contains a result for
+     * a force with the same configuration (the number of particles, the nonbonded method, cutoff, error tolerance,
+     * periodic box, and the parameters of every particle and exception), that grid is used without repeating the
+     * timing.  Otherwise the grid is tuned and the result is added to the file.  Changing any of these settings
+     * invalidates the cached result.  Results are only ever appended to the file, so it can be shared by many
+     * processes on the same computer.  Processes that start at the same time may each tune the same force, but no
+     * result is lost.  Appending is not atomic on some network file systems, so the file should be kept on a local
+     * disk.  Because the timings depend on the hardware, the file should not be shared between different kinds of
+     * computers.
+     *
+     * The cache file is a property of the machine rather than the force, so it is not serialized.
+     */
+    void setPMETuningCacheFile(const std::string& file) {
+        pmeTuningCacheFile = file;
+    }
     /**
      * Add the nonbonded force parameters for a particle.  This should be called once for each particle
      * in the System.  When it is called for the i'th time, it specifies the parameters for the i'th particle.
@@ -346,6 +482,36 @@ public:
      * @param epsilon   the epsilon parameter of the Lennard-Jones potential (corresponding to the well depth of the van der Waals interaction), measured in kJ/mol
      */
     void setParticleParameters(int index, double charge, double sigma, double epsilon);
+    /**
+     * Add many particles at once.  This is equivalent to calling addParticle() once for each element of
+     * the arrays, but the arrays are validated once and copied in a single pass.
+     *
+     * @param charges   the charge of each particle, measured in units of the proton charge
+     * @param sigmas    the sigma parameter of each particle, measured in nm
+     * @param epsilons  the epsilon parameter of each particle, measured in kJ/mol
+     * @return the index of the first particle that was added
+     */
+    int addParticles(const std::vector<double>& charges, const std::vector<double>& sigmas, const std::vector<double>& epsilons);
+    /**
+     * Get the nonbonded force parameters for a contiguous range of particles.
+     *
+     * @param firstIndex     the index of the first particle for which to get parameters
+     * @param numParticles   the number of particles for which to get parameters
+     * @param[out] charges   on exit, the charge of each particle, measured in units of the proton charge
+     * @param[out] sigmas    on exit, the sigma parameter of each particle, measured in nm
+     * @param[out] epsilons  on exit, the epsilon parameter of each particle, measured in kJ/mol
+     */
+    void getParticleParameters(int firstIndex, int numParticles, std::vector<double>& charges, std::vector<double>& sigmas, std::vector<double>& epsilons) const;
+    /**
+     * Set the nonbonded force parameters for a contiguous range of particles.  The range starts at firstIndex
+     * and contains one particle for each element of the arrays.
+     *
+     * @param firstIndex  the index of the first particle for which to set parameters
+     * @param charges     the charge of each particle, measured in units of the proton charge
+     * @param sigmas      the sigma parameter of each particle, measured in nm
+     * @param epsilons    the epsilon parameter of each particle, measured in kJ/mol
+     */
+    void setParticleParameters(int firstIndex, const std::vector<double>& charges, const std::vector<double>& sigmas, const std::vector<double>& epsilons);
     /**
      * Add an interaction to the list of exceptions that should be calculated differently from other interactions.
      * If chargeProd and epsilon are both equal to 0, this will cause the interaction to be completely omitted from
@@ -377,7 +543,8 @@ public:
     /**
      * Set the force field parameters for an interaction that should be calculated differently from others.
      * If chargeProd and epsilon are both equal to 0, this will cause the interaction to be completely omitted from
-     * force and energy calculations.
+     * force and energy calculations.  If the new particles are the same as those of a different exception, an
+     * exception is thrown and the force is left unchanged.
      *
      * @param index      the index of the interaction for which to get parameters
      * @param particle1  the index of the first particle involved in the interaction
@@ -387,6 +554,49 @@ public:
      * @param epsilon    the epsilon parameter of the Lennard-Jones potential (corresponding to the well depth of the van der Waals interaction), measured in kJ/mol
      */
     void setExceptionParameters(int index, int particle1, int particle2, double chargeProd, double sigma, double epsilon);
+    /**
+     * Add many exceptions at once.  This is equivalent to calling addException() once for each element of
+     * the arrays with replace=false, but the arrays are validated once and copied in a single pass.  If any
+     * of the new exceptions involves the same two particles as an existing one or another new one, an
+     * exception is thrown and the force is left unchanged.
+     *
+     * @param particles1   the index of the first particle involved in each interaction
+     * @param particles2   the index of the second particle involved in each interaction
+     * @param chargeProds  the scaled product of the atomic charges for each interaction, measured in units of the proton charge squared
+     * @param sigmas       the sigma parameter for each interaction, measured in nm
+     * @param epsilons     the epsilon parameter for each interaction, measured in kJ/mol
+     * @return the index of the first exception that was added
+     */
+    int addExceptions(const std::vector<int>& particles1, const std::vector<int>& particles2, const std::vector<double>& chargeProds,
+                      const std::vector<double>& sigmas, const std::vector<double>& epsilons);
+    /**
+     * Get the force field parameters for a contiguous range of exceptions.
+     *
+     * @param firstIndex       the index of the first exception for which to get parameters
+     * @param numExceptions    the number of exceptions for which to get parameters
+     * @param[out] particles1  on exit, the index of the first particle involved in each interaction
+     * @param[out] particles2  on exit, the index of the second particle involved in each interaction
+     * @param[out] chargeProds on exit, the scaled product of the atomic charges for each interaction, measured in units of the proton charge squared
+     * @param[out] sigmas      on exit, the sigma parameter for each interaction, measured in nm
+     * @param[out] epsilons    on exit, the epsilon parameter for each interaction, measured in kJ/mol
+     */
+    void getExceptionParameters(int firstIndex, int numExceptions, std::vector<int>& particles1, std::vector<int>& particles2,
+                                std::vector<double>& chargeProds, std::vector<double>& sigmas, std::vector<double>& epsilons) const;
+    /**
+     * Set the force field parameters for a contiguous range of exceptions.  The range starts at firstIndex
+     * and contains one exception for each element of the arrays.  The particles of an exception may be changed,
+     * but if two exceptions would then involve the same two particles, an exception is thrown and the force is
+     * left unchanged.
+     *
+     * @param firstIndex   the index of the first exception for which to set parameters
+     * @param particles1   the index of the first particle involved in each interaction
+     * @param particles2   the index of the second particle involved in each interaction
+     * @param chargeProds  the scaled product of the atomic charges for each interaction, measured in units of the proton charge squared
+     * @param sigmas       the sigma parameter for each interaction, measured in nm
+     * @param epsilons     the epsilon parameter for each interaction, measured in kJ/mol
+     */
+    void setExceptionParameters(int firstIndex, const std::vector<int>& particles1, const std::vector<int>& particles2,
+                                const std::vector<double>& chargeProds, const std::vector<double>& sigmas, const std::vector<double>& epsilons);
     /**
      * Identify exceptions based on the molecular topology.  Particles which are separated by one or two bonds are set
      * to not interact at all, while pairs of particles separated by three bonds (known as "1-4 interactions") have
@@ -556,6 +766,69 @@ public:
      * to add new particles or exceptions, only to change the parameters of existing ones.
      */
     void updateParametersInContext(OpenMM::Context& context);
+    /**
+     * Update the parameters of a range of particles and exceptions in a Context to match those stored in this Force object.
+     * This is equivalent to updateParametersInContext(), except that only the particles with indices between firstParticle
+     * and lastParticle (inclusive) and the exceptions with indices between firstException and lastException (inclusive)
+     * are copied.  It is much faster when only a few parameters have changed, as in constant pH simulations.  To copy no
+     * particles (or no exceptions), pass a last index that is less than the first one.
+     *
+     * The same limitations apply as for updateParametersInContext().  In addition, it is your responsibility to make sure
+     * every particle and exception that has been modified lies inside the specified ranges.  Parameters outside the ranges
+     * are not checked, so any changes to them are silently ignored.
+     *
+     * @param context         the Context in which to update the parameters
+     * @param firstParticle   the index of the first particle whose parameters might have changed
+     * @param lastParticle    the index of the last particle whose parameters might have changed
+     * @param firstException  the index of the first exception whose parameters might have changed
+     * @param lastException   the index of the last exception whose parameters might have changed
+     */
+    void updateParametersInContext(OpenMM::Context& context, int firstParticle, int lastParticle, int firstException, int lastException);
+    /**
+     * Update the parameters of selected particles and exceptions in a Context to match those stored in this Force object.
+     * This is equivalent to updateParametersInContext(), except that only the listed particles and exceptions are copied.
+     * Unlike the version that takes ranges, the cost depends only on the number of indices listed, so it is the better
+     * choice when the modified particles are scattered through the System.
+     *
+     * The same limitations apply as for updateParametersInContext().  In addition, it is your responsibility to make sure
+     * every particle and exception that has been modified is listed.  Changes to any other parameters are silently ignored.
+     *
+     * @param context     the Context in which to update the parameters
+     * @param particles   the indices of the particles whose parameters might have changed
+     * @param exceptions  the indices of the exceptions whose parameters might have changed
+     */
+    void updateParametersInContext(OpenMM::Context& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Update the charges of selected particles and the charge products of selected exceptions in a Context to match
+     * those stored in this Force object.  This is a faster alternative to updateParametersInContext() for workflows
+     * such as constant pH simulations, where only charges change.  Everything that depends only on the Lennard-Jones
+     * parameters, such as the dispersion correction, is left untouched.
+     *
+     * Only charges are copied.  Changes to sigma or epsilon of the listed particles and exceptions are ignored, as are
+     * changes to any particle or exception that is not listed.  An exception whose chargeProd and epsilon were both
+     * zero when the Context was created cannot be given a nonzero chargeProd.
+     *
+     * @param context     the Context in which to update the charges
+     * @param particles   the indices of the particles whose charges might have changed
+     * @param exceptions  the indices of the exceptions whose charge products might have changed
+     */
+    void updateChargesInContext(OpenMM::Context& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Compute the energy of this force in a Context for several different sets of global parameter values.  This is
+     * intended for analyses such as MBAR, where the potential energy of every saved configuration must be evaluated at
+     * many values of the parameters that drive parameter offsets.  All states are evaluated together, so the geometric
+     * part of each interaction is only computed once regardless of the number of states.  The parameter values stored in
+     * the Context are not modified.
+     *
+     * The energy of each state includes both direct and reciprocal space contributions, regardless of the force groups
+     * they are assigned to.  This method is not supported when the nonbonded method is LJPME.
+     *
+     * @param context          the Context in which to compute the energies
+     * @param parameterValues  parameterValues[i] holds the values to use for the i'th state.  It must contain one element
+     *                         for every global parameter defined by this force, in the order they were added.
+     * @param[out] energies    on exit, energies[i] is the potential energy of this force in the i'th state, measured in kJ/mol
+     */
+    void computeEnergiesInContext(OpenMM::Context& context, const std::vector<std::vector<double> >& parameterValues, std::vector<double>& energies);
     /**
      * Returns whether or not this force makes use of periodic boundary
      * conditions.
@@ -602,18 +875,41 @@ private:
     class GlobalParameterInfo;
     class ParticleOffsetInfo;
     class ExceptionOffsetInfo;
+    /**
+     * An open addressing hash table that maps each pair of particles to the index of its exception.
+     * The pair is packed into a single 64 bit key, so the order of the particles does not matter.
+     * Empty slots are marked by a value of -1.
+     */
+    class ExceptionIndex {
+    public:
+        ExceptionIndex();
+        int find(int particle1, int particle2) const;
+        void insert(int particle1, int particle2, int index);
+        void erase(int particle1, int particle2);
+        void reserve(int count);
+        bool empty() const {
+            return size == 0;
+        }
+    private:
+        static long long makeKey(int particle1, int particle2);
+        static size_t hashKey(long long key);
+        void rehash(size_t capacity);
+        std::vector<long long> keys;
+        std::vector<int> values;
+        int size;
+    };
     NonbondedMethod nonbondedMethod;
     double cutoffDistance, switchingDistance, rfDielectric, ewaldErrorTol, alpha, dalpha;
-    bool useSwitchingFunction, useDispersionCorrection, exceptionsUsePeriodic;
+    bool useSwitchingFunction, useDispersionCorrection, exceptionsUsePeriodic, usePMETuning;
     int recipForceGroup, nx, ny, nz, dnx, dny, dnz;
-    void addExclusionsToSet(const std::vector<std::set<int> >& bonded12, std::set<int>& exclusions, int baseParticle, int fromParticle, int currentLevel) const;
+    std::string pmeTuningCacheFile;
     int getGlobalParameterIndex(const std::string& parameter) const;
     std::vector<ParticleInfo> particles;
     std::vector<ExceptionInfo> exceptions;
     std::vector<GlobalParameterInfo> globalParameters;
     std::vector<ParticleOffsetInfo> particleOffsets;
     std::vector<ExceptionOffsetInfo> exceptionOffsets;
-    std::map<std::pair<int, int>, int> exceptionMap;
+    ExceptionIndex exceptionIndex;
 };
 
 /**
@@ -0,0 +1,103 @@
+#ifndef OPENMM_DISPERSIONCORRECTION_H_
+#define OPENMM_DISPERSIONCORRECTION_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2018 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "NonbondedForce.h"
+#include <array>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class computes the coefficient of the long range dispersion correction for a NonbondedForce, and
+ * keeps it up to date as particle parameters and global parameters change.  Particles are grouped into
+ * classes with identical sigma and epsilon.  For each class it records the number of particles and the sum
+ * of its interactions with all other particles.  Moving a particle from one class to another then costs
+ * O(number of classes) instead of the O(number of classes squared) needed to compute the coefficient from
+ * scratch.
+ *
+ * Global parameters enter through particle parameter offsets.  Only the particles that have offsets for a
+ * parameter are moved when its value changes, so a change to lambda costs time proportional to the number
+ * of perturbed particles.
+ */
+class OPENMM_EXPORT_EXAMPLE DispersionCorrection {
+public:
+    /**
+     * Create a DispersionCorrection.  The global parameters are initially set to their default values.
+     *
+     * @param force    the NonbondedForce to compute the correction for
+     */
+    DispersionCorrection(const NonbondedForce& force);
+    /**
+     * Set the sigma and epsilon of a particle, not including any offsets.
+     */
+    void setParticleParameters(int index, double sigma, double epsilon);
+    /**
+     * Set the value of a global parameter.  Parameters that are not used by any particle parameter offset
+     * are ignored.
+     */
+    void setParameterValue(const std::string& name, double value);
+    /**
+     * Get the coefficient which, when divided by the periodic box volume, gives the long range dispersion
+     * correction to the energy.  It is only recomputed if something has changed since the last call.
+     */
+    double getCoefficient();
+private:
+    typedef std::array<double, 3> Sums;
+    Sums computePairSums(int class1, int class2) const;
+    int findClass(double sigma, double epsilon);
+    void addToClass(int particleClass, int delta);
+    void updateParticle(int index);
+    void rebuildClassSums();
+    int numParticles;
+    bool useSwitch, isValid;
+    double cutoff, switchDist, coefficient;
+    int numIncrementalUpdates;
+    std::vector<double> baseSigma, baseEpsilon;
+    std::vector<int> particleClass;
+    std::map<std::pair<double, double>, int> classIndex;
+    std::vector<std::pair<double, double> > classParams;
+    std::vector<int> classCount, freeClasses;
+    std::vector<Sums> classSelfSums, classRowSums;
+    std::map<std::string, int> parameterIndex;
+    std::vector<double> parameterValues;
+    std::vector<std::vector<int> > parameterParticles;
+    std::vector<std::vector<std::pair<int, std::pair<double, double> > > > particleOffsets;
+};
+
+} // namespace ExamplePlugin
+
+#endif /*OPENMM_DISPERSIONCORRECTION_H_*/
@@ -0,0 +1,111 @@
+#ifndef OPENMM_EWALDERRORESTIMATOR_H_
+#define OPENMM_EWALDERRORESTIMATOR_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2018 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "NonbondedForce.h"
+#include "openmm/Vec3.h"
+#include <utility>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class measures the error in the electrostatic forces computed with Ewald summation or PME.  It
+ * computes the forces on a sample of particles in two ways: with a given set of parameters, and with a
+ * high accuracy Ewald sum whose error is far below any tolerance used in practice.  Comparing the two gives
+ * the actual error of the parameters for a particular configuration, rather than the a priori estimate
+ * used to select them.
+ *
+ * Only the parts of the interaction that depend on the Ewald parameters are computed: the direct space
+ * sum, the reciprocal space sum, and the correction that removes excluded pairs from the reciprocal space
+ * sum.  Exceptions and Lennard-Jones interactions are identical in both calculations and are omitted.
+ */
+class OPENMM_EXPORT_EXAMPLE EwaldErrorEstimator {
+public:
+    /**
+     * Create an EwaldErrorEstimator.
+     *
+     * @param positions    the positions of all particles
+     * @param charges      the charges of all particles
+     * @param boxVectors   the periodic box vectors
+     * @param exclusions   the pairs of particles that are excluded from the direct space sum
+     * @param samples      the indices of the particles to compute forces on
+     */
+    EwaldErrorEstimator(const std::vector<OpenMM::Vec3>& positions, const std::vector<double>& charges, const OpenMM::Vec3* boxVectors,
+                        const std::vector<std::pair<int, int> >& exclusions, const std::vector<int>& samples);
+    /**
+     * Compute the direct space forces on the sample particles, including the exclusion correction.
+     *
+     * @param alpha       the Ewald separation parameter
+     * @param cutoff      the direct space cutoff distance
+     * @param[out] forces the force on each sample particle
+     */
+    void computeDirectForces(double alpha, double cutoff, std::vector<OpenMM::Vec3>& forces) const;
+    /**
+     * Compute the reciprocal space forces on the sample particles with an Ewald sum.  Wave vectors are
+     * included if each component of their index is at most kmax in magnitude and, if kcutoff is positive,
+     * their length is at most kcutoff.
+     *
+     * @param alpha       the Ewald separation parameter
+     * @param kmax        the largest index of a wave vector along each axis
+     * @param kcutoff     the largest length of a wave vector, or 0 for no limit
+     * @param[out] forces the force on each sample particle
+     */
+    void computeEwaldForces(double alpha, const int kmax[3], double kcutoff, std::vector<OpenMM::Vec3>& forces) const;
+    /**
+     * Compute the reciprocal space forces on the sample particles with PME.
+     *
+     * @param alpha       the Ewald separation parameter
+     * @param gridSize    the dimensions of the PME grid
+     * @param[out] forces the force on each sample particle
+     */
+    void computePMEForces(double alpha, const int gridSize[3], std::vector<OpenMM::Vec3>& forces) const;
+    /**
+     * Compute the total electrostatic forces on the sample particles to high accuracy.
+     *
+     * @param[out] forces the force on each sample particle
+     */
+    void computeReferenceForces(std::vector<OpenMM::Vec3>& forces) const;
+private:
+    OpenMM::Vec3 getPeriodicDelta(const OpenMM::Vec3& pos1, const OpenMM::Vec3& pos2) const;
+    const std::vector<OpenMM::Vec3>& positions;
+    const std::vector<double>& charges;
+    OpenMM::Vec3 boxVectors[3], recipBoxVectors[3];
+    double volume;
+    std::vector<int> samples;
+    std::vector<std::vector<int> > sampleExclusions;
+};
+
+} // namespace ExamplePlugin
+
+#endif /*OPENMM_EWALDERRORESTIMATOR_H_*/
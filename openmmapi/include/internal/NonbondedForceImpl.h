@@ -38,11 +38,10 @@
 #include <utility>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace ExamplePlugin {
 
-class System;
-
 /**
  * This is the internal implementation of NonbondedForce.
  */
@@ -61,8 +60,20 @@ public:
     std::map<std::string, double> getDefaultParameters();
     std::vector<std::string> getKernelNames();
     void updateParametersInContext(OpenMM::ContextImpl& context);
+    void updateParametersInContext(OpenMM::ContextImpl& context, int firstParticle, int lastParticle, int firstException, int lastException);
+    void updateParametersInContext(OpenMM::ContextImpl& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    void updateChargesInContext(OpenMM::ContextImpl& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    void computeEnergies(OpenMM::ContextImpl& context, const std::vector<std::vector<double> >& parameterValues, std::vector<double>& energies);
     void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
     void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+    void estimateForceError(const OpenMM::Context& context, int numSamples, double& rmsError, double& rmsForce) const;
+    void setNumThreads(int numThreads);
+    int getNumThreads() const;
+    void setTimingEnabled(bool enabled);
+    void getTimingStatistics(std::map<std::string, double>& times, int& numEvaluations) const;
+    void getThreadStatistics(std::vector<int>& blocks, std::vector<long long>& interactions, std::vector<double>& busyTimes,
+                             std::vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const;
+    void resetTimingStatistics();
     /**
      * This is a utility routine that calculates the values to use for alpha and kmax when using
      * Ewald summation.
@@ -70,18 +81,40 @@ public:
     static void calcEwaldParameters(const OpenMM::System& system, const NonbondedForce& force, double& alpha, int& kmaxx, int& kmaxy, int& kmaxz);
     /**
      * This is a utility routine that calculates the values to use for alpha and grid size when using
-     * Particle Mesh Ewald.
+     * Particle Mesh Ewald.  If tune is true and the force has PME tuning enabled, the electrostatic grid
+     * is tuned by timing the CPU reciprocal space calculation.  Platforms that compute PME on other
+     * hardware should leave it false.
      */
-    static void calcPMEParameters(const OpenMM::System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj);
+    static void calcPMEParameters(const OpenMM::System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj, bool tune=false);
     /**
      * Compute the coefficient which, when divided by the periodic box volume, gives the
      * long range dispersion correction to the energy.
      */
     static double calcDispersionCorrection(const OpenMM::System& system, const NonbondedForce& force);
+    /**
+     * Compute a 64 bit hash of the contents of a NonbondedForce.  The settings (nonbonded method, cutoff, PME
+     * parameters, etc.), the numbers of particles, exceptions, and offsets, and the names of the global parameters
+     * are always included.  If includeParameters is true, the parameters of every particle, exception, and offset
+     * and the default values of the global parameters are included as well.
+     */
+    static unsigned long long computeHash(const NonbondedForce& force, bool includeParameters=true);
+    /**
+     * Compute a 64 bit hash that identifies the configuration of a NonbondedForce within a System: everything
+     * included by computeHash() plus the default periodic box.  Two forces with the same fingerprint produce the
+     * same results from calcEwaldParameters() and calcPMEParameters().
+     */
+    static unsigned long long computeFingerprint(const OpenMM::System& system, const NonbondedForce& force);
+    /**
+     * Sort a list of exclusions.  Lists with at least 100000 entries are sorted in parallel using numThreads
+     * threads.  If numThreads is 0, the default number of threads is used.
+     */
+    static void sortExclusions(std::vector<std::pair<int, int> >& exclusions, int numThreads=0);
 private:
+    friend class DispersionCorrection;
     class ErrorFunction;
     class EwaldErrorFunction;
     static int findZero(const ErrorFunction& f, int initialGuess);
+    static void tunePMEGridSize(const OpenMM::System& system, const NonbondedForce& force, double alpha, int& xsize, int& ysize, int& zsize);
     static double evalIntegral(double r, double rs, double rc, double sigma);
     const NonbondedForce& owner;
     OpenMM::Kernel kernel;
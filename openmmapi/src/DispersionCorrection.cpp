@@ -0,0 +1,238 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2018 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#ifdef WIN32
+  #define _USE_MATH_DEFINES // Needed to get M_PI
+#endif
+#include "internal/DispersionCorrection.h"
+#include "internal/NonbondedForceImpl.h"
+#include <cmath>
+
+using namespace ExamplePlugin;
+using namespace std;
+
+DispersionCorrection::DispersionCorrection(const NonbondedForce& force) : isValid(false), numIncrementalUpdates(0) {
+    numParticles = force.getNumParticles();
+    useSwitch = force.getUseSwitchingFunction();
+    cutoff = force.getCutoffDistance();
+    switchDist = force.getSwitchingDistance();
+    vector<double> charges;
+    force.getParticleParameters(0, numParticles, charges, baseSigma, baseEpsilon);
+
+    // Record which particles depend on each global parameter.
+
+    for (int i = 0; i < force.getNumGlobalParameters(); i++) {
+        parameterIndex[force.getGlobalParameterName(i)] = i;
+        parameterValues.push_back(force.getGlobalParameterDefaultValue(i));
+    }
+    parameterParticles.resize(parameterValues.size());
+    particleOffsets.resize(numParticles);
+    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
+        string parameter;
+        int index;
+        double chargeScale, sigmaScale, epsilonScale;
+        force.getParticleParameterOffset(i, parameter, index, chargeScale, sigmaScale, epsilonScale);
+        if (sigmaScale == 0.0 && epsilonScale == 0.0)
+            continue;
+        int param = parameterIndex[parameter];
+        particleOffsets[index].push_back(make_pair(param, make_pair(sigmaScale, epsilonScale)));
+        vector<int>& particles = parameterParticles[param];
+        if (particles.size() == 0 || particles.back() != index)
+            particles.push_back(index);
+    }
+
+    // Assign every particle to a class.
+
+    particleClass.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        double sigma = baseSigma[i], epsilon = baseEpsilon[i];
+        for (auto& offset : particleOffsets[i]) {
+            sigma += parameterValues[offset.first]*offset.second.first;
+            epsilon += parameterValues[offset.first]*offset.second.second;
+        }
+        int c = findClass(sigma, epsilon);
+        particleClass[i] = c;
+        classCount[c]++;
+    }
+    rebuildClassSums();
+}
+
+DispersionCorrection::Sums DispersionCorrection::computePairSums(int class1, int class2) const {
+    double sigma = 0.5*(classParams[class1].first+classParams[class2].first);
+    double epsilon = sqrt(classParams[class1].second*classParams[class2].second);
+    double sigma2 = sigma*sigma;
+    double sigma6 = sigma2*sigma2*sigma2;
+    Sums sums;
+    sums[0] = epsilon*sigma6*sigma6;
+    sums[1] = epsilon*sigma6;
+    sums[2] = 0.0;
+    if (useSwitch)
+        sums[2] = epsilon*(NonbondedForceImpl::evalIntegral(cutoff, switchDist, cutoff, sigma)-NonbondedForceImpl::evalIntegral(switchDist, switchDist, cutoff, sigma));
+    return sums;
+}
+
+int DispersionCorrection::findClass(double sigma, double epsilon) {
+    pair<double, double> key = make_pair(sigma, epsilon);
+    map<pair<double, double>, int>::iterator entry = classIndex.find(key);
+    if (entry != classIndex.end())
+        return entry->second;
+
+    // Create a new class, reusing the storage of an empty one if possible.  Its sum over
+    // interactions with all particles must be computed from scratch.
+
+    int c;
+    if (freeClasses.size() > 0) {
+        c = freeClasses.back();
+        freeClasses.pop_back();
+        classParams[c] = key;
+    }
+    else {
+        c = classParams.size();
+        classParams.push_back(key);
+        classCount.push_back(0);
+        classSelfSums.push_back(Sums());
+        classRowSums.push_back(Sums());
+    }
+    classIndex[key] = c;
+    classSelfSums[c] = computePairSums(c, c);
+    Sums row = {0.0, 0.0, 0.0};
+    for (int d = 0; d < classParams.size(); d++)
+        if (classCount[d] > 0) {
+            Sums terms = computePairSums(c, d);
+            for (int k = 0; k < 3; k++)
+                row[k] += classCount[d]*terms[k];
+        }
+    classRowSums[c] = row;
+    return c;
+}
+
+void DispersionCorrection::addToClass(int particleClass, int delta) {
+    for (int d = 0; d < classParams.size(); d++)
+        if (classCount[d] > 0 || d == particleClass) {
+            Sums terms = computePairSums(particleClass, d);
+            for (int k = 0; k < 3; k++)
+                classRowSums[d][k] += delta*terms[k];
+        }
+    classCount[particleClass] += delta;
+    if (classCount[particleClass] == 0) {
+        classIndex.erase(classParams[particleClass]);
+        freeClasses.push_back(particleClass);
+    }
+}
+
+void DispersionCorrection::updateParticle(int index) {
+    double sigma = baseSigma[index], epsilon = baseEpsilon[index];
+    for (auto& offset : particleOffsets[index]) {
+        sigma += parameterValues[offset.first]*offset.second.first;
+        epsilon += parameterValues[offset.first]*offset.second.second;
+    }
+    int oldClass = particleClass[index];
+    if (classParams[oldClass] == make_pair(sigma, epsilon))
+        return;
+    addToClass(oldClass, -1);
+    int newClass = findClass(sigma, epsilon);
+    particleClass[index] = newClass;
+    addToClass(newClass, 1);
+    isValid = false;
+
+    // Every incremental update adds a little roundoff error to the sums.  Rebuilding them once
+    // the number of updates exceeds the number of classes keeps the error bounded without
+    // changing the amortized cost.
+
+    if (++numIncrementalUpdates > (int) classParams.size())
+        rebuildClassSums();
+}
+
+void DispersionCorrection::rebuildClassSums() {
+    int numClasses = classParams.size();
+    for (int c = 0; c < numClasses; c++)
+        classRowSums[c] = {0.0, 0.0, 0.0};
+    for (int c = 0; c < numClasses; c++) {
+        if (classCount[c] == 0)
+            continue;
+        for (int d = 0; d <= c; d++) {
+            if (classCount[d] == 0)
+                continue;
+            Sums terms = (c == d ? classSelfSums[c] : computePairSums(c, d));
+            for (int k = 0; k < 3; k++) {
+                classRowSums[c][k] += classCount[d]*terms[k];
+                if (d != c)
+                    classRowSums[d][k] += classCount[c]*terms[k];
+            }
+        }
+    }
+    numIncrementalUpdates = 0;
+    isValid = false;
+}
+
+void DispersionCorrection::setParticleParameters(int index, double sigma, double epsilon) {
+    if (sigma == baseSigma[index] && epsilon == baseEpsilon[index])
+        return;
+    baseSigma[index] = sigma;
+    baseEpsilon[index] = epsilon;
+    updateParticle(index);
+}
+
+void DispersionCorrection::setParameterValue(const string& name, double value) {
+    map<string, int>::const_iterator entry = parameterIndex.find(name);
+    if (entry == parameterIndex.end() || parameterValues[entry->second] == value)
+        return;
+    int param = entry->second;
+    parameterValues[param] = value;
+    for (int particle : parameterParticles[param])
+        updateParticle(particle);
+}
+
+double DispersionCorrection::getCoefficient() {
+    if (isValid)
+        return coefficient;
+
+    // The sum over all pairs of particles (including each particle with itself) is half the sum
+    // over classes of count*(row sum + self interaction).
+
+    double sum1 = 0, sum2 = 0, sum3 = 0;
+    for (int c = 0; c < classParams.size(); c++) {
+        double count = (double) classCount[c];
+        if (count == 0)
+            continue;
+        sum1 += 0.5*count*(classRowSums[c][0]+classSelfSums[c][0]);
+        sum2 += 0.5*count*(classRowSums[c][1]+classSelfSums[c][1]);
+        sum3 += 0.5*count*(classRowSums[c][2]+classSelfSums[c][2]);
+    }
+    double n = (double) numParticles;
+    double numInteractions = (n*(n+1))/2;
+    sum1 /= numInteractions;
+    sum2 /= numInteractions;
+    sum3 /= numInteractions;
+    coefficient = 8*n*n*M_PI*(sum1/(9*pow(cutoff, 9))-sum2/(3*pow(cutoff, 3))+sum3);
+    isValid = true;
+    return coefficient;
+}
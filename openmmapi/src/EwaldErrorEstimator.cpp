@@ -0,0 +1,242 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2018 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#ifdef WIN32
+  #define _USE_MATH_DEFINES // Needed to get M_PI
+#endif
+#include "internal/EwaldErrorEstimator.h"
+#include "openmm/internal/MSVC_erfc.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/reference/ReferencePME.h"
+#include "openmm/reference/SimTKOpenMMRealType.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+
+using namespace ExamplePlugin;
+using namespace OpenMM;
+using namespace std;
+
+typedef complex<double> Complex;
+
+/**
+ * Compute exp(2*pi*i*n*s) for every particle in a list, where s is the particle's fractional coordinate
+ * along each axis and -kmax <= n <= kmax.  Element (n+kmax)*count+i of phases[axis] holds the value for
+ * the i'th particle.
+ */
+static void computePhases(const vector<Vec3>& positions, const int* indices, int count, const Vec3* recipBoxVectors,
+                          const int kmax[3], vector<Complex> phases[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+        int numK = 2*kmax[axis]+1;
+        phases[axis].resize(numK*count);
+        Complex* center = &phases[axis][kmax[axis]*count];
+        for (int i = 0; i < count; i++) {
+            double s = 2*M_PI*positions[indices[i]].dot(recipBoxVectors[axis]);
+            Complex step(cos(s), sin(s));
+            center[i] = 1.0;
+            for (int n = 1; n <= kmax[axis]; n++) {
+                center[n*count+i] = center[(n-1)*count+i]*step;
+                center[-n*count+i] = conj(center[n*count+i]);
+            }
+        }
+    }
+}
+
+EwaldErrorEstimator::EwaldErrorEstimator(const vector<Vec3>& positions, const vector<double>& charges, const Vec3* boxVectors,
+        const vector<pair<int, int> >& exclusions, const vector<int>& samples) : positions(positions), charges(charges), samples(samples) {
+    for (int i = 0; i < 3; i++)
+        this->boxVectors[i] = boxVectors[i];
+    volume = boxVectors[0].dot(boxVectors[1].cross(boxVectors[2]));
+    recipBoxVectors[0] = boxVectors[1].cross(boxVectors[2])*(1.0/volume);
+    recipBoxVectors[1] = boxVectors[2].cross(boxVectors[0])*(1.0/volume);
+    recipBoxVectors[2] = boxVectors[0].cross(boxVectors[1])*(1.0/volume);
+
+    // Record the exclusions of each sample particle.
+
+    vector<int> sampleIndex(positions.size(), -1);
+    for (int i = 0; i < (int) samples.size(); i++)
+        sampleIndex[samples[i]] = i;
+    sampleExclusions.resize(samples.size());
+    for (const pair<int, int>& exclusion : exclusions) {
+        if (sampleIndex[exclusion.first] != -1)
+            sampleExclusions[sampleIndex[exclusion.first]].push_back(exclusion.second);
+        if (sampleIndex[exclusion.second] != -1)
+            sampleExclusions[sampleIndex[exclusion.second]].push_back(exclusion.first);
+    }
+    for (vector<int>& excluded : sampleExclusions)
+        sort(excluded.begin(), excluded.end());
+}
+
+Vec3 EwaldErrorEstimator::getPeriodicDelta(const Vec3& pos1, const Vec3& pos2) const {
+    Vec3 delta = pos1-pos2;
+    delta -= boxVectors[2]*floor(delta[2]/boxVectors[2][2]+0.5);
+    delta -= boxVectors[1]*floor(delta[1]/boxVectors[1][1]+0.5);
+    delta -= boxVectors[0]*floor(delta[0]/boxVectors[0][0]+0.5);
+    return delta;
+}
+
+void EwaldErrorEstimator::computeDirectForces(double alpha, double cutoff, vector<Vec3>& forces) const {
+    int numSamples = samples.size();
+    int numParticles = positions.size();
+    forces.assign(numSamples, Vec3());
+    ThreadPool threads;
+    threads.execute([&] (ThreadPool& pool, int threadIndex) {
+        for (int i = threadIndex; i < numSamples; i += pool.getNumThreads()) {
+            int atom = samples[i];
+            const vector<int>& excluded = sampleExclusions[i];
+            Vec3 force;
+            for (int j = 0; j < numParticles; j++) {
+                if (j == atom)
+                    continue;
+                Vec3 delta = getPeriodicDelta(positions[atom], positions[j]);
+                double r2 = delta.dot(delta);
+                double r = sqrt(r2);
+                double alphaR = alpha*r;
+                double gaussian = (2/sqrt(M_PI))*alphaR*exp(-alphaR*alphaR);
+                double prefactor = ONE_4PI_EPS0*charges[atom]*charges[j]/(r2*r);
+                if (binary_search(excluded.begin(), excluded.end(), j)) {
+                    // Remove the part of the interaction that is included in the reciprocal space sum.
+
+                    force -= delta*(prefactor*(erf(alphaR)-gaussian));
+                }
+                else if (r < cutoff)
+                    force += delta*(prefactor*(erfc(alphaR)+gaussian));
+            }
+            forces[i] = force;
+        }
+    });
+    threads.waitForThreads();
+}
+
+void EwaldErrorEstimator::computeEwaldForces(double alpha, const int kmax[3], double kcutoff, vector<Vec3>& forces) const {
+    // List the wave vectors.  Only half of them are needed, since k and -k contribute equally.
+
+    vector<array<int, 3> > indices;
+    vector<Vec3> waveVectors;
+    vector<double> prefactors;
+    double factor = 2*4*M_PI*ONE_4PI_EPS0/volume;
+    for (int nx = 0; nx <= kmax[0]; nx++)
+        for (int ny = -kmax[1]; ny <= kmax[1]; ny++)
+            for (int nz = -kmax[2]; nz <= kmax[2]; nz++) {
+                if (nx == 0 && (ny < 0 || (ny == 0 && nz <= 0)))
+                    continue;
+                Vec3 k = (recipBoxVectors[0]*nx+recipBoxVectors[1]*ny+recipBoxVectors[2]*nz)*(2*M_PI);
+                double k2 = k.dot(k);
+                if (kcutoff > 0 && k2 > kcutoff*kcutoff)
+                    continue;
+                indices.push_back({{nx+kmax[0], ny+kmax[1], nz+kmax[2]}});
+                waveVectors.push_back(k);
+                prefactors.push_back(factor*exp(-k2/(4*alpha*alpha))/k2);
+            }
+    int numWaveVectors = waveVectors.size();
+
+    // Compute the structure factor.  Each thread processes its own blocks of particles and the partial
+    // sums are added in a fixed order, so the result does not depend on scheduling.
+
+    const int BlockSize = 1024;
+    int numParticles = positions.size();
+    int numBlocks = (numParticles+BlockSize-1)/BlockSize;
+    ThreadPool threads;
+    vector<vector<Complex> > threadSums(threads.getNumThreads(), vector<Complex>(numWaveVectors, 0.0));
+    threads.execute([&] (ThreadPool& pool, int threadIndex) {
+        vector<int> atoms(BlockSize);
+        vector<Complex> phases[3];
+        vector<Complex>& sums = threadSums[threadIndex];
+        for (int block = threadIndex; block < numBlocks; block += pool.getNumThreads()) {
+            int start = block*BlockSize;
+            int count = min(BlockSize, numParticles-start);
+            for (int i = 0; i < count; i++)
+                atoms[i] = start+i;
+            computePhases(positions, atoms.data(), count, recipBoxVectors, kmax, phases);
+            for (int k = 0; k < numWaveVectors; k++) {
+                const Complex* px = &phases[0][indices[k][0]*count];
+                const Complex* py = &phases[1][indices[k][1]*count];
+                const Complex* pz = &phases[2][indices[k][2]*count];
+                Complex sum = 0.0;
+                for (int i = 0; i < count; i++)
+                    sum += charges[start+i]*px[i]*py[i]*pz[i];
+                sums[k] += sum;
+            }
+        }
+    });
+    threads.waitForThreads();
+    vector<Complex> structureFactor(numWaveVectors, 0.0);
+    for (const vector<Complex>& sums : threadSums)
+        for (int k = 0; k < numWaveVectors; k++)
+            structureFactor[k] += sums[k];
+
+    // Compute the forces on the sample particles.
+
+    int numSamples = samples.size();
+    vector<Complex> phases[3];
+    computePhases(positions, samples.data(), numSamples, recipBoxVectors, kmax, phases);
+    forces.assign(numSamples, Vec3());
+    for (int k = 0; k < numWaveVectors; k++) {
+        const Complex* px = &phases[0][indices[k][0]*numSamples];
+        const Complex* py = &phases[1][indices[k][1]*numSamples];
+        const Complex* pz = &phases[2][indices[k][2]*numSamples];
+        Complex s = conj(structureFactor[k]);
+        for (int i = 0; i < numSamples; i++)
+            forces[i] += waveVectors[k]*(prefactors[k]*charges[samples[i]]*imag(px[i]*py[i]*pz[i]*s));
+    }
+}
+
+void EwaldErrorEstimator::computePMEForces(double alpha, const int gridSize[3], vector<Vec3>& forces) const {
+    int numParticles = positions.size();
+    vector<Vec3> allForces(numParticles);
+    pme_t pme;
+    double energy;
+    pme_init(&pme, alpha, numParticles, gridSize, 5, 1);
+    pme_exec(pme, positions, allForces, charges, boxVectors, &energy);
+    pme_destroy(pme);
+    forces.resize(samples.size());
+    for (int i = 0; i < (int) samples.size(); i++)
+        forces[i] = allForces[samples[i]];
+}
+
+void EwaldErrorEstimator::computeReferenceForces(vector<Vec3>& forces) const {
+    // Use the largest cutoff the minimum image convention allows, and choose alpha and the wave vectors
+    // so that both the direct and reciprocal space sums are converged to the tolerance.
+
+    const double tol = 1e-8;
+    double cutoff = 0.5*min(boxVectors[0][0], min(boxVectors[1][1], boxVectors[2][2]));
+    double alpha = sqrt(-log(2*tol))/cutoff;
+    double kcutoff = 2*alpha*sqrt(-log(tol));
+    int kmax[3];
+    for (int i = 0; i < 3; i++)
+        kmax[i] = (int) ceil(kcutoff*sqrt(boxVectors[i].dot(boxVectors[i]))/(2*M_PI));
+    vector<Vec3> recipForces;
+    computeDirectForces(alpha, cutoff, forces);
+    computeEwaldForces(alpha, kmax, kcutoff, recipForces);
+    for (int i = 0; i < (int) forces.size(); i++)
+        forces[i] += recipForces[i];
+}
@@ -34,8 +34,10 @@
 #include "NonbondedForce.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "internal/NonbondedForceImpl.h"
+#include "openmm/internal/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <map>
 #include <sstream>
 #include <utility>
 
@@ -43,13 +45,55 @@ using namespace ExamplePlugin;
 using namespace OpenMM;
 using std::map;
 using std::pair;
-using std::set;
 using std::string;
 using std::stringstream;
 using std::vector;
 
+/**
+ * The number of particles whose exceptions createExceptionsFromBonds() finds as a single unit of work.
+ */
+static const int ExceptionBlockSize = 4096;
+
+/**
+ * createExceptionsFromBonds() only uses multiple threads for systems with at least this many particles.
+ */
+static const int MinParticlesForThreads = 100000;
+
+static void throwDuplicateException(int particle1, int particle2) {
+    stringstream msg;
+    msg << "NonbondedForce: There is already an exception for particles ";
+    msg << particle1;
+    msg << " and ";
+    msg << particle2;
+    throw OpenMMException(msg.str());
+}
+
+static bool isSamePair(int a1, int a2, int b1, int b2) {
+    return ((a1 == b1 && a2 == b2) || (a1 == b2 && a2 == b1));
+}
+
+static void checkArrayLengths(size_t length, size_t otherLength) {
+    if (length != otherLength)
+        throw OpenMMException("NonbondedForce: The parameter arrays must all have the same length");
+}
+
+static void checkRange(int firstIndex, int count, size_t size) {
+    if (firstIndex < 0 || count < 0 || (size_t) firstIndex+count > size)
+        throw OpenMMException("NonbondedForce: Index out of range");
+}
+
+/**
+ * Make sure a vector can hold at least the specified number of elements.  Unlike calling reserve() directly, this
+ * grows the capacity geometrically, so adding many blocks one after another still takes linear time.
+ */
+template <class T>
+static void reserveCapacity(vector<T>& array, size_t size) {
+    if (size > array.capacity())
+        array.reserve(std::max(size, 2*array.capacity()));
+}
+
 NonbondedForce::NonbondedForce() : nonbondedMethod(NoCutoff), cutoffDistance(1.0), switchingDistance(-1.0), rfDielectric(78.3),
-        ewaldErrorTol(5e-4), alpha(0.0), dalpha(0.0), useSwitchingFunction(false), useDispersionCorrection(true), exceptionsUsePeriodic(false), recipForceGroup(-1),
+        ewaldErrorTol(5e-4), alpha(0.0), dalpha(0.0), useSwitchingFunction(false), useDispersionCorrection(true), exceptionsUsePeriodic(false), usePMETuning(false), recipForceGroup(-1),
         nx(0), ny(0), nz(0), dnx(0), dny(0), dnz(0) {
 }
 
@@ -139,6 +183,35 @@ void NonbondedForce::getLJPMEParametersInContext(const Context& context, double&
     dynamic_cast<const NonbondedForceImpl&>(getImplInContext(context)).getLJPMEParameters(alpha, nx, ny, nz);
 }
 
+void NonbondedForce::estimateForceErrorInContext(const Context& context, double& rmsError, double& rmsForce, int numSamples) const {
+    dynamic_cast<const NonbondedForceImpl&>(getImplInContext(context)).estimateForceError(context, numSamples, rmsError, rmsForce);
+}
+
+void NonbondedForce::setNumThreadsInContext(Context& context, int numThreads) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).setNumThreads(numThreads);
+}
+
+int NonbondedForce::getNumThreadsInContext(const Context& context) const {
+    return dynamic_cast<const NonbondedForceImpl&>(getImplInContext(context)).getNumThreads();
+}
+
+void NonbondedForce::setTimingEnabledInContext(Context& context, bool enabled) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).setTimingEnabled(enabled);
+}
+
+void NonbondedForce::getTimingStatisticsInContext(const Context& context, map<string, double>& times, int& numEvaluations) const {
+    dynamic_cast<const NonbondedForceImpl&>(getImplInContext(context)).getTimingStatistics(times, numEvaluations);
+}
+
+void NonbondedForce::getThreadStatisticsInContext(const Context& context, vector<int>& blocks, vector<long long>& interactions,
+                                                  vector<double>& busyTimes, vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const {
+    dynamic_cast<const NonbondedForceImpl&>(getImplInContext(context)).getThreadStatistics(blocks, interactions, busyTimes, waitTimes, imbalance, lastEvaluation);
+}
+
+void NonbondedForce::resetTimingStatisticsInContext(Context& context) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).resetTimingStatistics();
+}
+
 int NonbondedForce::addParticle(double charge, double sigma, double epsilon) {
     particles.push_back(ParticleInfo(charge, sigma, epsilon));
     return particles.size()-1;
@@ -158,31 +231,53 @@ void NonbondedForce::setParticleParameters(int index, double charge, double sigm
     particles[index].epsilon = epsilon;
 }
 
+int NonbondedForce::addParticles(const vector<double>& charges, const vector<double>& sigmas, const vector<double>& epsilons) {
+    checkArrayLengths(charges.size(), sigmas.size());
+    checkArrayLengths(charges.size(), epsilons.size());
+    int firstIndex = particles.size();
+    reserveCapacity(particles, particles.size()+charges.size());
+    for (int i = 0; i < (int) charges.size(); i++)
+        particles.push_back(ParticleInfo(charges[i], sigmas[i], epsilons[i]));
+    return firstIndex;
+}
+
+void NonbondedForce::getParticleParameters(int firstIndex, int numParticles, vector<double>& charges, vector<double>& sigmas, vector<double>& epsilons) const {
+    checkRange(firstIndex, numParticles, particles.size());
+    charges.resize(numParticles);
+    sigmas.resize(numParticles);
+    epsilons.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        const ParticleInfo& particle = particles[firstIndex+i];
+        charges[i] = particle.charge;
+        sigmas[i] = particle.sigma;
+        epsilons[i] = particle.epsilon;
+    }
+}
+
+void NonbondedForce::setParticleParameters(int firstIndex, const vector<double>& charges, const vector<double>& sigmas, const vector<double>& epsilons) {
+    checkArrayLengths(charges.size(), sigmas.size());
+    checkArrayLengths(charges.size(), epsilons.size());
+    checkRange(firstIndex, charges.size(), particles.size());
+    for (int i = 0; i < (int) charges.size(); i++)
+        particles[firstIndex+i] = ParticleInfo(charges[i], sigmas[i], epsilons[i]);
+}
+
 int NonbondedForce::addException(int particle1, int particle2, double chargeProd, double sigma, double epsilon, bool replace) {
-    map<pair<int, int>, int>::iterator iter = exceptionMap.find(pair<int, int>(particle1, particle2));
-    int newIndex;
-    if (iter == exceptionMap.end())
-        iter = exceptionMap.find(pair<int, int>(particle2, particle1));
-    if (iter != exceptionMap.end()) {
+    int newIndex = exceptionIndex.find(particle1, particle2);
+    if (newIndex != -1) {
         if (!replace) {
-            stringstream msg;
-            msg << "NonbondedForce: There is already an exception for particles ";
-            msg << particle1;
-            msg << " and ";
-            msg << particle2;
-            throw OpenMMException(msg.str());
+            throwDuplicateException(particle1, particle2);
         }
-        exceptions[iter->second] = ExceptionInfo(particle1, particle2, chargeProd, sigma, epsilon);
-        newIndex = iter->second;
-        exceptionMap.erase(iter->first);
+        exceptions[newIndex] = ExceptionInfo(particle1, particle2, chargeProd, sigma, epsilon);
     }
     else {
         exceptions.push_back(ExceptionInfo(particle1, particle2, chargeProd, sigma, epsilon));
         newIndex = exceptions.size()-1;
+        exceptionIndex.insert(particle1, particle2, newIndex);
     }
-    exceptionMap[pair<int, int>(particle1, particle2)] = newIndex;
     return newIndex;
 }
+
 void NonbondedForce::getExceptionParameters(int index, int& particle1, int& particle2, double& chargeProd, double& sigma, double& epsilon) const {
     ASSERT_VALID_INDEX(index, exceptions);
     particle1 = exceptions[index].particle1;
@@ -194,6 +289,12 @@ void NonbondedForce::getExceptionParameters(int index, int& particle1, int& part
 
 void NonbondedForce::setExceptionParameters(int index, int particle1, int particle2, double chargeProd, double sigma, double epsilon) {
     ASSERT_VALID_INDEX(index, exceptions);
+    if (!isSamePair(particle1, particle2, exceptions[index].particle1, exceptions[index].particle2)) {
+        if (exceptionIndex.find(particle1, particle2) != -1)
+            throwDuplicateException(particle1, particle2);
+        exceptionIndex.erase(exceptions[index].particle1, exceptions[index].particle2);
+        exceptionIndex.insert(particle1, particle2, index);
+    }
     exceptions[index].particle1 = particle1;
     exceptions[index].particle2 = particle2;
     exceptions[index].chargeProd = chargeProd;
@@ -201,6 +302,92 @@ void NonbondedForce::setExceptionParameters(int index, int particle1, int partic
     exceptions[index].epsilon = epsilon;
 }
 
+int NonbondedForce::addExceptions(const vector<int>& particles1, const vector<int>& particles2, const vector<double>& chargeProds,
+                                  const vector<double>& sigmas, const vector<double>& epsilons) {
+    int numNew = particles1.size();
+    checkArrayLengths(numNew, particles2.size());
+    checkArrayLengths(numNew, chargeProds.size());
+    checkArrayLengths(numNew, sigmas.size());
+    checkArrayLengths(numNew, epsilons.size());
+
+    // Check for duplicates, both against existing exceptions and within the new ones, before modifying anything.
+
+    ExceptionIndex newPairs;
+    newPairs.reserve(numNew);
+    for (int i = 0; i < numNew; i++) {
+        if (exceptionIndex.find(particles1[i], particles2[i]) != -1 || newPairs.find(particles1[i], particles2[i]) != -1)
+            throwDuplicateException(particles1[i], particles2[i]);
+        newPairs.insert(particles1[i], particles2[i], i);
+    }
+    int firstIndex = exceptions.size();
+    reserveCapacity(exceptions, exceptions.size()+numNew);
+    exceptionIndex.reserve(exceptions.size()+numNew);
+    for (int i = 0; i < numNew; i++) {
+        exceptionIndex.insert(particles1[i], particles2[i], exceptions.size());
+        exceptions.push_back(ExceptionInfo(particles1[i], particles2[i], chargeProds[i], sigmas[i], epsilons[i]));
+    }
+    return firstIndex;
+}
+
+void NonbondedForce::getExceptionParameters(int firstIndex, int numExceptions, vector<int>& particles1, vector<int>& particles2,
+                                            vector<double>& chargeProds, vector<double>& sigmas, vector<double>& epsilons) const {
+    checkRange(firstIndex, numExceptions, exceptions.size());
+    particles1.resize(numExceptions);
+    particles2.resize(numExceptions);
+    chargeProds.resize(numExceptions);
+    sigmas.resize(numExceptions);
+    epsilons.resize(numExceptions);
+    for (int i = 0; i < numExceptions; i++) {
+        const ExceptionInfo& exception = exceptions[firstIndex+i];
+        particles1[i] = exception.particle1;
+        particles2[i] = exception.particle2;
+        chargeProds[i] = exception.chargeProd;
+        sigmas[i] = exception.sigma;
+        epsilons[i] = exception.epsilon;
+    }
+}
+
+void NonbondedForce::setExceptionParameters(int firstIndex, const vector<int>& particles1, const vector<int>& particles2,
+                                            const vector<double>& chargeProds, const vector<double>& sigmas, const vector<double>& epsilons) {
+    int numExceptions = particles1.size();
+    checkArrayLengths(numExceptions, particles2.size());
+    checkArrayLengths(numExceptions, chargeProds.size());
+    checkArrayLengths(numExceptions, sigmas.size());
+    checkArrayLengths(numExceptions, epsilons.size());
+    checkRange(firstIndex, numExceptions, exceptions.size());
+
+    // Find the exceptions whose particles change.  Before modifying anything, make sure none of them will
+    // have the same particles as another exception, taking into account that exceptions in the range may
+    // give up their current pairs.
+
+    vector<int> moved;
+    for (int i = 0; i < numExceptions; i++)
+        if (!isSamePair(particles1[i], particles2[i], exceptions[firstIndex+i].particle1, exceptions[firstIndex+i].particle2))
+            moved.push_back(i);
+    if (!moved.empty()) {
+        ExceptionIndex newPairs;
+        newPairs.reserve(moved.size());
+        for (int i : moved) {
+            int existing = exceptionIndex.find(particles1[i], particles2[i]);
+            if (existing != -1) {
+                int j = existing-firstIndex;
+                bool existingMoves = (j >= 0 && j < numExceptions && !isSamePair(particles1[j], particles2[j], exceptions[existing].particle1, exceptions[existing].particle2));
+                if (!existingMoves)
+                    throwDuplicateException(particles1[i], particles2[i]);
+            }
+            if (newPairs.find(particles1[i], particles2[i]) != -1)
+                throwDuplicateException(particles1[i], particles2[i]);
+            newPairs.insert(particles1[i], particles2[i], i);
+        }
+        for (int i : moved)
+            exceptionIndex.erase(exceptions[firstIndex+i].particle1, exceptions[firstIndex+i].particle2);
+        for (int i : moved)
+            exceptionIndex.insert(particles1[i], particles2[i], firstIndex+i);
+    }
+    for (int i = 0; i < numExceptions; i++)
+        exceptions[firstIndex+i] = ExceptionInfo(particles1[i], particles2[i], chargeProds[i], sigmas[i], epsilons[i]);
+}
+
 ForceImpl* NonbondedForce::createImpl() const {
     return new NonbondedForceImpl(*this);
 }
@@ -209,26 +396,61 @@ void NonbondedForce::createExceptionsFromBonds(const vector<pair<int, int> >& bo
     for (auto& bond : bonds)
         if (bond.first < 0 || bond.second < 0 || bond.first >= particles.size() || bond.second >= particles.size())
             throw OpenMMException("createExceptionsFromBonds: Illegal particle index in list of bonds");
+    int numParticles = particles.size();
 
-    // Find particles separated by 1, 2, or 3 bonds.
+    // Build the bond graph in compressed sparse row format.  Duplicate bonds are harmless, since
+    // they are removed along with everything else reachable by more than one path.
 
-    vector<set<int> > exclusions(particles.size());
-    vector<set<int> > bonded12(exclusions.size());
+    vector<int> bondStart(numParticles+1, 0);
     for (auto& bond : bonds) {
-        bonded12[bond.first].insert(bond.second);
-        bonded12[bond.second].insert(bond.first);
+        bondStart[bond.first+1]++;
+        bondStart[bond.second+1]++;
     }
-    for (int i = 0; i < (int) exclusions.size(); ++i)
-        addExclusionsToSet(bonded12, exclusions[i], i, i, 2);
-
-    // Find particles separated by 1 or 2 bonds and create the exceptions.
-
-    for (int i = 0; i < (int) exclusions.size(); ++i) {
-        set<int> bonded13;
-        addExclusionsToSet(bonded12, bonded13, i, i, 1);
-        for (int j : exclusions[i]) {
-            if (j < i) {
-                if (bonded13.find(j) == bonded13.end()) {
+    for (int i = 0; i < numParticles; i++)
+        bondStart[i+1] += bondStart[i];
+    vector<int> bondedTo(bondStart[numParticles]);
+    vector<int> nextSlot(bondStart.begin(), bondStart.end()-1);
+    for (auto& bond : bonds) {
+        bondedTo[nextSlot[bond.first]++] = bond.second;
+        bondedTo[nextSlot[bond.second]++] = bond.first;
+    }
+    nextSlot.clear();
+    nextSlot.shrink_to_fit();
+
+    // For each particle, find the lower numbered particles separated from it by 1, 2, or 3 bonds, and
+    // create an exception for each one.  Particles are processed in blocks that are independent of
+    // each other, so they can be handled in parallel.  Concatenating the blocks in order produces
+    // exactly the same list of exceptions as processing the particles one at a time.
+
+    const int numBlocks = (numParticles+ExceptionBlockSize-1)/ExceptionBlockSize;
+    vector<vector<ExceptionInfo> > blockExceptions(numBlocks);
+    auto processBlock = [&] (int block, vector<pair<int, int> >& nearby) {
+        vector<ExceptionInfo>& blockList = blockExceptions[block];
+        int start = block*ExceptionBlockSize;
+        int end = std::min(start+ExceptionBlockSize, numParticles);
+        for (int i = start; i < end; i++) {
+            // Record every particle reachable within three bonds along with the number of bonds
+            // on the path, then sort so the shortest path to each particle comes first.
+
+            nearby.clear();
+            for (int k = bondStart[i]; k < bondStart[i+1]; k++) {
+                int a = bondedTo[k];
+                nearby.push_back(std::make_pair(a, 1));
+                for (int l = bondStart[a]; l < bondStart[a+1]; l++) {
+                    int b = bondedTo[l];
+                    nearby.push_back(std::make_pair(b, 2));
+                    for (int m = bondStart[b]; m < bondStart[b+1]; m++)
+                        nearby.push_back(std::make_pair(bondedTo[m], 3));
+                }
+            }
+            std::sort(nearby.begin(), nearby.end());
+            for (int k = 0; k < (int) nearby.size(); k++) {
+                int j = nearby[k].first;
+                if (j >= i)
+                    break;
+                if (k > 0 && nearby[k-1].first == j)
+                    continue;
+                if (nearby[k].second == 3) {
                     // This is a 1-4 interaction.
 
                     const ParticleInfo& particle1 = particles[j];
@@ -236,27 +458,160 @@ void NonbondedForce::createExceptionsFromBonds(const vector<pair<int, int> >& bo
                     const double chargeProd = coulomb14Scale*particle1.charge*particle2.charge;
                     const double sigma = 0.5*(particle1.sigma+particle2.sigma);
                     const double epsilon = lj14Scale*std::sqrt(particle1.epsilon*particle2.epsilon);
-                    addException(j, i, chargeProd, sigma, epsilon);
+                    blockList.push_back(ExceptionInfo(j, i, chargeProd, sigma, epsilon));
                 }
                 else {
                     // This interaction should be completely excluded.
 
-                    addException(j, i, 0.0, 1.0, 0.0);
+                    blockList.push_back(ExceptionInfo(j, i, 0.0, 1.0, 0.0));
                 }
             }
         }
+    };
+    if (numParticles < MinParticlesForThreads) {
+        vector<pair<int, int> > nearby;
+        for (int block = 0; block < numBlocks; block++)
+            processBlock(block, nearby);
+    }
+    else {
+        ThreadPool threads;
+        std::atomic<int> nextBlock(0);
+        threads.execute([&] (ThreadPool& pool, int threadIndex) {
+            vector<pair<int, int> > nearby;
+            while (true) {
+                int block = nextBlock++;
+                if (block >= numBlocks)
+                    break;
+                processBlock(block, nearby);
+            }
+        });
+        threads.waitForThreads();
+    }
+
+    // Make sure none of the new exceptions conflicts with an existing one before modifying anything.
+
+    if (!exceptionIndex.empty())
+        for (auto& blockList : blockExceptions)
+            for (auto& exception : blockList)
+                if (exceptionIndex.find(exception.particle1, exception.particle2) != -1)
+                    throwDuplicateException(exception.particle1, exception.particle2);
+
+    // Append the exceptions in bulk, sizing the index once up front.
+
+    size_t numNew = 0;
+    for (auto& blockList : blockExceptions)
+        numNew += blockList.size();
+    reserveCapacity(exceptions, exceptions.size()+numNew);
+    exceptionIndex.reserve(exceptions.size()+numNew);
+    for (auto& blockList : blockExceptions) {
+        for (auto& exception : blockList) {
+            exceptionIndex.insert(exception.particle1, exception.particle2, exceptions.size());
+            exceptions.push_back(exception);
+        }
+        vector<ExceptionInfo>().swap(blockList);
     }
 }
 
-void NonbondedForce::addExclusionsToSet(const vector<set<int> >& bonded12, set<int>& exclusions, int baseParticle, int fromParticle, int currentLevel) const {
-    for (int i : bonded12[fromParticle]) {
-        if (i != baseParticle)
-            exclusions.insert(i);
-        if (currentLevel > 0)
-            addExclusionsToSet(bonded12, exclusions, baseParticle, i, currentLevel-1);
+NonbondedForce::ExceptionIndex::ExceptionIndex() : size(0) {
+}
+
+long long NonbondedForce::ExceptionIndex::makeKey(int particle1, int particle2) {
+    // Exceptions are symmetric, so put the smaller index in the high bits.
+
+    if (particle1 > particle2)
+        std::swap(particle1, particle2);
+    return (long long) (((unsigned long long) (unsigned int) particle1 << 32) | (unsigned int) particle2);
+}
+
+size_t NonbondedForce::ExceptionIndex::hashKey(long long key) {
+    // The splitmix64 finalizer spreads consecutive keys across the whole table.
+
+    unsigned long long h = (unsigned long long) key;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return (size_t) (h ^ (h >> 31));
+}
+
+int NonbondedForce::ExceptionIndex::find(int particle1, int particle2) const {
+    if (size == 0)
+        return -1;
+    long long key = makeKey(particle1, particle2);
+    size_t mask = keys.size()-1;
+    for (size_t slot = hashKey(key)&mask; ; slot = (slot+1)&mask) {
+        if (values[slot] == -1 || keys[slot] == key)
+            return values[slot];
     }
 }
 
+void NonbondedForce::ExceptionIndex::insert(int particle1, int particle2, int index) {
+    if (4*((size_t) size+1) > 3*keys.size())
+        rehash(keys.size() == 0 ? 16 : 2*keys.size());
+    long long key = makeKey(particle1, particle2);
+    size_t mask = keys.size()-1;
+    size_t slot = hashKey(key)&mask;
+    while (values[slot] != -1 && keys[slot] != key)
+        slot = (slot+1)&mask;
+    if (values[slot] == -1) {
+        keys[slot] = key;
+        size++;
+    }
+    values[slot] = index;
+}
+
+void NonbondedForce::ExceptionIndex::erase(int particle1, int particle2) {
+    if (size == 0)
+        return;
+    long long key = makeKey(particle1, particle2);
+    size_t mask = keys.size()-1;
+    size_t slot = hashKey(key)&mask;
+    while (values[slot] != -1 && keys[slot] != key)
+        slot = (slot+1)&mask;
+    if (values[slot] == -1)
+        return;
+
+    // Move later entries back to fill the gap, so a lookup never stops early at the empty slot.  An entry can be
+    // moved as long as its home slot does not lie between the gap and its current position.
+
+    size_t next = slot;
+    while (true) {
+        next = (next+1)&mask;
+        if (values[next] == -1)
+            break;
+        size_t home = hashKey(keys[next])&mask;
+        if (((next-home)&mask) >= ((next-slot)&mask)) {
+            keys[slot] = keys[next];
+            values[slot] = values[next];
+            slot = next;
+        }
+    }
+    values[slot] = -1;
+    size--;
+}
+
+void NonbondedForce::ExceptionIndex::reserve(int count) {
+    size_t capacity = (keys.size() == 0 ? 16 : keys.size());
+    while (4*(size_t) count > 3*capacity)
+        capacity *= 2;
+    if (capacity > keys.size())
+        rehash(capacity);
+}
+
+void NonbondedForce::ExceptionIndex::rehash(size_t capacity) {
+    vector<long long> oldKeys(capacity);
+    vector<int> oldValues(capacity, -1);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    size_t mask = capacity-1;
+    for (size_t i = 0; i < oldKeys.size(); i++)
+        if (oldValues[i] != -1) {
+            size_t slot = hashKey(oldKeys[i])&mask;
+            while (values[slot] != -1)
+                slot = (slot+1)&mask;
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+        }
+}
+
 int NonbondedForce::addGlobalParameter(const string& name, double defaultValue) {
     globalParameters.push_back(GlobalParameterInfo(name, defaultValue));
     return globalParameters.size()-1;
@@ -349,6 +704,22 @@ void NonbondedForce::updateParametersInContext(Context& context) {
     dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
 }
 
+void NonbondedForce::updateParametersInContext(Context& context, int firstParticle, int lastParticle, int firstException, int lastException) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context), firstParticle, lastParticle, firstException, lastException);
+}
+
+void NonbondedForce::updateParametersInContext(Context& context, const vector<int>& particles, const vector<int>& exceptions) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context), particles, exceptions);
+}
+
+void NonbondedForce::updateChargesInContext(Context& context, const vector<int>& particles, const vector<int>& exceptions) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).updateChargesInContext(getContextImpl(context), particles, exceptions);
+}
+
+void NonbondedForce::computeEnergiesInContext(Context& context, const vector<vector<double> >& parameterValues, vector<double>& energies) {
+    dynamic_cast<NonbondedForceImpl&>(getImplInContext(context)).computeEnergies(getContextImpl(context), parameterValues, energies);
+}
+
 bool NonbondedForce::getExceptionsUsePeriodicBoundaryConditions() const {
     return exceptionsUsePeriodic;
 }
@@ -35,9 +35,19 @@
 #include "openmm/OpenMMException.h"
 #include "openmm/internal/ContextImpl.h"
 #include "internal/NonbondedForceImpl.h"
+#include "internal/DispersionCorrection.h"
+#include "internal/EwaldErrorEstimator.h"
 #include "ExampleKernels.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/reference/ReferencePME.h"
+#include <array>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <algorithm>
 
@@ -63,8 +73,12 @@ void NonbondedForceImpl::initialize(ContextImpl& context) {
         if (owner.getSwitchingDistance() < 0 || owner.getSwitchingDistance() >= owner.getCutoffDistance())
             throw OpenMMException("NonbondedForce: Switching distance must satisfy 0 <= r_switch < r_cutoff");
     }
-    vector<set<int> > exceptions(owner.getNumParticles());
-    for (int i = 0; i < owner.getNumExceptions(); i++) {
+
+    // Store each exception's particles with the smaller index first, then sort them so that any
+    // duplicates end up next to each other.  The sorted list is passed on to the kernel.
+
+    vector<pair<int, int> > exclusions(owner.getNumExceptions());
+    for (int i = 0; i < (int) exclusions.size(); i++) {
         int particle1, particle2;
         double chargeProd, sigma, epsilon;
         owner.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
@@ -80,17 +94,18 @@ void NonbondedForceImpl::initialize(ContextImpl& context) {
             msg << particle2;
             throw OpenMMException(msg.str());
         }
-        if (exceptions[particle1].count(particle2) > 0 || exceptions[particle2].count(particle1) > 0) {
+        exclusions[i] = make_pair(min(particle1, particle2), max(particle1, particle2));
+    }
+    sortExclusions(exclusions);
+    for (int i = 1; i < (int) exclusions.size(); i++)
+        if (exclusions[i] == exclusions[i-1]) {
             stringstream msg;
             msg << "NonbondedForce: Multiple exceptions are specified for particles ";
-            msg << particle1;
+            msg << exclusions[i].first;
             msg << " and ";
-            msg << particle2;
+            msg << exclusions[i].second;
             throw OpenMMException(msg.str());
         }
-        exceptions[particle1].insert(particle2);
-        exceptions[particle2].insert(particle1);
-    }
     if (owner.getNonbondedMethod() != NonbondedForce::NoCutoff && owner.getNonbondedMethod() != NonbondedForce::CutoffNonPeriodic) {
         Vec3 boxVectors[3];
         system.getDefaultPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
@@ -100,7 +115,35 @@ void NonbondedForceImpl::initialize(ContextImpl& context) {
         if (owner.getNonbondedMethod() == NonbondedForce::Ewald && (boxVectors[1][0] != 0.0 || boxVectors[2][0] != 0.0 || boxVectors[2][1] != 0))
             throw OpenMMException("NonbondedForce: Ewald is not supported with non-rectangular boxes.  Use PME instead.");
     }
-    kernel.getAs<CalcNonbondedForceKernel>().initialize(context.getSystem(), owner);
+    kernel.getAs<CalcNonbondedForceKernel>().initialize(context.getSystem(), owner, exclusions);
+}
+
+void NonbondedForceImpl::sortExclusions(vector<pair<int, int> >& exclusions, int numThreads) {
+    // Large lists are split into one block per thread, the blocks are sorted in parallel, and then
+    // adjacent blocks are merged pairwise until only one remains.
+
+    const int MinExclusionsForThreads = 100000;
+    if (exclusions.size() < MinExclusionsForThreads) {
+        sort(exclusions.begin(), exclusions.end());
+        return;
+    }
+    ThreadPool threads(numThreads);
+    int numBlocks = threads.getNumThreads();
+    vector<size_t> blockStart(numBlocks+1);
+    for (int i = 0; i <= numBlocks; i++)
+        blockStart[i] = exclusions.size()*i/numBlocks;
+    auto begin = exclusions.begin();
+    threads.execute([&] (ThreadPool& pool, int threadIndex) {
+        sort(begin+blockStart[threadIndex], begin+blockStart[threadIndex+1]);
+    });
+    threads.waitForThreads();
+    for (int width = 1; width < numBlocks; width *= 2) {
+        threads.execute([&] (ThreadPool& pool, int threadIndex) {
+            for (int block = 2*width*threadIndex; block+width < numBlocks; block += 2*width*pool.getNumThreads())
+                inplace_merge(begin+blockStart[block], begin+blockStart[block+width], begin+blockStart[min(block+2*width, numBlocks)]);
+        });
+        threads.waitForThreads();
+    }
 }
 
 double NonbondedForceImpl::calcForcesAndEnergy(ContextImpl& context, bool includeForces, bool includeEnergy, int groups) {
@@ -157,7 +200,7 @@ void NonbondedForceImpl::calcEwaldParameters(const OpenMM::System& system, const
         kmaxz++;
 }
 
-void NonbondedForceImpl::calcPMEParameters(const OpenMM::System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj) {
+void NonbondedForceImpl::calcPMEParameters(const OpenMM::System& system, const NonbondedForce& force, double& alpha, int& xsize, int& ysize, int& zsize, bool lj, bool tune) {
     if (lj)
         force.getLJPMEParameters(alpha, xsize, ysize, zsize);
     else
@@ -180,7 +223,286 @@ void NonbondedForceImpl::calcPMEParameters(const OpenMM::System& system, const N
         xsize = max(xsize, 6);
         ysize = max(ysize, 6);
         zsize = max(zsize, 6);
+        if (!lj && tune && force.getUsePMETuning())
+            tunePMEGridSize(system, force, alpha, xsize, ysize, zsize);
+    }
+}
+
+/**
+ * Get the smallest size that is at least n and has no prime factors larger than 7.  These are the
+ * sizes that FFT libraries handle efficiently.
+ */
+static int findFFTFriendlySize(int n) {
+    while (true) {
+        int remainder = n;
+        for (int factor : {2, 3, 5, 7})
+            while (remainder%factor == 0)
+                remainder /= factor;
+        if (remainder == 1)
+            return n;
+        n++;
+    }
+}
+
+/**
+ * Add the bytes of a value to a 64 bit FNV-1a hash.
+ */
+template <class T>
+static void hashValue(unsigned long long& hash, const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    for (int i = 0; i < (int) sizeof(T); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+template <class T>
+static void hashValues(unsigned long long& hash, const vector<T>& values) {
+    for (const T& value : values)
+        hashValue(hash, value);
+}
+
+static void hashString(unsigned long long& hash, const string& value) {
+    for (char c : value)
+        hashValue(hash, c);
+    hashValue(hash, '\0');
+}
+
+unsigned long long NonbondedForceImpl::computeHash(const NonbondedForce& force, bool includeParameters) {
+    unsigned long long hash = 14695981039346656037ULL;
+    int numParticles = force.getNumParticles();
+    int numExceptions = force.getNumExceptions();
+    hashValue(hash, numParticles);
+    hashValue(hash, numExceptions);
+    hashValue(hash, force.getNumParticleParameterOffsets());
+    hashValue(hash, force.getNumExceptionParameterOffsets());
+    hashValue(hash, (int) force.getNonbondedMethod());
+    hashValue(hash, force.getCutoffDistance());
+    hashValue(hash, force.getUseSwitchingFunction());
+    hashValue(hash, force.getSwitchingDistance());
+    hashValue(hash, force.getReactionFieldDielectric());
+    hashValue(hash, force.getEwaldErrorTolerance());
+    hashValue(hash, force.getUseDispersionCorrection());
+    hashValue(hash, force.getExceptionsUsePeriodicBoundaryConditions());
+    double alpha;
+    int nx, ny, nz;
+    force.getPMEParameters(alpha, nx, ny, nz);
+    hashValue(hash, alpha);
+    hashValue(hash, nx);
+    hashValue(hash, ny);
+    hashValue(hash, nz);
+    force.getLJPMEParameters(alpha, nx, ny, nz);
+    hashValue(hash, alpha);
+    hashValue(hash, nx);
+    hashValue(hash, ny);
+    hashValue(hash, nz);
+    hashValue(hash, force.getNumGlobalParameters());
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        hashString(hash, force.getGlobalParameterName(i));
+    if (!includeParameters)
+        return hash;
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        hashValue(hash, force.getGlobalParameterDefaultValue(i));
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
+    hashValues(hash, charges);
+    hashValues(hash, sigmas);
+    hashValues(hash, epsilons);
+    vector<int> particles1, particles2;
+    vector<double> chargeProds;
+    force.getExceptionParameters(0, numExceptions, particles1, particles2, chargeProds, sigmas, epsilons);
+    hashValues(hash, particles1);
+    hashValues(hash, particles2);
+    hashValues(hash, chargeProds);
+    hashValues(hash, sigmas);
+    hashValues(hash, epsilons);
+    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
+        string parameter;
+        int index;
+        double chargeScale, sigmaScale, epsilonScale;
+        force.getParticleParameterOffset(i, parameter, index, chargeScale, sigmaScale, epsilonScale);
+        hashString(hash, parameter);
+        hashValue(hash, index);
+        hashValue(hash, chargeScale);
+        hashValue(hash, sigmaScale);
+        hashValue(hash, epsilonScale);
     }
+    for (int i = 0; i < force.getNumExceptionParameterOffsets(); i++) {
+        string parameter;
+        int index;
+        double chargeProdScale, sigmaScale, epsilonScale;
+        force.getExceptionParameterOffset(i, parameter, index, chargeProdScale, sigmaScale, epsilonScale);
+        hashString(hash, parameter);
+        hashValue(hash, index);
+        hashValue(hash, chargeProdScale);
+        hashValue(hash, sigmaScale);
+        hashValue(hash, epsilonScale);
+    }
+    return hash;
+}
+
+unsigned long long NonbondedForceImpl::computeFingerprint(const OpenMM::System& system, const NonbondedForce& force) {
+    unsigned long long hash = computeHash(force);
+    Vec3 boxVectors[3];
+    system.getDefaultPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            hashValue(hash, boxVectors[i][j]);
+    return hash;
+}
+
+/**
+ * The PME tuning cache is a text file.  The first line identifies the format, and each following line holds a
+ * fingerprint followed by the three dimensions of the grid that was chosen.  Lines that cannot be parsed are
+ * ignored, and if a fingerprint appears more than once, the last entry is used.  A file whose first line is
+ * anything else is never read or modified.
+ */
+static const char* PMETuningCacheHeader = "OpenMMExamplePMETuningCache 1";
+
+static map<string, array<int, 3> > readPMETuningCache(const string& file) {
+    map<string, array<int, 3> > entries;
+    ifstream in(file.c_str());
+    string line;
+    if (!getline(in, line) || line != PMETuningCacheHeader)
+        return entries;
+    while (getline(in, line)) {
+        stringstream fields(line);
+        string key;
+        array<int, 3> grid;
+        if (fields >> key >> grid[0] >> grid[1] >> grid[2] && grid[0] > 0 && grid[1] > 0 && grid[2] > 0)
+            entries[key] = grid;
+    }
+    return entries;
+}
+
+static void appendToPMETuningCache(const string& file, const string& key, const array<int, 3>& grid) {
+    // Results are only ever appended, never rewritten, so entries added by other processes cannot be lost.
+    // Each entry is written with a single call on a file opened for appending, which the operating system
+    // performs atomically on local file systems.  If two processes create the file at the same time, the
+    // header may appear twice, but the second copy is ignored like any other line that is not an entry.
+    // Failing to store a result is not an error, since it only means the grid will be tuned again next time.
+
+    string header;
+    {
+        ifstream in(file.c_str());
+        if (getline(in, header) && header != PMETuningCacheHeader)
+            return;
+    }
+    stringstream entry;
+    if (header.empty())
+        entry << PMETuningCacheHeader << "\n";
+    entry << key << " " << grid[0] << " " << grid[1] << " " << grid[2] << "\n";
+    string text = entry.str();
+    FILE* out = fopen(file.c_str(), "ab");
+    if (out == NULL)
+        return;
+    fwrite(text.c_str(), 1, text.size(), out);
+    fclose(out);
+}
+
+void NonbondedForceImpl::tunePMEGridSize(const OpenMM::System& system, const NonbondedForce& force, double alpha, int& xsize, int& ysize, int& zsize) {
+    // Timings vary from run to run, so remember the grid chosen for each configuration.  Every Context created
+    // for an identical force in this process then gets the same grid.
+
+    static mutex tunedGridsLock;
+    static map<unsigned long long, array<int, 3> > tunedGrids;
+    unsigned long long fingerprint = computeFingerprint(system, force);
+    {
+        lock_guard<mutex> lock(tunedGridsLock);
+        auto tuned = tunedGrids.find(fingerprint);
+        if (tuned != tunedGrids.end()) {
+            xsize = tuned->second[0];
+            ysize = tuned->second[1];
+            zsize = tuned->second[2];
+            return;
+        }
+    }
+
+    // If the result of tuning an identical force is cached, use it.  A cached grid smaller than the standard
+    // one would not meet the error tolerance, so it cannot be a valid result and is ignored.
+
+    const string& cacheFile = force.getPMETuningCacheFile();
+    string key;
+    if (!cacheFile.empty()) {
+        stringstream keyStream;
+        keyStream << hex << setw(16) << setfill('0') << fingerprint;
+        key = keyStream.str();
+        map<string, array<int, 3> > entries = readPMETuningCache(cacheFile);
+        auto entry = entries.find(key);
+        if (entry != entries.end() && entry->second[0] >= xsize && entry->second[1] >= ysize && entry->second[2] >= zsize) {
+            xsize = entry->second[0];
+            ysize = entry->second[1];
+            zsize = entry->second[2];
+            lock_guard<mutex> lock(tunedGridsLock);
+            tunedGrids[fingerprint] = entry->second;
+            return;
+        }
+    }
+
+    // The direct space cost is set by the cutoff, which is fixed, so only the grid can be traded for speed.
+    // Any grid at least as large as the standard one meets the error tolerance.  Try the standard grid
+    // followed by a few successively larger grids with FFT friendly dimensions.
+
+    const int NumLargerGrids = 4;
+    const int NumRepetitions = 5;
+    vector<array<int, 3> > candidates;
+    candidates.push_back({{xsize, ysize, zsize}});
+    array<int, 3> grid = {{findFFTFriendlySize(xsize), findFFTFriendlySize(ysize), findFFTFriendlySize(zsize)}};
+    for (int i = 0; i < NumLargerGrids; i++) {
+        if (grid != candidates.back())
+            candidates.push_back(grid);
+        for (int j = 0; j < 3; j++)
+            grid[j] = findFFTFriendlySize(grid[j]+1);
+    }
+
+    // Time each candidate on a random configuration with the real charges.  The cost of the reciprocal
+    // space calculation does not depend on where the particles are.
+
+    int numParticles = system.getNumParticles();
+    Vec3 boxVectors[3];
+    system.getDefaultPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
+    vector<Vec3> positions(numParticles), forces(numParticles);
+    unsigned int seed = 1;
+    auto random = [&] () {
+        seed = seed*1103515245u+12345u;
+        return (seed>>8)/(double) (1<<24);
+    };
+    for (int i = 0; i < numParticles; i++)
+        positions[i] = boxVectors[0]*random()+boxVectors[1]*random()+boxVectors[2]*random();
+    // Only the calculation itself is timed, not setting up the grid and FFT plans.  The first call is a warm
+    // up.  A larger grid is only chosen if it is clearly faster than the best so far, so that noise in the
+    // timings does not decide between grids that perform the same.
+
+    const double RequiredSpeedup = 0.9;
+    double bestTime = 0.0;
+    for (int i = 0; i < (int) candidates.size(); i++) {
+        pme_t pme;
+        double energy;
+        pme_init(&pme, alpha, numParticles, candidates[i].data(), 5, 1);
+        pme_exec(pme, positions, forces, charges, boxVectors, &energy);
+        double time = 0.0;
+        for (int j = 0; j < NumRepetitions; j++) {
+            auto start = chrono::steady_clock::now();
+            pme_exec(pme, positions, forces, charges, boxVectors, &energy);
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            time = (j == 0 ? elapsed : min(time, elapsed));
+        }
+        pme_destroy(pme);
+        if (i == 0 || time < RequiredSpeedup*bestTime) {
+            bestTime = time;
+            xsize = candidates[i][0];
+            ysize = candidates[i][1];
+            zsize = candidates[i][2];
+        }
+    }
+    {
+        lock_guard<mutex> lock(tunedGridsLock);
+        tunedGrids[fingerprint] = {{xsize, ysize, zsize}};
+    }
+    if (!cacheFile.empty())
+        appendToPMETuningCache(cacheFile, key, {{xsize, ysize, zsize}});
 }
 
 int NonbondedForceImpl::findZero(const NonbondedForceImpl::ErrorFunction& f, int initialGuess) {
@@ -236,84 +558,70 @@ double NonbondedForceImpl::evalIntegral(double r, double rs, double rc, double s
 double NonbondedForceImpl::calcDispersionCorrection(const OpenMM::System& system, const NonbondedForce& force) {
     if (force.getNonbondedMethod() == NonbondedForce::NoCutoff || force.getNonbondedMethod() == NonbondedForce::CutoffNonPeriodic)
         return 0.0;
+    DispersionCorrection correction(force);
+    return correction.getCoefficient();
+}
 
-    // Record sigma and epsilon for every particle, including the default value
-    // for every offset parameter.
-
-    vector<double> sigma(force.getNumParticles()), epsilon(force.getNumParticles());
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge;
-        force.getParticleParameters(i, charge, sigma[i], epsilon[i]);
-    }
-    map<string, double> param;
-    for (int i = 0; i < force.getNumGlobalParameters(); i++)
-        param[force.getGlobalParameterName(i)] = force.getGlobalParameterDefaultValue(i);
-    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
-        string parameter;
-        int index;
-        double chargeScale, sigmaScale, epsilonScale;
-        force.getParticleParameterOffset(i, parameter, index, chargeScale, sigmaScale, epsilonScale);
-        sigma[index] += param[parameter]*sigmaScale;
-        epsilon[index] += param[parameter]*epsilonScale;
-    }
+void NonbondedForceImpl::updateParametersInContext(ContextImpl& context) {
+    kernel.getAs<CalcNonbondedForceKernel>().copyParametersToContext(context, owner);
+    context.systemChanged();
+}
 
-    // Identify all particle classes (defined by sigma and epsilon), and count the number of
-    // particles in each class.
-
-    map<pair<double, double>, int> classCounts;
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        pair<double, double> key = make_pair(sigma[i], epsilon[i]);
-        map<pair<double, double>, int>::iterator entry = classCounts.find(key);
-        if (entry == classCounts.end())
-            classCounts[key] = 1;
-        else
-            entry->second++;
-    }
+void NonbondedForceImpl::updateParametersInContext(ContextImpl& context, int firstParticle, int lastParticle, int firstException, int lastException) {
+    if (firstParticle <= lastParticle && (firstParticle < 0 || lastParticle >= owner.getNumParticles()))
+        throw OpenMMException("updateParametersInContext: Illegal range of particles");
+    if (firstException <= lastException && (firstException < 0 || lastException >= owner.getNumExceptions()))
+        throw OpenMMException("updateParametersInContext: Illegal range of exceptions");
+    vector<int> particles, exceptions;
+    for (int i = firstParticle; i <= lastParticle; i++)
+        particles.push_back(i);
+    for (int i = firstException; i <= lastException; i++)
+        exceptions.push_back(i);
+    updateParametersInContext(context, particles, exceptions);
+}
 
-    // Loop over all pairs of classes to compute the coefficient.
-
-    double sum1 = 0, sum2 = 0, sum3 = 0;
-    bool useSwitch = force.getUseSwitchingFunction();
-    double cutoff = force.getCutoffDistance();
-    double switchDist = force.getSwitchingDistance();
-    for (map<pair<double, double>, int>::const_iterator entry = classCounts.begin(); entry != classCounts.end(); ++entry) {
-        double sigma = entry->first.first;
-        double epsilon = entry->first.second;
-        double count = (double) entry->second;
-        count *= (count + 1) / 2;
-        double sigma2 = sigma*sigma;
-        double sigma6 = sigma2*sigma2*sigma2;
-        sum1 += count*epsilon*sigma6*sigma6;
-        sum2 += count*epsilon*sigma6;
-        if (useSwitch)
-            sum3 += count*epsilon*(evalIntegral(cutoff, switchDist, cutoff, sigma)-evalIntegral(switchDist, switchDist, cutoff, sigma));
-    }
-    for (map<pair<double, double>, int>::const_iterator class1 = classCounts.begin(); class1 != classCounts.end(); ++class1)
-        for (map<pair<double, double>, int>::const_iterator class2 = classCounts.begin(); class2 != class1; ++class2) {
-            double sigma = 0.5*(class1->first.first+class2->first.first);
-            double epsilon = sqrt(class1->first.second*class2->first.second);
-            double count = (double) class1->second;
-            count *= (double) class2->second;
-            double sigma2 = sigma*sigma;
-            double sigma6 = sigma2*sigma2*sigma2;
-            sum1 += count*epsilon*sigma6*sigma6;
-            sum2 += count*epsilon*sigma6;
-            if (useSwitch)
-                sum3 += count*epsilon*(evalIntegral(cutoff, switchDist, cutoff, sigma)-evalIntegral(switchDist, switchDist, cutoff, sigma));
-        }
-    double numParticles = (double) system.getNumParticles();
-    double numInteractions = (numParticles*(numParticles+1))/2;
-    sum1 /= numInteractions;
-    sum2 /= numInteractions;
-    sum3 /= numInteractions;
-    return 8*numParticles*numParticles*M_PI*(sum1/(9*pow(cutoff, 9))-sum2/(3*pow(cutoff, 3))+sum3);
+void NonbondedForceImpl::updateParametersInContext(ContextImpl& context, const vector<int>& particles, const vector<int>& exceptions) {
+    for (int particle : particles)
+        if (particle < 0 || particle >= owner.getNumParticles())
+            throw OpenMMException("updateParametersInContext: Illegal particle index");
+    for (int exception : exceptions)
+        if (exception < 0 || exception >= owner.getNumExceptions())
+            throw OpenMMException("updateParametersInContext: Illegal exception index");
+    if (particles.size() == 0 && exceptions.size() == 0)
+        return;
+    kernel.getAs<CalcNonbondedForceKernel>().copyParametersToContext(context, owner, particles, exceptions);
+    context.systemChanged();
 }
 
-void NonbondedForceImpl::updateParametersInContext(ContextImpl& context) {
-    kernel.getAs<CalcNonbondedForceKernel>().copyParametersToContext(context, owner);
+void NonbondedForceImpl::updateChargesInContext(ContextImpl& context, const vector<int>& particles, const vector<int>& exceptions) {
+    for (int particle : particles)
+        if (particle < 0 || particle >= owner.getNumParticles())
+            throw OpenMMException("updateChargesInContext: Illegal particle index");
+    for (int exception : exceptions)
+        if (exception < 0 || exception >= owner.getNumExceptions())
+            throw OpenMMException("updateChargesInContext: Illegal exception index");
+    if (particles.size() == 0 && exceptions.size() == 0)
+        return;
+    kernel.getAs<CalcNonbondedForceKernel>().copyChargesToContext(context, owner, particles, exceptions);
     context.systemChanged();
 }
 
+void NonbondedForceImpl::computeEnergies(ContextImpl& context, const vector<vector<double> >& parameterValues, vector<double>& energies) {
+    for (int i = 0; i < parameterValues.size(); i++)
+        if (parameterValues[i].size() != owner.getNumGlobalParameters()) {
+            stringstream msg;
+            msg << "computeEnergiesInContext: State ";
+            msg << i;
+            msg << " must specify a value for each of the ";
+            msg << owner.getNumGlobalParameters();
+            msg << " global parameters";
+            throw OpenMMException(msg.str());
+        }
+    if (owner.getNonbondedMethod() == NonbondedForce::LJPME)
+        throw OpenMMException("computeEnergiesInContext: This method is not supported with LJPME");
+    kernel.getAs<CalcNonbondedForceKernel>().computeEnergies(context, parameterValues, energies);
+}
+
 void NonbondedForceImpl::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
     kernel.getAs<CalcNonbondedForceKernel>().getPMEParameters(alpha, nx, ny, nz);
 }
@@ -321,3 +629,97 @@ void NonbondedForceImpl::getPMEParameters(double& alpha, int& nx, int& ny, int&
 void NonbondedForceImpl::getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
     kernel.getAs<CalcNonbondedForceKernel>().getLJPMEParameters(alpha, nx, ny, nz);
 }
+
+void NonbondedForceImpl::setNumThreads(int numThreads) {
+    kernel.getAs<CalcNonbondedForceKernel>().setNumThreads(numThreads);
+}
+
+int NonbondedForceImpl::getNumThreads() const {
+    return kernel.getAs<CalcNonbondedForceKernel>().getNumThreads();
+}
+
+void NonbondedForceImpl::setTimingEnabled(bool enabled) {
+    kernel.getAs<CalcNonbondedForceKernel>().setTimingEnabled(enabled);
+}
+
+void NonbondedForceImpl::getTimingStatistics(map<string, double>& times, int& numEvaluations) const {
+    kernel.getAs<CalcNonbondedForceKernel>().getTimingStatistics(times, numEvaluations);
+}
+
+void NonbondedForceImpl::getThreadStatistics(vector<int>& blocks, vector<long long>& interactions, vector<double>& busyTimes,
+                                             vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const {
+    kernel.getAs<CalcNonbondedForceKernel>().getThreadStatistics(blocks, interactions, busyTimes, waitTimes, imbalance, lastEvaluation);
+}
+
+void NonbondedForceImpl::resetTimingStatistics() {
+    kernel.getAs<CalcNonbondedForceKernel>().resetTimingStatistics();
+}
+
+void NonbondedForceImpl::estimateForceError(const Context& context, int numSamples, double& rmsError, double& rmsForce) const {
+    NonbondedForce::NonbondedMethod method = owner.getNonbondedMethod();
+    if (method != NonbondedForce::Ewald && method != NonbondedForce::PME && method != NonbondedForce::LJPME)
+        throw OpenMMException("estimateForceErrorInContext: This method requires Ewald, PME, or LJPME");
+    int numParticles = owner.getNumParticles();
+    if (numSamples <= 0)
+        throw OpenMMException("estimateForceErrorInContext: The number of samples must be positive");
+    numSamples = min(numSamples, numParticles);
+    if (numSamples == 0) {
+        // There are no particles, so there is no force and no error.
+
+        rmsError = 0.0;
+        rmsForce = 0.0;
+        return;
+    }
+
+    // Collect the current state of the Context.
+
+    State state = context.getState(State::Positions);
+    const vector<Vec3>& positions = state.getPositions();
+    Vec3 boxVectors[3];
+    state.getPeriodicBoxVectors(boxVectors[0], boxVectors[1], boxVectors[2]);
+    vector<double> charges, sigmas, epsilons;
+    owner.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
+    for (int i = 0; i < owner.getNumParticleParameterOffsets(); i++) {
+        string parameter;
+        int index;
+        double chargeScale, sigmaScale, epsilonScale;
+        owner.getParticleParameterOffset(i, parameter, index, chargeScale, sigmaScale, epsilonScale);
+        charges[index] += context.getParameter(parameter)*chargeScale;
+    }
+    vector<pair<int, int> > exclusions(owner.getNumExceptions());
+    for (int i = 0; i < (int) exclusions.size(); i++) {
+        double chargeProd, sigma, epsilon;
+        owner.getExceptionParameters(i, exclusions[i].first, exclusions[i].second, chargeProd, sigma, epsilon);
+    }
+    vector<int> samples(numSamples);
+    for (int i = 0; i < numSamples; i++)
+        samples[i] = (int) ((long long) i*numParticles/numSamples);
+
+    // Compute the forces with the parameters used by the Context and with the high accuracy reference.
+
+    EwaldErrorEstimator estimator(positions, charges, boxVectors, exclusions, samples);
+    double alpha;
+    vector<Vec3> directForces, recipForces, referenceForces;
+    if (method == NonbondedForce::Ewald) {
+        int kmax[3];
+        calcEwaldParameters(context.getSystem(), owner, alpha, kmax[0], kmax[1], kmax[2]);
+        for (int i = 0; i < 3; i++)
+            kmax[i]--;
+        estimator.computeEwaldForces(alpha, kmax, 0.0, recipForces);
+    }
+    else {
+        int gridSize[3];
+        getPMEParameters(alpha, gridSize[0], gridSize[1], gridSize[2]);
+        estimator.computePMEForces(alpha, gridSize, recipForces);
+    }
+    estimator.computeDirectForces(alpha, owner.getCutoffDistance(), directForces);
+    estimator.computeReferenceForces(referenceForces);
+    double sumError = 0.0, sumForce = 0.0;
+    for (int i = 0; i < numSamples; i++) {
+        Vec3 error = directForces[i]+recipForces[i]-referenceForces[i];
+        sumError += error.dot(error);
+        sumForce += referenceForces[i].dot(referenceForces[i]);
+    }
+    rmsError = sqrt(sumError/numSamples);
+    rmsForce = sqrt(sumForce/numSamples);
+}
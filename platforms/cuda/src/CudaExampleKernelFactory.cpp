@@ -48,6 +48,7 @@ extern "C" OPENMM_EXPORT void registerKernelFactories() {
         Platform& platform = Platform::getPlatformByName("CUDA");
         CudaExampleKernelFactory* factory = new CudaExampleKernelFactory();
         platform.registerKernelFactory(CalcExampleForceKernel::Name(), factory);
+        platform.registerKernelFactory(CalcNonbondedForceKernel::Name(), factory);
     }
     catch (std::exception ex) {
         // Ignore
@@ -68,5 +69,7 @@ KernelImpl* CudaExampleKernelFactory::createKernelImpl(std::string name, const P
     CudaContext& cu = *static_cast<CudaPlatform::PlatformData*>(context.getPlatformData())->contexts[0];
     if (name == CalcExampleForceKernel::Name())
         return new CudaCalcExampleForceKernel(name, platform, cu, context.getSystem());
+    if (name == CalcNonbondedForceKernel::Name())
+        return new CudaCalcNonbondedForceKernel(name, platform, cu, context.getSystem());
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
 }
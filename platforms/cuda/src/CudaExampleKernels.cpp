@@ -42,6 +42,7 @@
 // #include "openmm/internal/ContextImpl.h"
 // #include "openmm/internal/CustomCompoundBondForceImpl.h"
 // #include "openmm/internal/CustomHbondForceImpl.h"
+#include "internal/DispersionCorrection.h"
 #include "internal/NonbondedForceImpl.h"
 // #include "openmm/internal/OSRngSeed.h"
 // #include "openmm/cuda/CudaBondedUtilities.h"
@@ -75,6 +76,24 @@ using namespace std;
         throw OpenMMException(m.str());\
     }
 
+/**
+ * Upload the elements of a host array that have the specified indices.  Each run of consecutive indices is
+ * copied at once, so the amount of data transferred depends only on the number of indices, not on how far
+ * apart they are.
+ */
+static void uploadElements(CudaArray& array, const vector<float4>& host, vector<int> indices) {
+    sort(indices.begin(), indices.end());
+    indices.erase(unique(indices.begin(), indices.end()), indices.end());
+    int numIndices = indices.size();
+    for (int start = 0; start < numIndices; ) {
+        int end = start+1;
+        while (end < numIndices && indices[end] == indices[end-1]+1)
+            end++;
+        array.uploadSubArray(&host[indices[start]], indices[start], end-start);
+        start = end;
+    }
+}
+
 class CudaExampleForceInfo : public CudaForceInfo {
 public:
     CudaExampleForceInfo(const ExampleForce& force) : force(force) {
@@ -291,6 +310,8 @@ CudaCalcNonbondedForceKernel::~CudaCalcNonbondedForceKernel() {
         delete dispersionFft;
     if (pmeio != NULL)
         delete pmeio;
+    if (dispersionCorrection != NULL)
+        delete dispersionCorrection;
     if (hasInitializedFFT) {
         if (useCudaFFT) {
             cufftDestroy(fftForward);
@@ -308,7 +329,7 @@ CudaCalcNonbondedForceKernel::~CudaCalcNonbondedForceKernel() {
     }
 }
 
-void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, const NonbondedForce& force) {
+void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, const NonbondedForce& force, const vector<pair<int, int> >& sortedExclusions) {
     cu.setAsCurrent();
     int forceIndex;
     for (forceIndex = 0; forceIndex < system.getNumForces() && &system.getForce(forceIndex) != &force; ++forceIndex)
@@ -325,15 +346,14 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
         force.getExceptionParameterOffset(i, param, exception, charge, sigma, epsilon);
         exceptionsWithOffsets.insert(exception);
     }
-    vector<pair<int, int> > exclusions;
+    vector<int> exceptionParticles1, exceptionParticles2;
+    vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+    force.getExceptionParameters(0, force.getNumExceptions(), exceptionParticles1, exceptionParticles2, chargeProds, exceptionSigmas, exceptionEpsilons);
+    const vector<pair<int, int> >& exclusions = sortedExclusions;
     vector<int> exceptions;
-    map<int, int> exceptionIndex;
+    exceptionIndex.assign(force.getNumExceptions(), -1);
     for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        exclusions.push_back(pair<int, int>(particle1, particle2));
-        if (chargeProd != 0.0 || epsilon != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end()) {
+        if (chargeProds[i] != 0.0 || exceptionEpsilons[i] != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end()) {
             exceptionIndex[i] = exceptions.size();
             exceptions.push_back(i);
         }
@@ -342,18 +362,18 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
     // Initialize nonbonded interactions.
 
     int numParticles = force.getNumParticles();
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
     vector<float4> baseParticleParamVec(cu.getPaddedNumAtoms(), make_float4(0, 0, 0, 0));
     vector<vector<int> > exclusionList(numParticles);
     hasCoulomb = false;
     hasLJ = false;
     for (int i = 0; i < numParticles; i++) {
-        double charge, sigma, epsilon;
-        force.getParticleParameters(i, charge, sigma, epsilon);
-        baseParticleParamVec[i] = make_float4(charge, sigma, epsilon, 0);
+        baseParticleParamVec[i] = make_float4(charges[i], sigmas[i], epsilons[i], 0);
         exclusionList[i].push_back(i);
-        if (charge != 0.0)
+        if (charges[i] != 0.0)
             hasCoulomb = true;
-        if (epsilon != 0.0)
+        if (epsilons[i] != 0.0)
             hasLJ = true;
     }
     for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
@@ -397,10 +417,9 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
             defines["LJ_SWITCH_C5"] = cu.doubleToString(6/pow(force.getSwitchingDistance()-force.getCutoffDistance(), 5.0));
         }
     }
-    if (force.getUseDispersionCorrection() && cu.getContextIndex() == 0 && !doLJPME)
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(system, force);
-    else
-        dispersionCoefficient = 0.0;
+    dispersionCoefficient = 0.0;
+    if (force.getUseDispersionCorrection() && cu.getContextIndex() == 0 && (nonbondedMethod == CutoffPeriodic || nonbondedMethod == Ewald || nonbondedMethod == PME))
+        dispersionCorrection = new DispersionCorrection(force);
     alpha = 0;
     ewaldSelfEnergy = 0.0;
     map<string, string> paramsDefines;
@@ -739,6 +758,7 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
     charges.initialize(cu, cu.getPaddedNumAtoms(), cu.getUseDoublePrecision() ? sizeof(double) : sizeof(float), "charges");
     baseParticleParams.initialize<float4>(cu, cu.getPaddedNumAtoms(), "baseParticleParams");
     baseParticleParams.upload(baseParticleParamVec);
+    hostBaseParticleParams = baseParticleParamVec;
     map<string, string> replacements;
     replacements["ONE_4PI_EPS0"] = cu.doubleToString(ONE_4PI_EPS0);
     if (usePosqCharges) {
@@ -766,6 +786,7 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
     int startIndex = cu.getContextIndex()*exceptions.size()/numContexts;
     int endIndex = (cu.getContextIndex()+1)*exceptions.size()/numContexts;
     int numExceptions = endIndex-startIndex;
+    exceptionStartIndex = startIndex;
     if (numExceptions > 0) {
         paramsDefines["HAS_EXCEPTIONS"] = "1";
         exceptionAtoms.resize(numExceptions);
@@ -774,12 +795,14 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
         baseExceptionParams.initialize<float4>(cu, numExceptions, "baseExceptionParams");
         vector<float4> baseExceptionParamsVec(numExceptions);
         for (int i = 0; i < numExceptions; i++) {
-            double chargeProd, sigma, epsilon;
-            force.getExceptionParameters(exceptions[startIndex+i], atoms[i][0], atoms[i][1], chargeProd, sigma, epsilon);
-            baseExceptionParamsVec[i] = make_float4(chargeProd, sigma, epsilon, 0);
+            int exception = exceptions[startIndex+i];
+            atoms[i][0] = exceptionParticles1[exception];
+            atoms[i][1] = exceptionParticles2[exception];
+            baseExceptionParamsVec[i] = make_float4(chargeProds[exception], exceptionSigmas[exception], exceptionEpsilons[exception], 0);
             exceptionAtoms[i] = make_pair(atoms[i][0], atoms[i][1]);
         }
         baseExceptionParams.upload(baseExceptionParamsVec);
+        hostBaseExceptionParams = baseExceptionParamsVec;
         map<string, string> replacements;
         replacements["APPLY_PERIODIC"] = (usePeriodic && force.getExceptionsUsePeriodicBoundaryConditions() ? "1" : "0");
         replacements["PARAMS"] = cu.getBondedUtilities().addArgument(exceptionParams.getDevicePointer(), "float4");
@@ -821,6 +844,11 @@ void CudaCalcNonbondedForceKernel::initialize(const OpenMM::System& system, cons
         exceptionOffsetVec[exceptionIndex[exception]].push_back(make_float4(charge, sigma, epsilon, paramIndex));
     }
     paramValues.resize(paramNames.size(), 0.0);
+    if (dispersionCorrection != NULL) {
+        for (int i = 0; i < paramNames.size(); i++)
+            dispersionCorrection->setParameterValue(paramNames[i], paramValues[i]);
+        dispersionCoefficient = dispersionCorrection->getCoefficient();
+    }
     particleParamOffsets.initialize<float4>(cu, max(force.getNumParticleParameterOffsets(), 1), "particleParamOffsets");
     exceptionParamOffsets.initialize<float4>(cu, max(force.getNumExceptionParameterOffsets(), 1), "exceptionParamOffsets");
     particleOffsetIndices.initialize<int>(cu, cu.getPaddedNumAtoms()+1, "particleOffsetIndices");
@@ -871,11 +899,15 @@ double CudaCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeF
         if (value != paramValues[i]) {
             paramValues[i] = value;;
             paramChanged = true;
+            if (dispersionCorrection != NULL)
+                dispersionCorrection->setParameterValue(paramNames[i], value);
         }
     }
     if (paramChanged) {
         recomputeParams = true;
         globalParams.upload(paramValues, true);
+        if (dispersionCorrection != NULL)
+            dispersionCoefficient = dispersionCorrection->getCoefficient();
     }
     double energy = (includeReciprocal ? ewaldSelfEnergy : 0.0);
     if (recomputeParams || hasOffsets) {
@@ -1083,24 +1115,24 @@ void CudaCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context,
     cu.setAsCurrent();
     if (force.getNumParticles() != cu.getNumAtoms())
         throw OpenMMException("updateParametersInContext: The number of particles has changed");
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, force.getNumParticles(), charges, sigmas, epsilons);
     if (!hasCoulomb || !hasLJ) {
         for (int i = 0; i < force.getNumParticles(); i++) {
-            double charge, sigma, epsilon;
-            force.getParticleParameters(i, charge, sigma, epsilon);
-            if (!hasCoulomb && charge != 0.0)
+            if (!hasCoulomb && charges[i] != 0.0)
                 throw OpenMMException("updateParametersInContext: The nonbonded force kernel does not include Coulomb interactions, because all charges were originally 0");
-            if (!hasLJ && epsilon != 0.0)
+            if (!hasLJ && epsilons[i] != 0.0)
                 throw OpenMMException("updateParametersInContext: The nonbonded force kernel does not include Lennard-Jones interactions, because all epsilons were originally 0");
         }
     }
+    vector<int> exceptionParticles1, exceptionParticles2;
+    vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+    force.getExceptionParameters(0, force.getNumExceptions(), exceptionParticles1, exceptionParticles2, chargeProds, exceptionSigmas, exceptionEpsilons);
     vector<int> exceptions;
     for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        if (exceptionAtoms.size() > exceptions.size() && make_pair(particle1, particle2) == exceptionAtoms[exceptions.size()])
+        if (exceptionAtoms.size() > exceptions.size() && make_pair(exceptionParticles1[i], exceptionParticles2[i]) == exceptionAtoms[exceptions.size()])
             exceptions.push_back(i);
-        else if (chargeProd != 0.0 || epsilon != 0.0)
+        else if (chargeProds[i] != 0.0 || exceptionEpsilons[i] != 0.0)
             throw OpenMMException("updateParametersInContext: The set of non-excluded exceptions has changed");
     }
     int numContexts = cu.getPlatformData().contexts.size();
@@ -1112,24 +1144,21 @@ void CudaCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context,
     
     vector<float4> baseParticleParamVec(cu.getPaddedNumAtoms(), make_float4(0, 0, 0, 0));
     const vector<int>& order = cu.getAtomIndex();
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge, sigma, epsilon;
-        force.getParticleParameters(i, charge, sigma, epsilon);
-        baseParticleParamVec[i] = make_float4(charge, sigma, epsilon, 0);
-    }
+    for (int i = 0; i < force.getNumParticles(); i++)
+        baseParticleParamVec[i] = make_float4(charges[i], sigmas[i], epsilons[i], 0);
     baseParticleParams.upload(baseParticleParamVec);
+    hostBaseParticleParams = baseParticleParamVec;
     
     // Record the exceptions.
     
     if (numExceptions > 0) {
-        vector<vector<int> > atoms(numExceptions, vector<int>(2));
         vector<float4> baseExceptionParamsVec(numExceptions);
         for (int i = 0; i < numExceptions; i++) {
-            double chargeProd, sigma, epsilon;
-            force.getExceptionParameters(exceptions[startIndex+i], atoms[i][0], atoms[i][1], chargeProd, sigma, epsilon);
-            baseExceptionParamsVec[i] = make_float4(chargeProd, sigma, epsilon, 0);
+            int exception = exceptions[startIndex+i];
+            baseExceptionParamsVec[i] = make_float4(chargeProds[exception], exceptionSigmas[exception], exceptionEpsilons[exception], 0);
         }
         baseExceptionParams.upload(baseExceptionParamsVec);
+        hostBaseExceptionParams = baseExceptionParamsVec;
     }
     
     // Compute other values.
@@ -1144,12 +1173,149 @@ void CudaCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context,
             }
         }
     }
-    if (force.getUseDispersionCorrection() && cu.getContextIndex() == 0 && (nonbondedMethod == CutoffPeriodic || nonbondedMethod == Ewald || nonbondedMethod == PME))
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(context.getSystem(), force);
+    if (dispersionCorrection != NULL) {
+        for (int i = 0; i < force.getNumParticles(); i++)
+            dispersionCorrection->setParticleParameters(i, sigmas[i], epsilons[i]);
+        dispersionCoefficient = dispersionCorrection->getCoefficient();
+    }
+    cu.invalidateMolecules();
+    recomputeParams = true;
+}
+
+void CudaCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context, const NonbondedForce& force, const vector<int>& particles, const vector<int>& exceptions) {
+    // Make sure the new parameters are acceptable before changing anything, so a failed call leaves the
+    // Context unchanged.
+
+    cu.setAsCurrent();
+    if (force.getNumParticles() != cu.getNumAtoms())
+        throw OpenMMException("updateParametersInContext: The number of particles has changed");
+    if (force.getNumExceptions() != exceptionIndex.size())
+        throw OpenMMException("updateParametersInContext: The number of exceptions has changed");
+    for (int i : particles) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i, charge, sigma, epsilon);
+        if (!hasCoulomb && charge != 0.0)
+            throw OpenMMException("updateParametersInContext: The nonbonded force kernel does not include Coulomb interactions, because all charges were originally 0");
+        if (!hasLJ && epsilon != 0.0)
+            throw OpenMMException("updateParametersInContext: The nonbonded force kernel does not include Lennard-Jones interactions, because all epsilons were originally 0");
+    }
+    int numExceptions = exceptionAtoms.size();
+    vector<int> modifiedExceptions;
+    vector<float4> exceptionParams;
+    for (int i : exceptions) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
+        if (exceptionIndex[i] == -1) {
+            if (chargeProd != 0.0 || epsilon != 0.0)
+                throw OpenMMException("updateParametersInContext: The set of non-excluded exceptions has changed");
+            continue;
+        }
+        int index = exceptionIndex[i]-exceptionStartIndex;
+        if (index < 0 || index >= numExceptions)
+            continue;
+        if (make_pair(particle1, particle2) != exceptionAtoms[index])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+        modifiedExceptions.push_back(index);
+        exceptionParams.push_back(make_float4(chargeProd, sigma, epsilon, 0));
+    }
+
+    // Upload the parameters of the listed particles, and update the Ewald self energy to match.
+
+    bool includeEwald = ((nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME) && cu.getContextIndex() == 0);
+    for (int i : particles) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i, charge, sigma, epsilon);
+        float4 oldParams = hostBaseParticleParams[i];
+        float4 newParams = make_float4(charge, sigma, epsilon, 0);
+        if (dispersionCorrection != NULL)
+            dispersionCorrection->setParticleParameters(i, sigma, epsilon);
+        if (includeEwald) {
+            ewaldSelfEnergy -= (newParams.x*newParams.x-oldParams.x*oldParams.x)*ONE_4PI_EPS0*alpha/sqrt(M_PI);
+            if (doLJPME)
+                ewaldSelfEnergy += (newParams.z*pow(newParams.y*dispersionAlpha, 6)-oldParams.z*pow(oldParams.y*dispersionAlpha, 6))/3.0;
+        }
+        hostBaseParticleParams[i] = newParams;
+    }
+    uploadElements(baseParticleParams, hostBaseParticleParams, particles);
+
+    // Upload the parameters of the listed exceptions that are handled by this context.
+
+    for (int i = 0; i < modifiedExceptions.size(); i++)
+        hostBaseExceptionParams[modifiedExceptions[i]] = exceptionParams[i];
+    uploadElements(baseExceptionParams, hostBaseExceptionParams, modifiedExceptions);
+
+    // Compute other values.
+
+    if (dispersionCorrection != NULL)
+        dispersionCoefficient = dispersionCorrection->getCoefficient();
     cu.invalidateMolecules();
     recomputeParams = true;
 }
 
+void CudaCalcNonbondedForceKernel::copyChargesToContext(ContextImpl& context, const NonbondedForce& force, const vector<int>& particles, const vector<int>& exceptions) {
+    // Make sure the new charges are acceptable before changing anything, so a failed call leaves the
+    // Context unchanged.
+
+    cu.setAsCurrent();
+    if (force.getNumParticles() != cu.getNumAtoms())
+        throw OpenMMException("updateChargesInContext: The number of particles has changed");
+    if (force.getNumExceptions() != exceptionIndex.size())
+        throw OpenMMException("updateChargesInContext: The number of exceptions has changed");
+    vector<float> charges(particles.size());
+    for (int i = 0; i < particles.size(); i++) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(particles[i], charge, sigma, epsilon);
+        if (!hasCoulomb && charge != 0.0)
+            throw OpenMMException("updateChargesInContext: The nonbonded force kernel does not include Coulomb interactions, because all charges were originally 0");
+        charges[i] = (float) charge;
+    }
+    int numExceptions = exceptionAtoms.size();
+    vector<int> modifiedExceptions;
+    vector<float> chargeProds;
+    for (int i : exceptions) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
+        if (exceptionIndex[i] == -1) {
+            if (chargeProd != 0.0)
+                throw OpenMMException("updateChargesInContext: The set of non-excluded exceptions has changed");
+            continue;
+        }
+        int index = exceptionIndex[i]-exceptionStartIndex;
+        if (index < 0 || index >= numExceptions)
+            continue;
+        if (make_pair(particle1, particle2) != exceptionAtoms[index])
+            throw OpenMMException("updateChargesInContext: A particle index has changed");
+        modifiedExceptions.push_back(index);
+        chargeProds.push_back((float) chargeProd);
+    }
+
+    // Update the charges in the host copy of the parameters, along with the Ewald self energy, then
+    // upload the modified particles.
+
+    bool includeEwald = ((nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME) && cu.getContextIndex() == 0);
+    for (int i = 0; i < particles.size(); i++) {
+        float4& params = hostBaseParticleParams[particles[i]];
+        if (includeEwald)
+            ewaldSelfEnergy -= (charges[i]*charges[i]-params.x*params.x)*ONE_4PI_EPS0*alpha/sqrt(M_PI);
+        params.x = charges[i];
+    }
+    uploadElements(baseParticleParams, hostBaseParticleParams, particles);
+
+    // Do the same for the exceptions handled by this context.
+
+    for (int i = 0; i < modifiedExceptions.size(); i++)
+        hostBaseExceptionParams[modifiedExceptions[i]].x = chargeProds[i];
+    uploadElements(baseExceptionParams, hostBaseExceptionParams, modifiedExceptions);
+    cu.invalidateMolecules();
+    recomputeParams = true;
+}
+
+void CudaCalcNonbondedForceKernel::computeEnergies(ContextImpl& context, const vector<vector<double> >& parameterValues, vector<double>& energies) {
+    throw OpenMMException("computeEnergiesInContext: This method is not supported by the CUDA platform");
+}
+
 void CudaCalcNonbondedForceKernel::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
     if (nonbondedMethod != PME)
         throw OpenMMException("getPMEParametersInContext: This Context is not using PME");
@@ -44,6 +44,8 @@
 
 namespace ExamplePlugin {
 
+class DispersionCorrection;
+
 /**
  * This kernel is invoked by ExampleForce to calculate the forces acting on the system and the energy of the system.
  */
@@ -90,16 +92,17 @@ private:
 class CudaCalcNonbondedForceKernel : public CalcNonbondedForceKernel {
 public:
     CudaCalcNonbondedForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system) : CalcNonbondedForceKernel(name, platform),
-            cu(cu), hasInitializedFFT(false), sort(NULL), dispersionFft(NULL), fft(NULL), pmeio(NULL), usePmeStream(false) {
+            cu(cu), hasInitializedFFT(false), sort(NULL), dispersionFft(NULL), fft(NULL), pmeio(NULL), dispersionCorrection(NULL), usePmeStream(false) {
     }
     ~CudaCalcNonbondedForceKernel();
     /**
      * Initialize the kernel.
      *
-     * @param system     the System this kernel will be applied to
-     * @param force      the NonbondedForce this kernel will be used for
+     * @param system            the System this kernel will be applied to
+     * @param force             the NonbondedForce this kernel will be used for
+     * @param sortedExclusions  the pair of particles involved in every exception, sorted and without duplicates
      */
-    void initialize(const OpenMM::System& system, const NonbondedForce& force);
+    void initialize(const OpenMM::System& system, const NonbondedForce& force, const std::vector<std::pair<int, int> >& sortedExclusions);
     /**
      * Execute the kernel to calculate the forces and/or energy.
      *
@@ -118,6 +121,34 @@ public:
      * @param force      the NonbondedForce to copy the parameters from
      */
     void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force);
+    /**
+     * Copy changed parameters over to a context, considering only the specified particles and exceptions.
+     *
+     * @param context     the context to copy parameters to
+     * @param force       the NonbondedForce to copy the parameters from
+     * @param particles   the indices of the particles whose parameters might have changed
+     * @param exceptions  the indices of the exceptions whose parameters might have changed
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Copy changed charges over to a context.  Only the charges of the specified particles and the
+     * charge products of the specified exceptions are copied.  Everything else is assumed to be unchanged.
+     *
+     * @param context     the context to copy charges to
+     * @param force       the NonbondedForce to copy the charges from
+     * @param particles   the indices of the particles whose charges might have changed
+     * @param exceptions  the indices of the exceptions whose charge products might have changed
+     */
+    void copyChargesToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Compute the energy of the force for several sets of global parameter values.  This is not
+     * supported by this platform.
+     *
+     * @param context          the context in which to execute this kernel
+     * @param parameterValues  parameterValues[i][j] is the value of the j'th global parameter of the force in the i'th state
+     * @param energies         on exit, energies[i] is the potential energy of the force in the i'th state
+     */
+    void computeEnergies(OpenMM::ContextImpl& context, const std::vector<std::vector<double> >& parameterValues, std::vector<double>& energies);
     /**
      * Get the parameters being used for PME.
      * 
@@ -182,6 +213,7 @@ private:
     OpenMM::CudaSort* sort;
     OpenMM::Kernel cpuPme;
     PmeIO* pmeio;
+    DispersionCorrection* dispersionCorrection;
     CUstream pmeStream;
     CUevent pmeSyncEvent, paramsSyncEvent;
     OpenMM::CudaFFT3D* fft;
@@ -206,10 +238,12 @@ private:
     CUfunction pmeInterpolateForceKernel;
     CUfunction pmeInterpolateDispersionForceKernel;
     std::vector<std::pair<int, int> > exceptionAtoms;
+    std::vector<int> exceptionIndex;
+    std::vector<float4> hostBaseParticleParams, hostBaseExceptionParams;
     std::vector<std::string> paramNames;
     std::vector<double> paramValues;
     double ewaldSelfEnergy, dispersionCoefficient, alpha, dispersionAlpha;
-    int interpolateForceThreads;
+    int interpolateForceThreads, exceptionStartIndex;
     int gridSizeX, gridSizeY, gridSizeZ;
     int dispersionGridSizeX, dispersionGridSizeY, dispersionGridSizeZ;
     bool hasCoulomb, hasLJ, usePmeStream, useCudaFFT, doLJPME, usePosqCharges, recomputeParams, hasOffsets;
@@ -33,11 +33,17 @@
   #define _USE_MATH_DEFINES // Needed to get M_PI
 #endif
 #include "openmm/cuda/CudaPlatform.h"
+#include "ExampleKernels.h"
+#include "CudaExampleKernelFactory.h"
 #include <string>
 
 OpenMM::CudaPlatform platform;
 
+extern "C" OPENMM_EXPORT void registerExampleReferenceKernelFactories();
+
 void initializeTests(int argc, char* argv[]) {
+    registerExampleReferenceKernelFactories();
+    platform.registerKernelFactory(ExamplePlugin::CalcNonbondedForceKernel::Name(), new OpenMM::CudaExampleKernelFactory());
     if (argc > 1)
         platform.setPropertyDefaultValue("Precision", std::string(argv[1]));
 }
@@ -0,0 +1,69 @@
+#ifndef REFERENCE_NONBONDED_PARAMETERS_H_
+#define REFERENCE_NONBONDED_PARAMETERS_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class stores the exceptions that are not simple exclusions, the ones whose interactions the
+ * reference kernel computes itself.  Each field is held in its own contiguous array, so a range of
+ * exceptions can be evaluated without chasing a pointer per exception.  The Lennard-Jones well depth
+ * is stored premultiplied by 4.
+ */
+class ReferenceExceptionParameters {
+public:
+    std::vector<int> particle1, particle2;
+    std::vector<double> sigma, fourEpsilon, chargeProd;
+    /**
+     * Get the number of exceptions.
+     */
+    int size() const {
+        return particle1.size();
+    }
+    /**
+     * Set the number of exceptions.  New entries are initialized to zero.
+     */
+    void resize(int numExceptions) {
+        particle1.resize(numExceptions, 0);
+        particle2.resize(numExceptions, 0);
+        sigma.resize(numExceptions, 0.0);
+        fourEpsilon.resize(numExceptions, 0.0);
+        chargeProd.resize(numExceptions, 0.0);
+    }
+};
+
+} // namespace ExamplePlugin
+
+#endif /*REFERENCE_NONBONDED_PARAMETERS_H_*/
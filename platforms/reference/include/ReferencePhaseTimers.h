@@ -0,0 +1,144 @@
+#ifndef REFERENCE_PHASE_TIMERS_H_
+#define REFERENCE_PHASE_TIMERS_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class accumulates the time spent in each phase of a nonbonded force calculation.  Timing is
+ * disabled by default, in which case a Scope does not even read the clock.  Scopes may be nested, and
+ * each phase is only charged for the time not spent in a nested scope, so the times for the phases add
+ * up to the total time.  All scopes must be created on the same thread.
+ */
+class ReferencePhaseTimers {
+public:
+    enum Phase {
+        Parameters = 0,
+        NeighborList = 1,
+        Reciprocal = 2,
+        Direct = 3,
+        Exclusions = 4,
+        Exceptions = 5,
+        Reduction = 6,
+        NumPhases = 7
+    };
+    /**
+     * An object of this class measures the time from when it is created until it is destroyed, and
+     * adds it to a phase.
+     */
+    class Scope {
+    public:
+        /**
+         * Start timing a phase.  If timers is NULL or disabled, this does nothing.
+         */
+        Scope(ReferencePhaseTimers* timers, Phase phase);
+        ~Scope();
+    private:
+        ReferencePhaseTimers* timers;
+        Scope* parent;
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+        double nestedTime;
+    };
+    ReferencePhaseTimers();
+    /**
+     * Get the name of a phase, as reported by getTimes().
+     */
+    static const char* getPhaseName(Phase phase);
+    /**
+     * Get whether timing is enabled.
+     */
+    bool isEnabled() const {
+        return enabled;
+    }
+    /**
+     * Set whether timing is enabled.
+     */
+    void setEnabled(bool enabled);
+    /**
+     * Record that another force evaluation has started.  This clears the thread statistics for the last
+     * evaluation.  It has no effect when timing is disabled.
+     */
+    void countEvaluation();
+    /**
+     * Get the accumulated time in seconds for each phase, and the number of evaluations they were accumulated over.
+     */
+    void getTimes(std::map<std::string, double>& times, int& numEvaluations) const;
+    /**
+     * Add to the statistics for one thread, both the totals and those for the current evaluation.  This
+     * is called from the main thread after the worker threads have finished.
+     *
+     * @param thread        the index of the thread
+     * @param blocks        the number of blocks of interactions it processed
+     * @param interactions  the number of interactions it computed
+     * @param busyTime      the time in seconds it spent doing work
+     * @param waitTime      the time in seconds it spent waiting for other threads to finish
+     */
+    void addThreadStatistics(int thread, int blocks, long long interactions, double busyTime, double waitTime);
+    /**
+     * Get the statistics for each thread, either accumulated over all evaluations or for only the most
+     * recent one.  The imbalance factor is the largest busy time divided by the average one, so 1 means
+     * the work was perfectly balanced.
+     */
+    void getThreadStatistics(std::vector<int>& blocks, std::vector<long long>& interactions, std::vector<double>& busyTimes,
+                             std::vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const;
+    /**
+     * Set the accumulated times, thread statistics, and the number of evaluations to zero.
+     */
+    void reset();
+private:
+    bool enabled;
+    int numEvaluations;
+    double phaseTimes[NumPhases];
+    Scope* currentScope;
+    /**
+     * The work done by each thread, summed over some number of evaluations.
+     */
+    struct ThreadStatistics {
+        std::vector<int> blocks;
+        std::vector<long long> interactions;
+        std::vector<double> busyTimes, waitTimes;
+        void add(int thread, int blocks, long long interactions, double busyTime, double waitTime);
+        void clear();
+    };
+    ThreadStatistics totalStatistics, lastStatistics;
+};
+
+} // namespace ExamplePlugin
+
+#endif /*REFERENCE_PHASE_TIMERS_H_*/
@@ -0,0 +1,101 @@
+#ifndef REFERENCE_THREADED_REDUCTION_H_
+#define REFERENCE_THREADED_REDUCTION_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ReferencePhaseTimers.h"
+#include "openmm/Vec3.h"
+#include "openmm/internal/ThreadPool.h"
+#include <functional>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class evaluates a list of interactions on a ThreadPool while producing results that are bitwise
+ * identical regardless of the number of threads.  The interactions are divided into blocks whose contents
+ * are chosen by the caller, and must not depend on the number of threads.  Threads take blocks in whatever
+ * order they become free.  Each block is computed into a scratch buffer owned by the thread, and the forces
+ * are then converted to 64 bit fixed point and added to a second buffer owned by the thread.  Because
+ * integer addition is associative, the final sum does not depend on which thread processed which block.
+ * The energy of each block is stored separately and the energies are summed in block order.
+ */
+class ReferenceThreadedReduction {
+public:
+    /**
+     * A function that computes one block of interactions.  It adds the forces to the provided array, which
+     * is zero on entry and has one element for every atom, and adds the energy to the provided accumulator.
+     * It must append the index of every atom whose force it may have changed to the provided list.  The
+     * index of the thread is passed so the function can use scratch objects owned by that thread.  It
+     * returns the number of interactions it computed.
+     */
+    typedef std::function<long long (int block, int threadIndex, std::vector<OpenMM::Vec3>& forces, double& energy, std::vector<int>& atoms)> BlockFunction;
+    /**
+     * Create a ReferenceThreadedReduction.
+     *
+     * @param numThreads   the number of threads to use
+     */
+    ReferenceThreadedReduction(int numThreads);
+    /**
+     * Get the number of threads being used.
+     */
+    int getNumThreads() const;
+    /**
+     * Record the time spent summing the thread buffers as the Reduction phase, and the work done
+     * by each thread.
+     *
+     * @param timers   the object to accumulate the time in
+     */
+    void setTimers(ReferencePhaseTimers& timers);
+    /**
+     * Compute a list of blocks of interactions and add the result to the forces and energy.  If any
+     * force is too large to represent in fixed point, which is about 2^31 in magnitude, an exception is
+     * thrown instead of letting it wrap around.
+     *
+     * @param numBlocks     the number of blocks
+     * @param computeBlock  the function that computes a block
+     * @param forces        the forces computed by the interactions are added to this
+     * @param totalEnergy   if not NULL, the energy computed by the interactions is added to this
+     */
+    void execute(int numBlocks, const BlockFunction& computeBlock, std::vector<OpenMM::Vec3>& forces, double* totalEnergy);
+private:
+    OpenMM::ThreadPool threads;
+    std::vector<std::vector<OpenMM::Vec3> > threadForces;
+    std::vector<std::vector<long long> > threadFixedForces;
+    std::vector<std::vector<int> > threadAtoms;
+    std::vector<double> blockEnergy;
+    ReferencePhaseTimers* timers;
+};
+
+} // namespace ExamplePlugin
+
+#endif /*REFERENCE_THREADED_REDUCTION_H_*/
@@ -47,6 +47,7 @@ extern "C" OPENMM_EXPORT void registerKernelFactories() {
         if (dynamic_cast<ReferencePlatform*>(&platform) != NULL) {
             ReferenceExampleKernelFactory* factory = new ReferenceExampleKernelFactory();
             platform.registerKernelFactory(CalcExampleForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcNonbondedForceKernel::Name(), factory);
         }
     }
 }
@@ -59,5 +60,7 @@ KernelImpl* ReferenceExampleKernelFactory::createKernelImpl(std::string name, co
     ReferencePlatform::PlatformData& data = *static_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
     if (name == CalcExampleForceKernel::Name())
         return new ReferenceCalcExampleForceKernel(name, platform);
+    if (name == CalcNonbondedForceKernel::Name())
+        return new ReferenceCalcNonbondedForceKernel(name, platform);
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
 }
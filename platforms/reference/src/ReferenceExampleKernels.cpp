@@ -35,10 +35,15 @@
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/reference/RealVec.h"
 #include "openmm/reference/ReferencePlatform.h"
-#include "openmm/reference/ReferenceBondForce.h"
+#include "openmm/reference/ReferenceForce.h"
+#include "openmm/reference/SimTKOpenMMRealType.h"
+#include "internal/DispersionCorrection.h"
 #include "internal/NonbondedForceImpl.h"
-#include "ReferenceLJCoulomb14.h"
 #include "ReferenceLJCoulombIxn.h"
+#include "ReferenceThreadedReduction.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace ExamplePlugin;
 using namespace OpenMM;
@@ -59,6 +64,84 @@ static Vec3* extractBoxVectors(ContextImpl& context) {
     return data->periodicBoxVectors;
 }
 
+/**
+ * The number of pairs or exceptions in each block of work when computing interactions on multiple threads.
+ */
+static const int BlockSize = 16384;
+
+/**
+ * Compute the interactions for the exceptions in the range [start, end), adding the forces to forces and
+ * the energy to energy if it is not NULL.
+ */
+static void computeExceptionRange(const ReferenceExceptionParameters& exceptions, int start, int end, const vector<Vec3>& posData,
+        Vec3* boxVectors, bool periodic, vector<Vec3>& forces, double* energy) {
+    const int* particle1 = exceptions.particle1.data();
+    const int* particle2 = exceptions.particle2.data();
+    const double* sigma = exceptions.sigma.data();
+    const double* fourEpsilon = exceptions.fourEpsilon.data();
+    const double* chargeProd = exceptions.chargeProd.data();
+    double totalEnergy = 0.0;
+    for (int i = start; i < end; i++) {
+        int atom1 = particle1[i];
+        int atom2 = particle2[i];
+        double deltaR[ReferenceForce::LastDeltaRIndex];
+        if (periodic)
+            ReferenceForce::getDeltaRPeriodic(posData[atom2], posData[atom1], boxVectors, deltaR);
+        else
+            ReferenceForce::getDeltaR(posData[atom2], posData[atom1], deltaR);
+        double inverseR = 1.0/deltaR[ReferenceForce::RIndex];
+        double sig2 = inverseR*sigma[i];
+        sig2 *= sig2;
+        double sig6 = sig2*sig2*sig2;
+        double coulomb = ONE_4PI_EPS0*chargeProd[i]*inverseR;
+        double dEdR = (fourEpsilon[i]*(12.0*sig6-6.0)*sig6 + coulomb)*inverseR*inverseR;
+        for (int j = 0; j < 3; j++) {
+            double force = dEdR*deltaR[j];
+            forces[atom1][j] += force;
+            forces[atom2][j] -= force;
+        }
+        totalEnergy += fourEpsilon[i]*(sig6-1.0)*sig6 + coulomb;
+    }
+    if (energy != NULL)
+        *energy += totalEnergy;
+}
+
+/**
+ * Compile a list of parameter offsets into two compressed sparse row tables.  The first lists the offsets
+ * applied to each particle (or exception), and the second lists the particles (or exceptions) affected by
+ * each global parameter.
+ */
+static void compileOffsets(int numParams, int numItems, const vector<int>& params, const vector<int>& items, const vector<array<double, 3> >& scales,
+        vector<int>& itemStart, vector<int>& itemParams, vector<array<double, 3> >& itemScales, vector<int>& paramStart, vector<int>& paramItems) {
+    int numOffsets = params.size();
+    itemStart.assign(numItems+1, 0);
+    for (int item : items)
+        itemStart[item+1]++;
+    for (int i = 0; i < numItems; i++)
+        itemStart[i+1] += itemStart[i];
+    itemParams.resize(numOffsets);
+    itemScales.resize(numOffsets);
+    vector<int> next(itemStart.begin(), itemStart.end()-1);
+    for (int i = 0; i < numOffsets; i++) {
+        int pos = next[items[i]]++;
+        itemParams[pos] = params[i];
+        itemScales[pos] = scales[i];
+    }
+    vector<pair<int, int> > paramItemPairs(numOffsets);
+    for (int i = 0; i < numOffsets; i++)
+        paramItemPairs[i] = make_pair(params[i], items[i]);
+    sort(paramItemPairs.begin(), paramItemPairs.end());
+    paramItemPairs.erase(unique(paramItemPairs.begin(), paramItemPairs.end()), paramItemPairs.end());
+    paramStart.assign(numParams+1, 0);
+    paramItems.resize(paramItemPairs.size());
+    for (int i = 0; i < paramItemPairs.size(); i++) {
+        paramStart[paramItemPairs[i].first+1]++;
+        paramItems[i] = paramItemPairs[i].second;
+    }
+    for (int i = 0; i < numParams; i++)
+        paramStart[i+1] += paramStart[i];
+}
+
 void ReferenceCalcExampleForceKernel::initialize(const OpenMM::System& system, const ExampleForce& force) {
     // Initialize bond parameters.
     
@@ -110,9 +193,17 @@ void ReferenceCalcExampleForceKernel::copyParametersToContext(ContextImpl& conte
 ReferenceCalcNonbondedForceKernel::~ReferenceCalcNonbondedForceKernel() {
     if (neighborList != NULL)
         delete neighborList;
+    if (clj != NULL)
+        delete clj;
+    if (dispersionCorrection != NULL)
+        delete dispersionCorrection;
+    if (threads != NULL)
+        delete threads;
+    for (ReferenceLJCoulombIxn* ixn : threadIxns)
+        delete ixn;
 }
 
-void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system, const NonbondedForce& force) {
+void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system, const NonbondedForce& force, const vector<pair<int, int> >& sortedExclusions) {
 
     // Identify which exceptions are 1-4 interactions.
 
@@ -125,16 +216,16 @@ void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system,
         exceptionsWithOffsets.insert(exception);
     }
     numParticles = force.getNumParticles();
-    exclusions.resize(numParticles);
+    int numExceptions = force.getNumExceptions();
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
+    vector<int> exceptionParticles1, exceptionParticles2;
+    vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+    force.getExceptionParameters(0, numExceptions, exceptionParticles1, exceptionParticles2, chargeProds, exceptionSigmas, exceptionEpsilons);
     vector<int> nb14s;
-    map<int, int> nb14Index;
-    for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        exclusions[particle1].insert(particle2);
-        exclusions[particle2].insert(particle1);
-        if (chargeProd != 0.0 || epsilon != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end()) {
+    nb14Index.assign(numExceptions, -1);
+    for (int i = 0; i < numExceptions; i++) {
+        if (chargeProds[i] != 0.0 || exceptionEpsilons[i] != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end()) {
             nb14Index[i] = nb14s.size();
             nb14s.push_back(i);
         }
@@ -143,34 +234,65 @@ void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system,
     // Build the arrays.
 
     num14 = nb14s.size();
-    bonded14IndexArray.resize(num14, vector<int>(2));
-    bonded14ParamArray.resize(num14, vector<double>(3));
+    bonded14Params.resize(num14);
     particleParamArray.resize(numParticles, vector<double>(3));
     baseParticleParams.resize(numParticles);
     baseExceptionParams.resize(num14);
     for (int i = 0; i < numParticles; ++i)
-       force.getParticleParameters(i, baseParticleParams[i][0], baseParticleParams[i][1], baseParticleParams[i][2]);
-    this->exclusions = exclusions;
+        baseParticleParams[i] = {{charges[i], sigmas[i], epsilons[i]}};
+
+    // The exclusions arrive sorted, so every particle's set is filled in ascending order and each
+    // insertion at the end is constant time.
+
+    exclusions.resize(numParticles);
+    for (auto& exclusion : sortedExclusions) {
+        exclusions[exclusion.first].insert(exclusions[exclusion.first].end(), exclusion.second);
+        exclusions[exclusion.second].insert(exclusions[exclusion.second].end(), exclusion.first);
+    }
     for (int i = 0; i < num14; ++i) {
-        int particle1, particle2;
-        force.getExceptionParameters(nb14s[i], particle1, particle2, baseExceptionParams[i][0], baseExceptionParams[i][1], baseExceptionParams[i][2]);
-        bonded14IndexArray[i][0] = particle1;
-        bonded14IndexArray[i][1] = particle2;
+        int exception = nb14s[i];
+        baseExceptionParams[i] = {{chargeProds[exception], exceptionSigmas[exception], exceptionEpsilons[exception]}};
+        bonded14Params.particle1[i] = exceptionParticles1[exception];
+        bonded14Params.particle2[i] = exceptionParticles2[exception];
     }
+    globalParameterNames.resize(force.getNumGlobalParameters());
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        globalParameterNames[i] = force.getGlobalParameterName(i);
+    globalParameterValues.resize(force.getNumGlobalParameters(), 0.0);
+    map<string, int> parameterIndex;
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        parameterIndex[globalParameterNames[i]] = i;
+
+    // Compile the parameter offsets.
+
+    vector<int> offsetParams, offsetIndices;
+    vector<array<double, 3> > offsetScales;
     for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
         string param;
         int particle;
         double charge, sigma, epsilon;
         force.getParticleParameterOffset(i, param, particle, charge, sigma, epsilon);
-        particleParamOffsets[make_pair(param, particle)] = {charge, sigma, epsilon};
+        offsetParams.push_back(parameterIndex[param]);
+        offsetIndices.push_back(particle);
+        offsetScales.push_back({charge, sigma, epsilon});
     }
+    compileOffsets(globalParameterNames.size(), numParticles, offsetParams, offsetIndices, offsetScales, particleOffsetStart,
+            particleOffsetParams, particleOffsetScales, paramParticleStart, paramParticles);
+    offsetParams.clear();
+    offsetIndices.clear();
+    offsetScales.clear();
     for (int i = 0; i < force.getNumExceptionParameterOffsets(); i++) {
         string param;
         int exception;
         double charge, sigma, epsilon;
         force.getExceptionParameterOffset(i, param, exception, charge, sigma, epsilon);
-        exceptionParamOffsets[make_pair(param, nb14Index[exception])] = {charge, sigma, epsilon};
+        offsetParams.push_back(parameterIndex[param]);
+        offsetIndices.push_back(nb14Index[exception]);
+        offsetScales.push_back({charge, sigma, epsilon});
     }
+    compileOffsets(globalParameterNames.size(), num14, offsetParams, offsetIndices, offsetScales, exceptionOffsetStart,
+            exceptionOffsetParams, exceptionOffsetScales, paramExceptionStart, paramExceptions);
+    recomputeAllParams = true;
     nonbondedMethod = CalcNonbondedForceKernel::NonbondedMethod(force.getNonbondedMethod());
     nonbondedCutoff = force.getCutoffDistance();
     if (nonbondedMethod == NoCutoff) {
@@ -189,12 +311,12 @@ void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system,
     }
     else if (nonbondedMethod == PME) {
         double alpha;
-        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false);
+        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false, true);
         ewaldAlpha = alpha;
     }
     else if (nonbondedMethod == LJPME) {
         double alpha;
-        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false);
+        NonbondedForceImpl::calcPMEParameters(system, force, alpha, gridSize[0], gridSize[1], gridSize[2], false, true);
         ewaldAlpha = alpha;
         NonbondedForceImpl::calcPMEParameters(system, force, alpha, dispersionGridSize[0], dispersionGridSize[1], dispersionGridSize[2], true);
         ewaldDispersionAlpha = alpha;
@@ -205,52 +327,141 @@ void ReferenceCalcNonbondedForceKernel::initialize(const OpenMM::System& system,
     else
         exceptionsArePeriodic = force.getExceptionsUsePeriodicBoundaryConditions();
     rfDielectric = force.getReactionFieldDielectric();
-    if (force.getUseDispersionCorrection())
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(system, force);
+    dispersionCoefficient = 0.0;
+    if (force.getUseDispersionCorrection() && (nonbondedMethod == CutoffPeriodic || nonbondedMethod == Ewald || nonbondedMethod == PME)) {
+        dispersionCorrection = new DispersionCorrection(force);
+        for (int i = 0; i < globalParameterNames.size(); i++)
+            dispersionCorrection->setParameterValue(globalParameterNames[i], globalParameterValues[i]);
+    }
+
+    // Create the object that computes the interactions.  Everything except the periodic box
+    // is fixed for the lifetime of the context, so it only needs to be configured once.
+
+    clj = new ReferenceLJCoulombIxn();
+    if (nonbondedMethod != NoCutoff)
+        clj->setUseCutoff(nonbondedCutoff, *neighborList, rfDielectric);
+    if (nonbondedMethod == Ewald)
+        clj->setUseEwald(ewaldAlpha, kmax[0], kmax[1], kmax[2]);
+    if (nonbondedMethod == PME || nonbondedMethod == LJPME)
+        clj->setUsePME(ewaldAlpha, gridSize);
+    if (nonbondedMethod == LJPME)
+        clj->setUseLJPME(ewaldDispersionAlpha, dispersionGridSize);
+    if (useSwitchingFunction)
+        clj->setUseSwitchingFunction(switchingDistance);
+    neighborListValid = false;
+
+    // Without a cutoff, divide the triangle of pairs into blocks of consecutive rows that each contain
+    // about the same number of pairs, for use when computing them on multiple threads.
+
+    if (nonbondedMethod == NoCutoff) {
+        noCutoffBlockStart.push_back(0);
+        long long pairsInBlock = 0;
+        for (int i = 0; i < numParticles; i++) {
+            pairsInBlock += numParticles-1-i;
+            if (pairsInBlock >= BlockSize || i == numParticles-1) {
+                noCutoffBlockStart.push_back(i+1);
+                pairsInBlock = 0;
+            }
+        }
+    }
+}
+
+ReferenceLJCoulombIxn* ReferenceCalcNonbondedForceKernel::createThreadIxn(const NeighborList& neighbors) {
+    ReferenceLJCoulombIxn* ixn = new ReferenceLJCoulombIxn();
+
+    // Threads always take their pairs from a list.  Without a cutoff, an infinite cutoff with a dielectric
+    // of 1 makes the reaction field terms vanish, so each pair is computed exactly as it would be otherwise.
+
+    if (nonbondedMethod == NoCutoff)
+        ixn->setUseCutoff(numeric_limits<double>::infinity(), neighbors, 1.0);
     else
-        dispersionCoefficient = 0.0;
+        ixn->setUseCutoff(nonbondedCutoff, neighbors, rfDielectric);
+    if (nonbondedMethod == Ewald)
+        ixn->setUseEwald(ewaldAlpha, kmax[0], kmax[1], kmax[2]);
+    if (nonbondedMethod == PME || nonbondedMethod == LJPME)
+        ixn->setUsePME(ewaldAlpha, gridSize);
+    if (nonbondedMethod == LJPME)
+        ixn->setUseLJPME(ewaldDispersionAlpha, dispersionGridSize);
+    if (useSwitchingFunction)
+        ixn->setUseSwitchingFunction(switchingDistance);
+    return ixn;
+}
+
+void ReferenceCalcNonbondedForceKernel::setNumThreads(int numThreads) {
+    if (numThreads < 0)
+        throw OpenMMException("setNumThreadsInContext: The number of threads must be non-negative");
+    if (threads != NULL)
+        delete threads;
+    threads = NULL;
+    for (ReferenceLJCoulombIxn* ixn : threadIxns)
+        delete ixn;
+    threadIxns.clear();
+    threadNeighborLists.clear();
+    if (numThreads == 0)
+        return;
+    threads = new ReferenceThreadedReduction(numThreads);
+    threads->setTimers(timers);
+    threadNeighborLists.resize(numThreads);
+    for (int i = 0; i < numThreads; i++)
+        threadIxns.push_back(createThreadIxn(threadNeighborLists[i]));
+}
+
+int ReferenceCalcNonbondedForceKernel::getNumThreads() const {
+    return (threads == NULL ? 0 : threads->getNumThreads());
 }
 
 double ReferenceCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy, bool includeDirect, bool includeReciprocal) {
-    computeParameters(context);
+    // When reciprocal space is in its own force group, a single step calls this twice.  Only count the
+    // call that computes the direct space part.
+
+    if (includeDirect)
+        timers.countEvaluation();
+    {
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::Parameters);
+        computeParameters(context);
+    }
+    if (dispersionCorrection != NULL)
+        dispersionCoefficient = dispersionCorrection->getCoefficient();
     vector<Vec3>& posData = extractPositions(context);
     vector<Vec3>& forceData = extractForces(context);
     double energy = 0;
-    ReferenceLJCoulombIxn clj;
     bool periodic = (nonbondedMethod == CutoffPeriodic);
     bool ewald  = (nonbondedMethod == Ewald);
     bool pme  = (nonbondedMethod == PME);
     bool ljpme = (nonbondedMethod == LJPME);
-    if (nonbondedMethod != NoCutoff) {
-        computeNeighborListVoxelHash(*neighborList, numParticles, posData, exclusions, extractBoxVectors(context), periodic || ewald || pme || ljpme, nonbondedCutoff, 0.0);
-        clj.setUseCutoff(nonbondedCutoff, *neighborList, rfDielectric);
-    }
     if (periodic || ewald || pme || ljpme) {
         Vec3* boxVectors = extractBoxVectors(context);
         double minAllowedSize = 1.999999*nonbondedCutoff;
         if (boxVectors[0][0] < minAllowedSize || boxVectors[1][1] < minAllowedSize || boxVectors[2][2] < minAllowedSize)
             throw OpenMMException("The periodic box size has decreased to less than twice the nonbonded cutoff.");
-        clj.setPeriodic(boxVectors);
+        clj->setPeriodic(boxVectors);
     }
-    if (ewald)
-        clj.setUseEwald(ewaldAlpha, kmax[0], kmax[1], kmax[2]);
-    if (pme)
-        clj.setUsePME(ewaldAlpha, gridSize);
-    if (ljpme){
-        clj.setUsePME(ewaldAlpha, gridSize);
-        clj.setUseLJPME(ewaldDispersionAlpha, dispersionGridSize);
+    if (nonbondedMethod != NoCutoff && includeDirect) {
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::NeighborList);
+        updateNeighborList(posData, extractBoxVectors(context));
+    }
+
+    // Reciprocal space is always computed serially.  Computing it in a separate call adds the
+    // same terms to the energy in the same order as a single call would.
+
+    double* energyPtr = (includeEnergy ? &energy : NULL);
+    if (includeReciprocal && (ewald || pme || ljpme)) {
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::Reciprocal);
+        clj->calculatePairIxn(numParticles, posData, particleParamArray, exclusions, forceData, energyPtr, false, true);
     }
-    if (useSwitchingFunction)
-        clj.setUseSwitchingFunction(switchingDistance);
-    clj.calculatePairIxn(numParticles, posData, particleParamArray, exclusions, forceData, includeEnergy ? &energy : NULL, includeDirect, includeReciprocal);
     if (includeDirect) {
-        OpenMM::ReferenceBondForce refBondForce;
-        ReferenceLJCoulomb14 nonbonded14;
-        if (exceptionsArePeriodic) {
-            Vec3* boxVectors = extractBoxVectors(context);
-            nonbonded14.setPeriodic(boxVectors);
-        }
-        refBondForce.calculateForce(num14, bonded14IndexArray, posData, bonded14ParamArray, forceData, includeEnergy ? &energy : NULL, nonbonded14);
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::Direct);
+        if (threads != NULL)
+            computeThreadedInteractions(posData, extractBoxVectors(context), forceData, energyPtr);
+        else
+            clj->calculatePairIxn(numParticles, posData, particleParamArray, exclusions, forceData, energyPtr, true, false);
+    }
+    if (includeDirect) {
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::Exceptions);
+        if (threads != NULL)
+            computeThreadedExceptions(posData, extractBoxVectors(context), forceData, energyPtr);
+        else
+            computeExceptionRange(bonded14Params, 0, num14, posData, extractBoxVectors(context), exceptionsArePeriodic, forceData, energyPtr);
         if (periodic || ewald || pme) {
             Vec3* boxVectors = extractBoxVectors(context);
             energy += dispersionCoefficient/(boxVectors[0][0]*boxVectors[1][1]*boxVectors[2][2]);
@@ -259,6 +470,87 @@ double ReferenceCalcNonbondedForceKernel::execute(ContextImpl& context, bool inc
     return energy;
 }
 
+void ReferenceCalcNonbondedForceKernel::computeThreadedInteractions(vector<Vec3>& posData, Vec3* boxVectors, vector<Vec3>& forceData, double* energy) {
+    if (nonbondedMethod != NoCutoff && nonbondedMethod != CutoffNonPeriodic)
+        for (ReferenceLJCoulombIxn* ixn : threadIxns)
+            ixn->setPeriodic(boxVectors);
+
+    // Each block fills the thread's own neighbor list with a set of pairs, then computes them.  The
+    // number of atoms passed to calculatePairIxn() is 0 so it skips the loop over excluded pairs, which
+    // is done separately below.
+
+    auto computePairs = [&] (int threadIndex, vector<Vec3>& forces, double& blockEnergy, vector<int>& atoms) -> long long {
+        NeighborList& pairs = threadNeighborLists[threadIndex];
+        threadIxns[threadIndex]->calculatePairIxn(0, posData, particleParamArray, exclusions, forces, &blockEnergy, true, false);
+        for (auto& pair : pairs) {
+            atoms.push_back(pair.first);
+            atoms.push_back(pair.second);
+        }
+        return pairs.size();
+    };
+    if (nonbondedMethod == NoCutoff) {
+        threads->execute(noCutoffBlockStart.size()-1, [&] (int block, int threadIndex, vector<Vec3>& forces, double& blockEnergy, vector<int>& atoms) {
+            NeighborList& pairs = threadNeighborLists[threadIndex];
+            pairs.clear();
+            for (int i = noCutoffBlockStart[block]; i < noCutoffBlockStart[block+1]; i++) {
+                set<int>::const_iterator excluded = exclusions[i].upper_bound(i);
+                for (int j = i+1; j < numParticles; j++) {
+                    if (excluded != exclusions[i].end() && *excluded == j)
+                        excluded++;
+                    else
+                        pairs.push_back(AtomPair(i, j));
+                }
+            }
+            return computePairs(threadIndex, forces, blockEnergy, atoms);
+        }, forceData, energy);
+    }
+    else {
+        int numPairs = neighborList->size();
+        threads->execute((numPairs+BlockSize-1)/BlockSize, [&] (int block, int threadIndex, vector<Vec3>& forces, double& blockEnergy, vector<int>& atoms) {
+            NeighborList& pairs = threadNeighborLists[threadIndex];
+            pairs.assign(neighborList->begin()+block*BlockSize, neighborList->begin()+min((block+1)*BlockSize, numPairs));
+            return computePairs(threadIndex, forces, blockEnergy, atoms);
+        }, forceData, energy);
+    }
+
+    // With Ewald and PME, subtract the excluded pairs on this thread.  It is a single sequence of
+    // operations, so the result still does not depend on the number of threads.
+
+    if (nonbondedMethod == Ewald || nonbondedMethod == PME || nonbondedMethod == LJPME) {
+        ReferencePhaseTimers::Scope scope(&timers, ReferencePhaseTimers::Exclusions);
+        threadNeighborLists[0].clear();
+        threadIxns[0]->calculatePairIxn(numParticles, posData, particleParamArray, exclusions, forceData, energy, true, false);
+    }
+}
+
+void ReferenceCalcNonbondedForceKernel::computeThreadedExceptions(vector<Vec3>& posData, Vec3* boxVectors, vector<Vec3>& forceData, double* energy) {
+    threads->execute((num14+BlockSize-1)/BlockSize, [&] (int block, int threadIndex, vector<Vec3>& forces, double& blockEnergy, vector<int>& atoms) -> long long {
+        int start = block*BlockSize;
+        int end = min(start+BlockSize, num14);
+        computeExceptionRange(bonded14Params, start, end, posData, boxVectors, exceptionsArePeriodic, forces, &blockEnergy);
+        atoms.insert(atoms.end(), bonded14Params.particle1.begin()+start, bonded14Params.particle1.begin()+end);
+        atoms.insert(atoms.end(), bonded14Params.particle2.begin()+start, bonded14Params.particle2.begin()+end);
+        return end-start;
+    }, forceData, energy);
+}
+
+void ReferenceCalcNonbondedForceKernel::setTimingEnabled(bool enabled) {
+    timers.setEnabled(enabled);
+}
+
+void ReferenceCalcNonbondedForceKernel::getTimingStatistics(map<string, double>& times, int& numEvaluations) const {
+    timers.getTimes(times, numEvaluations);
+}
+
+void ReferenceCalcNonbondedForceKernel::getThreadStatistics(vector<int>& blocks, vector<long long>& interactions, vector<double>& busyTimes,
+                                                            vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const {
+    timers.getThreadStatistics(blocks, interactions, busyTimes, waitTimes, imbalance, lastEvaluation);
+}
+
+void ReferenceCalcNonbondedForceKernel::resetTimingStatistics() {
+    timers.reset();
+}
+
 void ReferenceCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context, const NonbondedForce& force) {
     if (force.getNumParticles() != numParticles)
         throw OpenMMException("updateParametersInContext: The number of particles has changed");
@@ -273,33 +565,349 @@ void ReferenceCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& con
         force.getExceptionParameterOffset(i, param, exception, charge, sigma, epsilon);
         exceptionsWithOffsets.insert(exception);
     }
+    int numExceptions = force.getNumExceptions();
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, numParticles, charges, sigmas, epsilons);
+    vector<int> exceptionParticles1, exceptionParticles2;
+    vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+    force.getExceptionParameters(0, numExceptions, exceptionParticles1, exceptionParticles2, chargeProds, exceptionSigmas, exceptionEpsilons);
     vector<int> nb14s;
-    for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        if (chargeProd != 0.0 || epsilon != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end())
+    for (int i = 0; i < numExceptions; i++)
+        if (chargeProds[i] != 0.0 || exceptionEpsilons[i] != 0.0 || exceptionsWithOffsets.find(i) != exceptionsWithOffsets.end())
             nb14s.push_back(i);
-    }
     if (nb14s.size() != num14)
         throw OpenMMException("updateParametersInContext: The number of non-excluded exceptions has changed");
+    nb14Index.assign(numExceptions, -1);
+    for (int i = 0; i < num14; i++)
+        nb14Index[nb14s[i]] = i;
 
     // Record the values.
 
     for (int i = 0; i < numParticles; ++i)
-        force.getParticleParameters(i, baseParticleParams[i][0], baseParticleParams[i][1], baseParticleParams[i][2]);
+        baseParticleParams[i] = {{charges[i], sigmas[i], epsilons[i]}};
     for (int i = 0; i < num14; ++i) {
-        int particle1, particle2;
-        force.getExceptionParameters(nb14s[i], particle1, particle2, baseExceptionParams[i][0], baseExceptionParams[i][1], baseExceptionParams[i][2]);
-        bonded14IndexArray[i][0] = particle1;
-        bonded14IndexArray[i][1] = particle2;
+        int exception = nb14s[i];
+        baseExceptionParams[i] = {{chargeProds[exception], exceptionSigmas[exception], exceptionEpsilons[exception]}};
+        bonded14Params.particle1[i] = exceptionParticles1[exception];
+        bonded14Params.particle2[i] = exceptionParticles2[exception];
     }
+    recomputeAllParams = true;
     
-    // Recompute the coefficient for the dispersion correction.
+    // Update the dispersion correction.  Only particles whose sigma or epsilon changed affect it.
 
-    NonbondedForce::NonbondedMethod method = force.getNonbondedMethod();
-    if (force.getUseDispersionCorrection() && (method == NonbondedForce::CutoffPeriodic || method == NonbondedForce::Ewald || method == NonbondedForce::PME))
-        dispersionCoefficient = NonbondedForceImpl::calcDispersionCorrection(context.getSystem(), force);
+    if (dispersionCorrection != NULL)
+        for (int i = 0; i < numParticles; i++)
+            dispersionCorrection->setParticleParameters(i, baseParticleParams[i][1], baseParticleParams[i][2]);
+}
+
+void ReferenceCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context, const NonbondedForce& force, const vector<int>& particles, const vector<int>& exceptions) {
+    if (force.getNumParticles() != numParticles)
+        throw OpenMMException("updateParametersInContext: The number of particles has changed");
+    if (force.getNumExceptions() != nb14Index.size())
+        throw OpenMMException("updateParametersInContext: The number of exceptions has changed");
+
+    // Check all the listed exceptions before changing anything, so a failed call leaves the Context unchanged.
+
+    vector<array<double, 3> > exceptionParams(exceptions.size());
+    for (int i = 0; i < exceptions.size(); i++) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force.getExceptionParameters(exceptions[i], particle1, particle2, chargeProd, sigma, epsilon);
+        int index = nb14Index[exceptions[i]];
+        if (index == -1) {
+            if (chargeProd != 0.0 || epsilon != 0.0)
+                throw OpenMMException("updateParametersInContext: The set of non-excluded exceptions has changed");
+            continue;
+        }
+        if (particle1 != bonded14Params.particle1[index] || particle2 != bonded14Params.particle2[index])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+        exceptionParams[i] = {{chargeProd, sigma, epsilon}};
+    }
+
+    // Record the values for the listed particles and exceptions.
+
+    for (int i : particles) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i, charge, sigma, epsilon);
+        baseParticleParams[i] = {{charge, sigma, epsilon}};
+        computeParticleParameters(i);
+        if (dispersionCorrection != NULL)
+            dispersionCorrection->setParticleParameters(i, sigma, epsilon);
+    }
+    for (int i = 0; i < exceptions.size(); i++) {
+        int index = nb14Index[exceptions[i]];
+        if (index != -1) {
+            baseExceptionParams[index] = exceptionParams[i];
+            computeExceptionParameters(index);
+        }
+    }
+}
+
+void ReferenceCalcNonbondedForceKernel::copyChargesToContext(ContextImpl& context, const NonbondedForce& force, const vector<int>& particles, const vector<int>& exceptions) {
+    if (force.getNumParticles() != numParticles)
+        throw OpenMMException("updateChargesInContext: The number of particles has changed");
+    if (force.getNumExceptions() != nb14Index.size())
+        throw OpenMMException("updateChargesInContext: The number of exceptions has changed");
+
+    // Check all the listed exceptions before changing anything, so a failed call leaves the Context unchanged.
+
+    vector<double> chargeProds(exceptions.size());
+    for (int i = 0; i < exceptions.size(); i++) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force.getExceptionParameters(exceptions[i], particle1, particle2, chargeProd, sigma, epsilon);
+        int index = nb14Index[exceptions[i]];
+        if (index == -1) {
+            if (chargeProd != 0.0)
+                throw OpenMMException("updateChargesInContext: The set of non-excluded exceptions has changed");
+            continue;
+        }
+        if (particle1 != bonded14Params.particle1[index] || particle2 != bonded14Params.particle2[index])
+            throw OpenMMException("updateChargesInContext: A particle index has changed");
+        chargeProds[i] = chargeProd;
+    }
+
+    // Only the charges are recomputed.  Sigma and epsilon keep the values they already had.
+
+    for (int i : particles) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i, charge, sigma, epsilon);
+        baseParticleParams[i][0] = charge;
+        for (int j = particleOffsetStart[i]; j < particleOffsetStart[i+1]; j++)
+            charge += globalParameterValues[particleOffsetParams[j]]*particleOffsetScales[j][0];
+        particleParamArray[i][2] = charge;
+    }
+    for (int i = 0; i < exceptions.size(); i++) {
+        int index = nb14Index[exceptions[i]];
+        if (index == -1)
+            continue;
+        double chargeProd = chargeProds[i];
+        baseExceptionParams[index][0] = chargeProd;
+        for (int j = exceptionOffsetStart[index]; j < exceptionOffsetStart[index+1]; j++)
+            chargeProd += globalParameterValues[exceptionOffsetParams[j]]*exceptionOffsetScales[j][0];
+        bonded14Params.chargeProd[index] = chargeProd;
+    }
+}
+
+void ReferenceCalcNonbondedForceKernel::computeEnergies(ContextImpl& context, const vector<vector<double> >& parameterValues, vector<double>& energies) {
+    int numStates = parameterValues.size();
+    energies.assign(numStates, 0.0);
+    if (numStates == 0)
+        return;
+    if (nonbondedMethod == LJPME)
+        throw OpenMMException("computeEnergiesInContext: This method is not supported with LJPME");
+    vector<Vec3>& posData = extractPositions(context);
+    Vec3* boxVectors = extractBoxVectors(context);
+    bool cutoff = (nonbondedMethod != NoCutoff);
+    bool periodic = (nonbondedMethod == CutoffPeriodic);
+    bool ewald = (nonbondedMethod == Ewald || nonbondedMethod == PME);
+    if (periodic || ewald) {
+        double minAllowedSize = 1.999999*nonbondedCutoff;
+        if (boxVectors[0][0] < minAllowedSize || boxVectors[1][1] < minAllowedSize || boxVectors[2][2] < minAllowedSize)
+            throw OpenMMException("The periodic box size has decreased to less than twice the nonbonded cutoff.");
+    }
+
+    // Compute the parameters for every state.  They are stored with the state as the fastest
+    // varying index, so the inner loops over states below access contiguous memory.
+
+    vector<double> charges(numParticles*numStates), halfSigmas(numParticles*numStates), sqrtEpsilons(numParticles*numStates);
+    vector<double> chargeProds(num14*numStates), sigmas14(num14*numStates), epsilons14(num14*numStates);
+    for (int state = 0; state < numStates; state++) {
+        const vector<double>& values = parameterValues[state];
+        for (int i = 0; i < numParticles; i++) {
+            array<double, 3> params = baseParticleParams[i];
+            for (int j = particleOffsetStart[i]; j < particleOffsetStart[i+1]; j++)
+                for (int k = 0; k < 3; k++)
+                    params[k] += values[particleOffsetParams[j]]*particleOffsetScales[j][k];
+            charges[i*numStates+state] = params[0];
+            halfSigmas[i*numStates+state] = 0.5*params[1];
+            sqrtEpsilons[i*numStates+state] = 2.0*sqrt(params[2]);
+        }
+        for (int i = 0; i < num14; i++) {
+            array<double, 3> params = baseExceptionParams[i];
+            for (int j = exceptionOffsetStart[i]; j < exceptionOffsetStart[i+1]; j++)
+                for (int k = 0; k < 3; k++)
+                    params[k] += values[exceptionOffsetParams[j]]*exceptionOffsetScales[j][k];
+            chargeProds[i*numStates+state] = params[0];
+            sigmas14[i*numStates+state] = params[1];
+            epsilons14[i*numStates+state] = 4.0*params[2];
+        }
+    }
+
+    // Compute the direct space interactions.  The distance dependent factors are computed once
+    // for each pair, then combined with the parameters of every state.
+
+    double krf = 0.0, crf = 0.0;
+    if (cutoff && !ewald) {
+        krf = pow(nonbondedCutoff, -3.0)*(rfDielectric-1.0)/(2.0*rfDielectric+1.0);
+        crf = (1.0/nonbondedCutoff)*(3.0*rfDielectric)/(2.0*rfDielectric+1.0);
+    }
+    auto computePair = [&] (int ii, int jj) {
+        double deltaR[ReferenceForce::LastDeltaRIndex];
+        if (periodic || ewald)
+            ReferenceForce::getDeltaRPeriodic(posData[jj], posData[ii], boxVectors, deltaR);
+        else
+            ReferenceForce::getDeltaR(posData[jj], posData[ii], deltaR);
+        double r = deltaR[ReferenceForce::RIndex];
+        double inverseR = 1.0/r;
+        double switchValue = 1.0;
+        if (useSwitchingFunction && r > switchingDistance) {
+            double t = (r-switchingDistance)/(nonbondedCutoff-switchingDistance);
+            switchValue = 1+t*t*t*(-10+t*(15-t*6));
+        }
+        double coulomb;
+        if (ewald)
+            coulomb = ONE_4PI_EPS0*inverseR*erfc(ewaldAlpha*r);
+        else if (cutoff)
+            coulomb = ONE_4PI_EPS0*(inverseR+krf*r*r-crf);
+        else
+            coulomb = ONE_4PI_EPS0*inverseR;
+        const double* q1 = &charges[ii*numStates];
+        const double* q2 = &charges[jj*numStates];
+        const double* s1 = &halfSigmas[ii*numStates];
+        const double* s2 = &halfSigmas[jj*numStates];
+        const double* e1 = &sqrtEpsilons[ii*numStates];
+        const double* e2 = &sqrtEpsilons[jj*numStates];
+        for (int state = 0; state < numStates; state++) {
+            double sig2 = inverseR*(s1[state]+s2[state]);
+            sig2 *= sig2;
+            double sig6 = sig2*sig2*sig2;
+            energies[state] += coulomb*q1[state]*q2[state] + switchValue*e1[state]*e2[state]*(sig6-1.0)*sig6;
+        }
+    };
+    if (cutoff) {
+        updateNeighborList(posData, boxVectors);
+        for (auto& pair : *neighborList)
+            computePair(pair.first, pair.second);
+    }
+    else {
+        for (int i = 0; i < numParticles; i++)
+            for (int j = i+1; j < numParticles; j++)
+                if (exclusions[j].find(i) == exclusions[j].end())
+                    computePair(i, j);
+    }
+
+    // With Ewald and PME, remove the contribution of excluded pairs that was implicitly included
+    // in the reciprocal space sum.
+
+    if (ewald) {
+        for (int i = 0; i < numParticles; i++)
+            for (int j : exclusions[i]) {
+                if (j <= i)
+                    continue;
+                double deltaR[ReferenceForce::LastDeltaRIndex];
+                ReferenceForce::getDeltaRPeriodic(posData[j], posData[i], boxVectors, deltaR);
+                double r = deltaR[ReferenceForce::RIndex];
+                double erfAlphaR = erf(ewaldAlpha*r);
+                double coulomb = (erfAlphaR > 1e-6 ? ONE_4PI_EPS0*erfAlphaR/r : ONE_4PI_EPS0*ewaldAlpha*2.0/sqrt(M_PI));
+                for (int state = 0; state < numStates; state++)
+                    energies[state] -= coulomb*charges[i*numStates+state]*charges[j*numStates+state];
+            }
+    }
+
+    // Compute the 1-4 interactions.
+
+    for (int i = 0; i < num14; i++) {
+        double deltaR[ReferenceForce::LastDeltaRIndex];
+        if (exceptionsArePeriodic)
+            ReferenceForce::getDeltaRPeriodic(posData[bonded14Params.particle2[i]], posData[bonded14Params.particle1[i]], boxVectors, deltaR);
+        else
+            ReferenceForce::getDeltaR(posData[bonded14Params.particle2[i]], posData[bonded14Params.particle1[i]], deltaR);
+        double inverseR = 1.0/deltaR[ReferenceForce::RIndex];
+        for (int state = 0; state < numStates; state++) {
+            double sig2 = inverseR*sigmas14[i*numStates+state];
+            sig2 *= sig2;
+            double sig6 = sig2*sig2*sig2;
+            energies[state] += epsilons14[i*numStates+state]*(sig6-1.0)*sig6 + ONE_4PI_EPS0*chargeProds[i*numStates+state]*inverseR;
+        }
+    }
+
+    // Compute the reciprocal space energy.  It is a quadratic form in the charges, and the charges are
+    // linear in the global parameters.  When that requires fewer evaluations than there are states, the
+    // quadratic form is recovered from a small set of basis charge vectors and evaluated for each state
+    // without touching the grid again.
+
+    if (ewald) {
+        int numParameters = globalParameterNames.size();
+        vector<double> baseCharges(numParticles);
+        for (int i = 0; i < numParticles; i++)
+            baseCharges[i] = baseParticleParams[i][0];
+        vector<vector<double> > chargeScales(numParameters, vector<double>(numParticles, 0.0));
+        vector<int> activeParameters;
+        for (int i = 0; i < numParticles; i++)
+            for (int j = particleOffsetStart[i]; j < particleOffsetStart[i+1]; j++)
+                chargeScales[particleOffsetParams[j]][i] += particleOffsetScales[j][0];
+        for (int p = 0; p < numParameters; p++)
+            for (int i = 0; i < numParticles; i++)
+                if (chargeScales[p][i] != 0.0) {
+                    activeParameters.push_back(p);
+                    break;
+                }
+        int numActive = activeParameters.size();
+        int numBasis = 1+2*numActive+numActive*(numActive-1)/2;
+        if (numBasis < numStates) {
+            auto combine = [&] (const vector<double>& a, const vector<double>& b) {
+                vector<double> sum(numParticles);
+                for (int i = 0; i < numParticles; i++)
+                    sum[i] = a[i]+b[i];
+                return sum;
+            };
+            double base = computeReciprocalEnergy(context, baseCharges);
+            vector<double> linear(numActive), quadratic(numActive);
+            vector<vector<double> > cross(numActive, vector<double>(numActive, 0.0));
+            for (int p = 0; p < numActive; p++) {
+                const vector<double>& scale = chargeScales[activeParameters[p]];
+                quadratic[p] = computeReciprocalEnergy(context, scale);
+                linear[p] = computeReciprocalEnergy(context, combine(baseCharges, scale))-base-quadratic[p];
+            }
+            for (int p = 0; p < numActive; p++)
+                for (int q = 0; q < p; q++)
+                    cross[p][q] = computeReciprocalEnergy(context, combine(chargeScales[activeParameters[p]], chargeScales[activeParameters[q]]))-quadratic[p]-quadratic[q];
+            for (int state = 0; state < numStates; state++) {
+                double energy = base;
+                for (int p = 0; p < numActive; p++) {
+                    double value = parameterValues[state][activeParameters[p]];
+                    energy += value*(linear[p]+value*quadratic[p]);
+                    for (int q = 0; q < p; q++)
+                        energy += value*parameterValues[state][activeParameters[q]]*cross[p][q];
+                }
+                energies[state] += energy;
+            }
+        }
+        else {
+            vector<double> stateCharges(numParticles);
+            for (int state = 0; state < numStates; state++) {
+                for (int i = 0; i < numParticles; i++)
+                    stateCharges[i] = charges[i*numStates+state];
+                energies[state] += computeReciprocalEnergy(context, stateCharges);
+            }
+        }
+    }
+
+    // Add the dispersion correction.  It depends on the global parameters through the sigma and
+    // epsilon offsets, so evaluate it for each state and then restore the current values.
+
+    if (dispersionCorrection != NULL) {
+        double volume = boxVectors[0][0]*boxVectors[1][1]*boxVectors[2][2];
+        for (int state = 0; state < numStates; state++) {
+            for (int i = 0; i < globalParameterNames.size(); i++)
+                dispersionCorrection->setParameterValue(globalParameterNames[i], parameterValues[state][i]);
+            energies[state] += dispersionCorrection->getCoefficient()/volume;
+        }
+        for (int i = 0; i < globalParameterNames.size(); i++)
+            dispersionCorrection->setParameterValue(globalParameterNames[i], globalParameterValues[i]);
+    }
+}
+
+double ReferenceCalcNonbondedForceKernel::computeReciprocalEnergy(ContextImpl& context, const vector<double>& charges) {
+    clj->setPeriodic(extractBoxVectors(context));
+    vector<vector<double> > params(numParticles, vector<double>(3, 0.0));
+    for (int i = 0; i < numParticles; i++)
+        params[i][2] = charges[i];
+    vector<Vec3> forces(numParticles);
+    double energy = 0.0;
+    clj->calculatePairIxn(numParticles, extractPositions(context), params, exclusions, forces, &energy, false, true);
+    return energy;
 }
 
 void ReferenceCalcNonbondedForceKernel::getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const {
@@ -320,48 +928,113 @@ void ReferenceCalcNonbondedForceKernel::getLJPMEParameters(double& alpha, int& n
     nz = dispersionGridSize[2];
 }
 
-void ReferenceCalcNonbondedForceKernel::computeParameters(ContextImpl& context) {
-    // Compute particle parameters.
+void ReferenceCalcNonbondedForceKernel::updateNeighborList(vector<Vec3>& posData, Vec3* boxVectors) {
+    bool usePeriodic = (nonbondedMethod != CutoffNonPeriodic);
+
+    // The buffered list includes all pairs within the cutoff plus a skin.  It remains valid until
+    // some particle has moved by more than half the skin, or the periodic box changes.
 
-    vector<double> charges(numParticles), sigmas(numParticles), epsilons(numParticles);
-    for (int i = 0; i < numParticles; i++) {
-        charges[i] = baseParticleParams[i][0];
-        sigmas[i] = baseParticleParams[i][1];
-        epsilons[i] = baseParticleParams[i][2];
+    bool rebuild = !neighborListValid;
+    if (!rebuild && usePeriodic)
+        for (int i = 0; i < 3; i++)
+            if (boxVectors[i] != neighborListBoxVectors[i])
+                rebuild = true;
+    if (!rebuild) {
+        double maxDisplacement2 = 0.25*neighborListSkin*neighborListSkin;
+        for (int i = 0; i < numParticles && !rebuild; i++) {
+            Vec3 delta = posData[i]-neighborListPositions[i];
+            if (delta.dot(delta) > maxDisplacement2)
+                rebuild = true;
+        }
     }
-    for (auto& offset : particleParamOffsets) {
-        double value = context.getParameter(offset.first.first);
-        int index = offset.first.second;
-        charges[index] += value*offset.second[0];
-        sigmas[index] += value*offset.second[1];
-        epsilons[index] += value*offset.second[2];
+    if (rebuild) {
+        neighborListSkin = 0.1*nonbondedCutoff;
+        if (usePeriodic) {
+            double minBoxSize = min(boxVectors[0][0], min(boxVectors[1][1], boxVectors[2][2]));
+            neighborListSkin = max(0.0, min(neighborListSkin, 0.5*minBoxSize-nonbondedCutoff));
+        }
+        computeNeighborListVoxelHash(bufferedNeighborList, numParticles, posData, exclusions, boxVectors, usePeriodic, nonbondedCutoff+neighborListSkin, 0.0);
+        neighborListPositions = posData;
+        for (int i = 0; i < 3; i++)
+            neighborListBoxVectors[i] = boxVectors[i];
+        neighborListValid = true;
     }
-    for (int i = 0; i < numParticles; i++) {
-        particleParamArray[i][0] = 0.5*sigmas[i];
-        particleParamArray[i][1] = 2.0*sqrt(epsilons[i]);
-        particleParamArray[i][2] = charges[i];
+
+    // Select the pairs that are actually within the cutoff.
+
+    neighborList->clear();
+    double cutoff2 = nonbondedCutoff*nonbondedCutoff;
+    for (auto& pair : bufferedNeighborList) {
+        double deltaR[ReferenceForce::LastDeltaRIndex];
+        if (usePeriodic)
+            ReferenceForce::getDeltaRPeriodic(posData[pair.second], posData[pair.first], boxVectors, deltaR);
+        else
+            ReferenceForce::getDeltaR(posData[pair.second], posData[pair.first], deltaR);
+        if (deltaR[ReferenceForce::R2Index] <= cutoff2)
+            neighborList->push_back(pair);
     }
+}
 
-    // Compute exception parameters.
+void ReferenceCalcNonbondedForceKernel::computeParameters(ContextImpl& context) {
+    // Find which of the global parameters used by offsets have changed.
 
-    charges.resize(num14);
-    sigmas.resize(num14);
-    epsilons.resize(num14);
-    for (int i = 0; i < num14; i++) {
-        charges[i] = baseExceptionParams[i][0];
-        sigmas[i] = baseExceptionParams[i][1];
-        epsilons[i] = baseExceptionParams[i][2];
+    vector<int> changedParams;
+    for (int i = 0; i < globalParameterNames.size(); i++) {
+        if (paramParticleStart[i] == paramParticleStart[i+1] && paramExceptionStart[i] == paramExceptionStart[i+1])
+            continue;
+        double value = context.getParameter(globalParameterNames[i]);
+        if (value != globalParameterValues[i]) {
+            globalParameterValues[i] = value;
+            changedParams.push_back(i);
+            if (dispersionCorrection != NULL)
+                dispersionCorrection->setParameterValue(globalParameterNames[i], value);
+        }
     }
-    for (auto& offset : exceptionParamOffsets) {
-        double value = context.getParameter(offset.first.first);
-        int index = offset.first.second;
-        charges[index] += value*offset.second[0];
-        sigmas[index] += value*offset.second[1];
-        epsilons[index] += value*offset.second[2];
+
+    // Recompute parameters for the particles and exceptions that depend on them.
+
+    if (recomputeAllParams) {
+        for (int i = 0; i < numParticles; i++)
+            computeParticleParameters(i);
+        for (int i = 0; i < num14; i++)
+            computeExceptionParameters(i);
+        recomputeAllParams = false;
+        return;
     }
-    for (int i = 0; i < num14; i++) {
-        bonded14ParamArray[i][0] = sigmas[i];
-        bonded14ParamArray[i][1] = 4.0*epsilons[i];
-        bonded14ParamArray[i][2] = charges[i];
+    for (int param : changedParams) {
+        for (int i = paramParticleStart[param]; i < paramParticleStart[param+1]; i++)
+            computeParticleParameters(paramParticles[i]);
+        for (int i = paramExceptionStart[param]; i < paramExceptionStart[param+1]; i++)
+            computeExceptionParameters(paramExceptions[i]);
+    }
+}
+
+void ReferenceCalcNonbondedForceKernel::computeParticleParameters(int index) {
+    double charge = baseParticleParams[index][0];
+    double sigma = baseParticleParams[index][1];
+    double epsilon = baseParticleParams[index][2];
+    for (int i = particleOffsetStart[index]; i < particleOffsetStart[index+1]; i++) {
+        double value = globalParameterValues[particleOffsetParams[i]];
+        charge += value*particleOffsetScales[i][0];
+        sigma += value*particleOffsetScales[i][1];
+        epsilon += value*particleOffsetScales[i][2];
+    }
+    particleParamArray[index][0] = 0.5*sigma;
+    particleParamArray[index][1] = 2.0*sqrt(epsilon);
+    particleParamArray[index][2] = charge;
+}
+
+void ReferenceCalcNonbondedForceKernel::computeExceptionParameters(int index) {
+    double chargeProd = baseExceptionParams[index][0];
+    double sigma = baseExceptionParams[index][1];
+    double epsilon = baseExceptionParams[index][2];
+    for (int i = exceptionOffsetStart[index]; i < exceptionOffsetStart[index+1]; i++) {
+        double value = globalParameterValues[exceptionOffsetParams[i]];
+        chargeProd += value*exceptionOffsetScales[i][0];
+        sigma += value*exceptionOffsetScales[i][1];
+        epsilon += value*exceptionOffsetScales[i][2];
     }
+    bonded14Params.sigma[index] = sigma;
+    bonded14Params.fourEpsilon[index] = 4.0*epsilon;
+    bonded14Params.chargeProd[index] = chargeProd;
 }
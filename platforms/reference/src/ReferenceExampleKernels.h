@@ -34,9 +34,24 @@
 
 #include "ExampleKernels.h"
 #include "openmm/Platform.h"
+#include <array>
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "openmm/reference/ReferenceNeighborList.h"
+#include "ReferenceNonbondedParameters.h"
+#include "ReferencePhaseTimers.h"
+
+namespace OpenMM {
+    class ReferenceLJCoulombIxn;
+}
+
+namespace ExamplePlugin {
+    class ReferenceThreadedReduction;
+    class DispersionCorrection;
+}
 
 
 namespace ExamplePlugin {
@@ -82,16 +97,18 @@ private:
  */
 class ReferenceCalcNonbondedForceKernel : public CalcNonbondedForceKernel {
 public:
-    ReferenceCalcNonbondedForceKernel(std::string name, const OpenMM::Platform& platform) : CalcNonbondedForceKernel(name, platform) {
+    ReferenceCalcNonbondedForceKernel(std::string name, const OpenMM::Platform& platform) : CalcNonbondedForceKernel(name, platform),
+            neighborList(NULL), clj(NULL), threads(NULL), dispersionCorrection(NULL) {
     }
     ~ReferenceCalcNonbondedForceKernel();
     /**
      * Initialize the kernel.
      * 
-     * @param system     the System this kernel will be applied to
-     * @param force      the NonbondedForce this kernel will be used for
+     * @param system            the System this kernel will be applied to
+     * @param force             the NonbondedForce this kernel will be used for
+     * @param sortedExclusions  the pair of particles involved in every exception, sorted and without duplicates
      */
-    void initialize(const OpenMM::System& system, const NonbondedForce& force);
+    void initialize(const OpenMM::System& system, const NonbondedForce& force, const std::vector<std::pair<int, int> >& sortedExclusions);
     /**
      * Execute the kernel to calculate the forces and/or energy.
      *
@@ -109,6 +126,34 @@ public:
      * @param force      the NonbondedForce to copy the parameters from
      */
     void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force);
+    /**
+     * Copy changed parameters over to a context, considering only the specified particles and exceptions.
+     *
+     * @param context     the context to copy parameters to
+     * @param force       the NonbondedForce to copy the parameters from
+     * @param particles   the indices of the particles whose parameters might have changed
+     * @param exceptions  the indices of the exceptions whose parameters might have changed
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Copy changed charges over to a context.  Only the charges of the specified particles and the
+     * charge products of the specified exceptions are copied.  Everything else is assumed to be unchanged.
+     *
+     * @param context     the context to copy charges to
+     * @param force       the NonbondedForce to copy the charges from
+     * @param particles   the indices of the particles whose charges might have changed
+     * @param exceptions  the indices of the exceptions whose charge products might have changed
+     */
+    void copyChargesToContext(OpenMM::ContextImpl& context, const NonbondedForce& force, const std::vector<int>& particles, const std::vector<int>& exceptions);
+    /**
+     * Compute the energy of the force for several sets of global parameter values, without
+     * modifying the parameters stored in the context.
+     *
+     * @param context          the context in which to execute this kernel
+     * @param parameterValues  parameterValues[i][j] is the value of the j'th global parameter of the force in the i'th state
+     * @param energies         on exit, energies[i] is the potential energy of the force in the i'th state
+     */
+    void computeEnergies(OpenMM::ContextImpl& context, const std::vector<std::vector<double> >& parameterValues, std::vector<double>& energies);
     /**
      * Get the parameters being used for PME.
      * 
@@ -127,19 +172,84 @@ public:
      * @param nz      the number of grid points along the Z axis
      */
     void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+    /**
+     * Set the number of threads used to compute direct space interactions and exceptions.
+     *
+     * @param numThreads   the number of threads to use, or 0 to compute them serially
+     */
+    void setNumThreads(int numThreads);
+    /**
+     * Get the number of threads used to compute direct space interactions and exceptions, or 0 if they
+     * are computed serially.
+     */
+    int getNumThreads() const;
+    /**
+     * Set whether to record the time spent in each phase of the calculation.
+     *
+     * @param enabled   true to enable timing, false to disable it
+     */
+    void setTimingEnabled(bool enabled);
+    /**
+     * Get the time spent in each phase of the calculation since timing was enabled or last reset.
+     *
+     * @param times            on exit, maps the name of each phase to the time spent in it, measured in seconds
+     * @param numEvaluations   on exit, the number of times the kernel was executed while timing was enabled
+     */
+    void getTimingStatistics(std::map<std::string, double>& times, int& numEvaluations) const;
+    /**
+     * Get statistics on how the work was divided between threads since timing was enabled or last reset.
+     * They are only recorded when multiple threads are in use, so otherwise the arrays are empty.
+     *
+     * @param blocks          on exit, blocks[i] is the number of blocks of interactions processed by thread i
+     * @param interactions    on exit, interactions[i] is the number of pairs and exceptions computed by thread i
+     * @param busyTimes       on exit, busyTimes[i] is the time thread i spent working, measured in seconds
+     * @param waitTimes       on exit, waitTimes[i] is the time thread i spent waiting for other threads, measured in seconds
+     * @param imbalance       on exit, the largest busy time divided by the average busy time
+     * @param lastEvaluation  if true, get the statistics for only the most recent evaluation instead of the totals
+     */
+    void getThreadStatistics(std::vector<int>& blocks, std::vector<long long>& interactions, std::vector<double>& busyTimes,
+                             std::vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const;
+    /**
+     * Set the accumulated times and thread statistics to zero.
+     */
+    void resetTimingStatistics();
 private:
     void computeParameters(OpenMM::ContextImpl& context);
+    void updateNeighborList(std::vector<OpenMM::Vec3>& posData, OpenMM::Vec3* boxVectors);
+    void computeParticleParameters(int index);
+    void computeExceptionParameters(int index);
+    double computeReciprocalEnergy(OpenMM::ContextImpl& context, const std::vector<double>& charges);
+    void computeThreadedInteractions(std::vector<OpenMM::Vec3>& posData, OpenMM::Vec3* boxVectors, std::vector<OpenMM::Vec3>& forceData, double* energy);
+    void computeThreadedExceptions(std::vector<OpenMM::Vec3>& posData, OpenMM::Vec3* boxVectors, std::vector<OpenMM::Vec3>& forceData, double* energy);
+    OpenMM::ReferenceLJCoulombIxn* createThreadIxn(const OpenMM::NeighborList& neighbors);
     int numParticles, num14;
-    std::vector<std::vector<int> >bonded14IndexArray;
-    std::vector<std::vector<double> > particleParamArray, bonded14ParamArray;
+    std::vector<int> nb14Index;
+    std::vector<std::vector<double> > particleParamArray;
+    ReferenceExceptionParameters bonded14Params;
     std::vector<std::array<double, 3> > baseParticleParams, baseExceptionParams;
-    std::map<std::pair<std::string, int>, std::array<double, 3> > particleParamOffsets, exceptionParamOffsets;
+    std::vector<std::string> globalParameterNames;
+    std::vector<double> globalParameterValues;
+    std::vector<int> particleOffsetStart, particleOffsetParams, paramParticleStart, paramParticles;
+    std::vector<int> exceptionOffsetStart, exceptionOffsetParams, paramExceptionStart, paramExceptions;
+    std::vector<std::array<double, 3> > particleOffsetScales, exceptionOffsetScales;
     double nonbondedCutoff, switchingDistance, rfDielectric, ewaldAlpha, ewaldDispersionAlpha, dispersionCoefficient;
     int kmax[3], gridSize[3], dispersionGridSize[3];
-    bool useSwitchingFunction, exceptionsArePeriodic;
+    bool useSwitchingFunction, exceptionsArePeriodic, recomputeAllParams;
     std::vector<std::set<int> > exclusions;
     NonbondedMethod nonbondedMethod;
     OpenMM::NeighborList* neighborList;
+    OpenMM::NeighborList bufferedNeighborList;
+    std::vector<OpenMM::Vec3> neighborListPositions;
+    OpenMM::Vec3 neighborListBoxVectors[3];
+    double neighborListSkin;
+    bool neighborListValid;
+    OpenMM::ReferenceLJCoulombIxn* clj;
+    ReferenceThreadedReduction* threads;
+    std::vector<OpenMM::ReferenceLJCoulombIxn*> threadIxns;
+    std::vector<OpenMM::NeighborList> threadNeighborLists;
+    std::vector<int> noCutoffBlockStart;
+    ReferencePhaseTimers timers;
+    DispersionCorrection* dispersionCorrection;
 };
 
 } // namespace ExamplePlugin
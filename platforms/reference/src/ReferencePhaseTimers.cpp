@@ -0,0 +1,147 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2024 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ReferencePhaseTimers.h"
+#include <algorithm>
+
+using namespace ExamplePlugin;
+using namespace std;
+
+ReferencePhaseTimers::Scope::Scope(ReferencePhaseTimers* timers, Phase phase) : timers(timers), phase(phase), nestedTime(0.0) {
+    if (timers == NULL || !timers->enabled) {
+        this->timers = NULL;
+        return;
+    }
+    parent = timers->currentScope;
+    timers->currentScope = this;
+    start = chrono::steady_clock::now();
+}
+
+ReferencePhaseTimers::Scope::~Scope() {
+    if (timers == NULL)
+        return;
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    timers->phaseTimes[phase] += elapsed-nestedTime;
+    if (parent != NULL)
+        parent->nestedTime += elapsed;
+    timers->currentScope = parent;
+}
+
+ReferencePhaseTimers::ReferencePhaseTimers() : enabled(false), currentScope(NULL) {
+    reset();
+}
+
+const char* ReferencePhaseTimers::getPhaseName(Phase phase) {
+    switch (phase) {
+        case Parameters:
+            return "parameters";
+        case NeighborList:
+            return "neighborList";
+        case Reciprocal:
+            return "reciprocal";
+        case Direct:
+            return "direct";
+        case Exclusions:
+            return "exclusions";
+        case Exceptions:
+            return "exceptions";
+        case Reduction:
+            return "reduction";
+        default:
+            return "";
+    }
+}
+
+void ReferencePhaseTimers::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+void ReferencePhaseTimers::getTimes(map<string, double>& times, int& numEvaluations) const {
+    times.clear();
+    for (int i = 0; i < NumPhases; i++)
+        times[getPhaseName((Phase) i)] = phaseTimes[i];
+    numEvaluations = this->numEvaluations;
+}
+
+void ReferencePhaseTimers::countEvaluation() {
+    if (!enabled)
+        return;
+    numEvaluations++;
+    lastStatistics.clear();
+}
+
+void ReferencePhaseTimers::addThreadStatistics(int thread, int blocks, long long interactions, double busyTime, double waitTime) {
+    totalStatistics.add(thread, blocks, interactions, busyTime, waitTime);
+    lastStatistics.add(thread, blocks, interactions, busyTime, waitTime);
+}
+
+void ReferencePhaseTimers::getThreadStatistics(vector<int>& blocks, vector<long long>& interactions, vector<double>& busyTimes,
+                                               vector<double>& waitTimes, double& imbalance, bool lastEvaluation) const {
+    const ThreadStatistics& statistics = (lastEvaluation ? lastStatistics : totalStatistics);
+    blocks = statistics.blocks;
+    interactions = statistics.interactions;
+    busyTimes = statistics.busyTimes;
+    waitTimes = statistics.waitTimes;
+    double maxTime = 0.0, totalTime = 0.0;
+    for (double time : busyTimes) {
+        maxTime = max(maxTime, time);
+        totalTime += time;
+    }
+    imbalance = (totalTime > 0.0 ? maxTime*busyTimes.size()/totalTime : 1.0);
+}
+
+void ReferencePhaseTimers::reset() {
+    numEvaluations = 0;
+    for (int i = 0; i < NumPhases; i++)
+        phaseTimes[i] = 0.0;
+    totalStatistics.clear();
+    lastStatistics.clear();
+}
+
+void ReferencePhaseTimers::ThreadStatistics::add(int thread, int blocks, long long interactions, double busyTime, double waitTime) {
+    if (thread >= (int) this->blocks.size()) {
+        this->blocks.resize(thread+1, 0);
+        this->interactions.resize(thread+1, 0);
+        busyTimes.resize(thread+1, 0.0);
+        waitTimes.resize(thread+1, 0.0);
+    }
+    this->blocks[thread] += blocks;
+    this->interactions[thread] += interactions;
+    busyTimes[thread] += busyTime;
+    waitTimes[thread] += waitTime;
+}
+
+void ReferencePhaseTimers::ThreadStatistics::clear() {
+    blocks.clear();
+    interactions.clear();
+    busyTimes.clear();
+    waitTimes.clear();
+}
@@ -0,0 +1,183 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ReferenceThreadedReduction.h"
+#include "openmm/OpenMMException.h"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+using namespace ExamplePlugin;
+using namespace OpenMM;
+using namespace std;
+
+/**
+ * The scale factor for converting forces to fixed point, the same one the CUDA platform uses.
+ */
+static const double ForceScale = (double) 0x100000000LL;
+
+/**
+ * Scaled forces must be smaller than this in magnitude to be representable as a long long.
+ */
+static const double MaxScaledForce = 9223372036854775808.0;
+
+/**
+ * Add a value to a fixed point sum.  If the result would overflow, the sum is left unchanged and
+ * false is returned.
+ */
+static bool addFixed(long long& sum, long long value) {
+    if ((value > 0 && sum > LLONG_MAX-value) || (value < 0 && sum < LLONG_MIN-value))
+        return false;
+    sum += value;
+    return true;
+}
+
+ReferenceThreadedReduction::ReferenceThreadedReduction(int numThreads) : threads(numThreads), timers(NULL) {
+    threadForces.resize(threads.getNumThreads());
+    threadFixedForces.resize(threads.getNumThreads());
+    threadAtoms.resize(threads.getNumThreads());
+}
+
+int ReferenceThreadedReduction::getNumThreads() const {
+    return threads.getNumThreads();
+}
+
+void ReferenceThreadedReduction::setTimers(ReferencePhaseTimers& timers) {
+    this->timers = &timers;
+}
+
+void ReferenceThreadedReduction::execute(int numBlocks, const BlockFunction& computeBlock, vector<Vec3>& forces, double* totalEnergy) {
+    int numAtoms = forces.size();
+    int numThreads = threads.getNumThreads();
+    blockEnergy.assign(numBlocks, 0.0);
+
+    // If timing is enabled, record how much work each thread does and how long it waits for the others.
+
+    bool recordStatistics = (timers != NULL && timers->isEnabled());
+    vector<int> threadBlocks;
+    vector<long long> threadInteractions;
+    vector<double> threadBusyTime, threadWaitTime;
+    vector<chrono::steady_clock::time_point> threadFinished;
+    if (recordStatistics) {
+        threadBlocks.resize(numThreads, 0);
+        threadInteractions.resize(numThreads, 0);
+        threadBusyTime.resize(numThreads, 0.0);
+        threadWaitTime.resize(numThreads, 0.0);
+        threadFinished.resize(numThreads);
+    }
+
+    // Compute the blocks.  After each one, the forces it changed are moved from the scratch buffer
+    // to the fixed point buffer, leaving the scratch buffer zeroed for the next block.  A force too
+    // large for fixed point (or not finite) is flagged rather than allowed to wrap around.
+
+    atomic<int> nextBlock(0);
+    atomic<bool> overflow(false);
+    threads.execute([&] (ThreadPool& pool, int threadIndex) {
+        chrono::steady_clock::time_point startTime;
+        if (recordStatistics)
+            startTime = chrono::steady_clock::now();
+        vector<Vec3>& scratch = threadForces[threadIndex];
+        vector<long long>& fixed = threadFixedForces[threadIndex];
+        vector<int>& atoms = threadAtoms[threadIndex];
+        scratch.assign(numAtoms, Vec3());
+        fixed.assign(3*numAtoms, 0);
+        while (true) {
+            int block = nextBlock++;
+            if (block >= numBlocks)
+                break;
+            atoms.clear();
+            long long interactions = computeBlock(block, threadIndex, scratch, blockEnergy[block], atoms);
+            for (int atom : atoms) {
+                Vec3& f = scratch[atom];
+                for (int j = 0; j < 3; j++) {
+                    double scaled = f[j]*ForceScale;
+                    if (!(fabs(scaled) < MaxScaledForce) || !addFixed(fixed[3*atom+j], llround(scaled)))
+                        overflow = true;
+                }
+                f = Vec3();
+            }
+            if (recordStatistics) {
+                threadBlocks[threadIndex]++;
+                threadInteractions[threadIndex] += interactions;
+            }
+        }
+        if (recordStatistics) {
+            threadFinished[threadIndex] = chrono::steady_clock::now();
+            threadBusyTime[threadIndex] += chrono::duration<double>(threadFinished[threadIndex]-startTime).count();
+        }
+    });
+    threads.waitForThreads();
+    if (recordStatistics) {
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        for (int i = 0; i < numThreads; i++)
+            threadWaitTime[i] += chrono::duration<double>(end-threadFinished[i]).count();
+    }
+
+    // Sum the fixed point buffers.  Each thread handles a different set of atoms.
+
+    ReferencePhaseTimers::Scope scope(timers, ReferencePhaseTimers::Reduction);
+    threads.execute([&] (ThreadPool& pool, int threadIndex) {
+        chrono::steady_clock::time_point startTime;
+        if (recordStatistics)
+            startTime = chrono::steady_clock::now();
+        int start = (int) ((long long) numAtoms*threadIndex/numThreads);
+        int end = (int) ((long long) numAtoms*(threadIndex+1)/numThreads);
+        for (int i = start; i < end; i++)
+            for (int j = 0; j < 3; j++) {
+                long long sum = 0;
+                for (int k = 0; k < numThreads; k++)
+                    if (!addFixed(sum, threadFixedForces[k][3*i+j]))
+                        overflow = true;
+                forces[i][j] += sum/ForceScale;
+            }
+        if (recordStatistics) {
+            threadFinished[threadIndex] = chrono::steady_clock::now();
+            threadBusyTime[threadIndex] += chrono::duration<double>(threadFinished[threadIndex]-startTime).count();
+        }
+    });
+    threads.waitForThreads();
+    if (recordStatistics) {
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        for (int i = 0; i < numThreads; i++) {
+            threadWaitTime[i] += chrono::duration<double>(end-threadFinished[i]).count();
+            timers->addThreadStatistics(i, threadBlocks[i], threadInteractions[i], threadBusyTime[i], threadWaitTime[i]);
+        }
+    }
+    if (overflow)
+        throw OpenMMException("A force is too large to accumulate in fixed point.  This usually means particles are overlapping.  Use setNumThreadsInContext() to compute it with 0 threads instead.");
+    if (totalEnergy != NULL) {
+        double sum = 0.0;
+        for (int i = 0; i < numBlocks; i++)
+            sum += blockEnergy[i];
+        *totalEnergy += sum;
+    }
+}
@@ -33,8 +33,14 @@
   #define _USE_MATH_DEFINES // Needed to get M_PI
 #endif
 #include "openmm/reference/ReferencePlatform.h"
+#include "ExampleKernels.h"
+#include "ReferenceExampleKernelFactory.h"
 
 OpenMM::ReferencePlatform platform;
 
+extern "C" OPENMM_EXPORT void registerExampleReferenceKernelFactories();
+
 void initializeTests(int argc, char* argv[]) {
+    registerExampleReferenceKernelFactories();
+    platform.registerKernelFactory(ExamplePlugin::CalcNonbondedForceKernel::Name(), new OpenMM::ReferenceExampleKernelFactory());
 }
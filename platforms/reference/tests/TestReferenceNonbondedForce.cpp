@@ -31,6 +31,671 @@
 
 #include "ReferenceTests.h"
 #include "../../../tests/TestNonbondedForce.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+void testThreadsAreDeterministic(NonbondedForce::NonbondedMethod method) {
+    // Use enough particles that the pairs are divided into many blocks.
+
+    const int gridSize = 13;
+    const int numParticles = gridSize*gridSize*gridSize;
+    const double boxSize = 4.0;
+    const double spacing = boxSize/gridSize;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* nonbonded = new NonbondedForce();
+    nonbonded->setNonbondedMethod(method);
+    nonbonded->setCutoffDistance(1.0);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(i%2 == 0 ? 0.5 : -0.5, 0.2+0.05*genrand_real2(sfmt), 0.5);
+        Vec3 jitter(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5);
+        positions[i] = Vec3(i%gridSize, (i/gridSize)%gridSize, i/(gridSize*gridSize))*spacing + jitter*0.1;
+    }
+    for (int i = 0; i < numParticles-1; i += 2)
+        nonbonded->addException(i, i+1, 0.1, 0.2, 0.3);
+    for (int i = 1; i < numParticles-1; i += 2)
+        nonbonded->addException(i, i+1, 0.0, 1.0, 0.0);
+    system.addForce(nonbonded);
+
+    // Compute the forces with different numbers of threads.  They should all be bitwise identical,
+    // and close to the serial result.
+
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    ASSERT_EQUAL(0, nonbonded->getNumThreadsInContext(context));
+    State serialState = context.getState(State::Forces | State::Energy);
+    State threadedStates[3];
+    int numThreads[] = {1, 2, 7};
+    for (int i = 0; i < 3; i++) {
+        nonbonded->setNumThreadsInContext(context, numThreads[i]);
+        ASSERT_EQUAL(numThreads[i], nonbonded->getNumThreadsInContext(context));
+        threadedStates[i] = context.getState(State::Forces | State::Energy);
+    }
+    for (int i = 1; i < 3; i++) {
+        ASSERT_EQUAL(threadedStates[0].getPotentialEnergy(), threadedStates[i].getPotentialEnergy());
+        for (int j = 0; j < numParticles; j++)
+            ASSERT_EQUAL_VEC(threadedStates[0].getForces()[j], threadedStates[i].getForces()[j], 0.0);
+    }
+    ASSERT_EQUAL_TOL(serialState.getPotentialEnergy(), threadedStates[0].getPotentialEnergy(), 1e-10);
+    for (int j = 0; j < numParticles; j++)
+        ASSERT_EQUAL_VEC(serialState.getForces()[j], threadedStates[0].getForces()[j], 1e-8);
+}
+
+void testFixedPointOverflow() {
+    // Two overlapping particles produce a force far too large for fixed point.  The serial code can
+    // still compute it, but the threaded code must report an error instead of wrapping around.
+
+    System system;
+    NonbondedForce* nonbonded = new NonbondedForce();
+    for (int i = 0; i < 2; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(0.0, 0.3, 1.0);
+    }
+    system.addForce(nonbonded);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions = {Vec3(0, 0, 0), Vec3(0.01, 0, 0)};
+    context.setPositions(positions);
+    State state = context.getState(State::Forces);
+    ASSERT(fabs(state.getForces()[0][0]) > 1e12);
+    nonbonded->setNumThreadsInContext(context, 2);
+    bool threwException = false;
+    try {
+        context.getState(State::Forces);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testTimingStatistics() {
+    const int numParticles = 200;
+    const double boxSize = 2.5;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* nonbonded = new NonbondedForce();
+    nonbonded->setNonbondedMethod(NonbondedForce::PME);
+    nonbonded->setCutoffDistance(1.0);
+    nonbonded->setReciprocalSpaceForceGroup(1);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(i%2 == 0 ? 0.5 : -0.5, 0.2, 0.5);
+        positions[i] = Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*boxSize;
+    }
+    for (int i = 0; i < numParticles-1; i += 2)
+        nonbonded->addException(i, i+1, 0.0, 1.0, 0.0);
+    system.addForce(nonbonded);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // Nothing is recorded until timing is enabled.
+
+    map<string, double> times;
+    int numEvaluations;
+    context.getState(State::Forces);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(0, numEvaluations);
+    for (auto& time : times)
+        ASSERT_EQUAL(0.0, time.second);
+
+    // Evaluating both force groups is one evaluation, even though the reciprocal space group is separate.
+
+    nonbonded->setTimingEnabledInContext(context, true);
+    for (int i = 0; i < 3; i++)
+        context.getState(State::Forces);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(3, numEvaluations);
+    ASSERT(times["direct"] > 0.0);
+    ASSERT(times["reciprocal"] > 0.0);
+    context.getState(State::Forces, false, 1<<1);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(3, numEvaluations);
+    context.getState(State::Forces, false, 1<<0);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(4, numEvaluations);
+
+    // Disabling timing keeps the statistics, and resetting clears them.
+
+    nonbonded->setTimingEnabledInContext(context, false);
+    context.getState(State::Forces);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(4, numEvaluations);
+    nonbonded->resetTimingStatisticsInContext(context);
+    nonbonded->getTimingStatisticsInContext(context, times, numEvaluations);
+    ASSERT_EQUAL(0, numEvaluations);
+    for (auto& time : times)
+        ASSERT_EQUAL(0.0, time.second);
+}
+
+void testThreadStatistics() {
+    // Without a cutoff, every pair that is not excluded is an interaction, so the counts are known exactly.
+
+    const int numParticles = 300;
+    System system;
+    NonbondedForce* nonbonded = new NonbondedForce();
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(i%2 == 0 ? 0.5 : -0.5, 0.2, 0.5);
+        positions[i] = Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*3.0;
+    }
+    int numExclusions = 0, numExceptions = 0;
+    for (int i = 0; i < numParticles-1; i += 2) {
+        nonbonded->addException(i, i+1, 0.0, 1.0, 0.0);
+        numExclusions++;
+    }
+    for (int i = 1; i < numParticles-1; i += 4) {
+        nonbonded->addException(i, i+1, 0.1, 0.2, 0.3);
+        numExceptions++;
+    }
+    system.addForce(nonbonded);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    long long expectedInteractions = numParticles*(numParticles-1LL)/2-numExclusions;
+    vector<int> blocks;
+    vector<long long> interactions;
+    vector<double> busyTimes, waitTimes;
+    double imbalance;
+
+    // Nothing is recorded for serial evaluations.
+
+    nonbonded->setTimingEnabledInContext(context, true);
+    context.getState(State::Forces);
+    nonbonded->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance);
+    ASSERT_EQUAL(0, blocks.size());
+
+    // The statistics for the last evaluation cover one evaluation, and the totals cover all of them.
+
+    const int numThreads = 3;
+    nonbonded->setNumThreadsInContext(context, numThreads);
+    for (int step = 0; step < 3; step++) {
+        context.getState(State::Forces);
+        nonbonded->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance, true);
+        ASSERT_EQUAL(numThreads, blocks.size());
+        ASSERT_EQUAL(numThreads, interactions.size());
+        ASSERT_EQUAL(numThreads, busyTimes.size());
+        ASSERT_EQUAL(numThreads, waitTimes.size());
+        long long total = 0;
+        for (long long count : interactions)
+            total += count;
+        ASSERT_EQUAL(expectedInteractions, total);
+        ASSERT(imbalance >= 1.0-1e-10);
+        ASSERT(imbalance <= numThreads+1e-10);
+    }
+    vector<int> lastBlocks = blocks;
+    nonbonded->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance);
+    long long total = 0;
+    int totalBlocks = 0, lastTotalBlocks = 0;
+    for (int i = 0; i < numThreads; i++) {
+        total += interactions[i];
+        totalBlocks += blocks[i];
+        lastTotalBlocks += lastBlocks[i];
+    }
+    ASSERT_EQUAL(3*expectedInteractions, total);
+    ASSERT_EQUAL(3*lastTotalBlocks, totalBlocks);
+
+    // Resetting clears both.
+
+    nonbonded->resetTimingStatisticsInContext(context);
+    nonbonded->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance);
+    ASSERT_EQUAL(0, blocks.size());
+    nonbonded->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance, true);
+    ASSERT_EQUAL(0, blocks.size());
+}
+
+void testPMETuning() {
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, NonbondedForce::PME);
+    force->setEwaldErrorTolerance(1e-4);
+    double standardAlpha;
+    int standardSize[3];
+    NonbondedForceImpl::calcPMEParameters(system, *force, standardAlpha, standardSize[0], standardSize[1], standardSize[2], false);
+
+    // The grid reported by the Context should be the one that was chosen, and it should be at least as large
+    // as the standard grid in every dimension.
+
+    force->setUsePMETuning(true);
+    VerletIntegrator integrator1(0.001);
+    Context context1(system, integrator1, platform);
+    context1.setPositions(positions);
+    double alpha;
+    int size[3];
+    force->getPMEParametersInContext(context1, alpha, size[0], size[1], size[2]);
+    ASSERT_EQUAL(standardAlpha, alpha);
+    for (int i = 0; i < 3; i++)
+        ASSERT(size[i] >= standardSize[i]);
+
+    // Using the chosen grid explicitly should give identical results.
+
+    System system2;
+    NonbondedForce* force2 = createSystemWithOffsets(system2, positions, NonbondedForce::PME);
+    force2->setPMEParameters(alpha, size[0], size[1], size[2]);
+    VerletIntegrator integrator2(0.001);
+    Context context2(system2, integrator2, platform);
+    context2.setPositions(positions);
+    State state1 = context1.getState(State::Forces | State::Energy);
+    State state2 = context2.getState(State::Forces | State::Energy);
+    ASSERT_EQUAL(state1.getPotentialEnergy(), state2.getPotentialEnergy());
+    for (int i = 0; i < system.getNumParticles(); i++)
+        ASSERT_EQUAL_VEC(state1.getForces()[i], state2.getForces()[i], 0.0);
+
+    // Another Context for the same force should get the same grid.
+
+    VerletIntegrator integrator3(0.001);
+    Context context3(system, integrator3, platform);
+    int size3[3];
+    force->getPMEParametersInContext(context3, alpha, size3[0], size3[1], size3[2]);
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQUAL(size[i], size3[i]);
+}
+
+string getPMETuningCacheKey(const System& system, const NonbondedForce& force) {
+    stringstream key;
+    key << hex << setw(16) << setfill('0') << NonbondedForceImpl::computeFingerprint(system, force);
+    return key.str();
+}
+
+void testPMETuningCache() {
+    const string cacheFile = "TestReferencePMETuning.cache";
+    remove(cacheFile.c_str());
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, NonbondedForce::PME);
+    force->setEwaldErrorTolerance(2e-4);
+    force->setUsePMETuning(true);
+    force->setPMETuningCacheFile(cacheFile);
+    double standardAlpha;
+    int standardSize[3];
+    NonbondedForceImpl::calcPMEParameters(system, *force, standardAlpha, standardSize[0], standardSize[1], standardSize[2], false);
+
+    // Store a grid that tuning would never choose.  It should be used without any timing.
+
+    int cachedSize[3] = {standardSize[0]+40, standardSize[1]+41, standardSize[2]+42};
+    {
+        ofstream out(cacheFile.c_str());
+        out << "OpenMMExamplePMETuningCache 1" << endl;
+        out << "not an entry" << endl;
+        out << getPMETuningCacheKey(system, *force) << " " << cachedSize[0] << " " << cachedSize[1] << " " << cachedSize[2] << endl;
+    }
+    double alpha;
+    int size[3];
+    {
+        VerletIntegrator integrator(0.001);
+        Context context(system, integrator, platform);
+        force->getPMEParametersInContext(context, alpha, size[0], size[1], size[2]);
+        for (int i = 0; i < 3; i++)
+            ASSERT_EQUAL(cachedSize[i], size[i]);
+    }
+
+    // Changing a parameter changes the fingerprint, so the cached grid should no longer be used.  The newly
+    // tuned grid should be appended to the file, and the original entry kept.
+
+    force->setParticleParameters(0, 0.2, 0.3, 0.4);
+    string newKey = getPMETuningCacheKey(system, *force);
+    {
+        VerletIntegrator integrator(0.001);
+        Context context(system, integrator, platform);
+        force->getPMEParametersInContext(context, alpha, size[0], size[1], size[2]);
+        for (int i = 0; i < 3; i++) {
+            ASSERT(size[i] >= standardSize[i]);
+            ASSERT(size[i] < cachedSize[i]);
+        }
+    }
+    ifstream in(cacheFile.c_str());
+    string line;
+    int numOldEntries = 0, numNewEntries = 0;
+    while (getline(in, line)) {
+        stringstream fields(line);
+        string key;
+        int grid[3];
+        if (!(fields >> key >> grid[0] >> grid[1] >> grid[2]))
+            continue;
+        if (key == newKey) {
+            numNewEntries++;
+            for (int i = 0; i < 3; i++)
+                ASSERT_EQUAL(size[i], grid[i]);
+        }
+        else
+            numOldEntries++;
+    }
+    in.close();
+    ASSERT_EQUAL(1, numOldEntries);
+    ASSERT_EQUAL(1, numNewEntries);
+
+    // A cached grid smaller than the standard one cannot meet the error tolerance, so it should be ignored.
+
+    force->setParticleParameters(0, 0.3, 0.3, 0.4);
+    {
+        ofstream out(cacheFile.c_str(), ios::app);
+        out << getPMETuningCacheKey(system, *force) << " " << standardSize[0]-1 << " " << standardSize[1] << " " << standardSize[2] << endl;
+    }
+    {
+        VerletIntegrator integrator(0.001);
+        Context context(system, integrator, platform);
+        force->getPMEParametersInContext(context, alpha, size[0], size[1], size[2]);
+        for (int i = 0; i < 3; i++)
+            ASSERT(size[i] >= standardSize[i]);
+    }
+    remove(cacheFile.c_str());
+}
+
+// The following tests only exercise the API and the platform independent parts of NonbondedForceImpl,
+// so they are run once here rather than by every platform.
+
+/**
+ * Add every particle within a given number of bonds of fromParticle to a set.  This is how
+ * createExceptionsFromBonds() originally walked the bond graph.
+ */
+void addBondedParticles(const vector<set<int> >& bonded12, set<int>& bonded, int baseParticle, int fromParticle, int currentLevel) {
+    for (int i : bonded12[fromParticle]) {
+        if (i != baseParticle)
+            bonded.insert(i);
+        if (currentLevel > 0)
+            addBondedParticles(bonded12, bonded, baseParticle, i, currentLevel-1);
+    }
+}
+
+void testCreateExceptionsFromBonds(int numParticles) {
+    // Build chains with branches and rings of several sizes, so particles are often connected by more
+    // than one path.  Include a bond that is listed twice.
+
+    NonbondedForce force;
+    for (int i = 0; i < numParticles; i++)
+        force.addParticle(0.1*(i%5)-0.2, 0.2+0.01*(i%7), 0.5+0.1*(i%3));
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<pair<int, int> > bonds;
+    for (int i = 1; i < numParticles; i++) {
+        if (i%50 != 0)
+            bonds.push_back(make_pair(i-1, i));
+        if (i%9 == 0 && i >= 3)
+            bonds.push_back(make_pair(i-3, i));
+        if (i%13 == 0 && i >= 5)
+            bonds.push_back(make_pair(i, i-5));
+        if (i%17 == 0 && i >= 2)
+            bonds.push_back(make_pair(i-2, i));
+        if (i%23 == 0)
+            bonds.push_back(make_pair(i, (int) (genrand_real2(sfmt)*i)));
+    }
+    bonds.push_back(bonds[10]);
+    force.createExceptionsFromBonds(bonds, 0.8, 0.6);
+
+    // Compute the exceptions the way the original implementation did, and make sure they are identical
+    // and in the same order.
+
+    vector<set<int> > bonded12(numParticles);
+    for (auto& bond : bonds) {
+        bonded12[bond.first].insert(bond.second);
+        bonded12[bond.second].insert(bond.first);
+    }
+    int index = 0;
+    for (int i = 0; i < numParticles; i++) {
+        set<int> bonded14, bonded13;
+        addBondedParticles(bonded12, bonded14, i, i, 2);
+        addBondedParticles(bonded12, bonded13, i, i, 1);
+        for (int j : bonded14) {
+            if (j >= i)
+                continue;
+            double charge1, sigma1, epsilon1, charge2, sigma2, epsilon2;
+            force.getParticleParameters(j, charge1, sigma1, epsilon1);
+            force.getParticleParameters(i, charge2, sigma2, epsilon2);
+            int particle1, particle2;
+            double chargeProd, sigma, epsilon;
+            force.getExceptionParameters(index++, particle1, particle2, chargeProd, sigma, epsilon);
+            ASSERT_EQUAL(j, particle1);
+            ASSERT_EQUAL(i, particle2);
+            if (bonded13.find(j) == bonded13.end()) {
+                ASSERT_EQUAL(0.8*charge1*charge2, chargeProd);
+                ASSERT_EQUAL(0.5*(sigma1+sigma2), sigma);
+                ASSERT_EQUAL(0.6*sqrt(epsilon1*epsilon2), epsilon);
+            }
+            else {
+                ASSERT_EQUAL(0.0, chargeProd);
+                ASSERT_EQUAL(1.0, sigma);
+                ASSERT_EQUAL(0.0, epsilon);
+            }
+        }
+    }
+    ASSERT_EQUAL(index, force.getNumExceptions());
+}
+
+void testSortExclusions() {
+    // Lists this large are sorted in parallel.  Try numbers of threads that do and do not divide the
+    // blocks evenly, and include duplicate pairs.
+
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int size : {100000, 250001}) {
+        vector<pair<int, int> > original(size);
+        for (auto& pair : original) {
+            int particle1 = (int) (genrand_real2(sfmt)*1000);
+            int particle2 = (int) (genrand_real2(sfmt)*1000);
+            pair = make_pair(min(particle1, particle2), max(particle1, particle2));
+        }
+        vector<pair<int, int> > expected = original;
+        sort(expected.begin(), expected.end());
+        for (int numThreads : {1, 2, 3, 5, 8}) {
+            vector<pair<int, int> > exclusions = original;
+            NonbondedForceImpl::sortExclusions(exclusions, numThreads);
+            ASSERT(exclusions == expected);
+        }
+    }
+
+    // Create a Context whose exclusions go through the parallel path.  Every pair is excluded, so the
+    // energy and forces should be zero.
+
+    const int numParticles = 460;
+    System system;
+    NonbondedForce* force = new NonbondedForce();
+    system.addForce(force);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(i%2 == 0 ? 1.0 : -1.0, 0.3, 1.0);
+        positions[i] = Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*5;
+    }
+    for (int i = 0; i < numParticles; i++)
+        for (int j = 0; j < i; j++)
+            force->addException(i, j, 0.0, 1.0, 0.0);
+    ASSERT(force->getNumExceptions() >= 100000);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Forces | State::Energy);
+    ASSERT_EQUAL(0.0, state.getPotentialEnergy());
+    for (int i = 0; i < numParticles; i++)
+        ASSERT_EQUAL_VEC(Vec3(0, 0, 0), state.getForces()[i], 0.0);
+}
+
+void testDuplicateExceptions() {
+    NonbondedForce force;
+    for (int i = 0; i < 2000; i++)
+        force.addParticle(0.0, 1.0, 0.0);
+    auto throwsException = [] (function<void ()> f) {
+        try {
+            f();
+        }
+        catch (const OpenMMException& ex) {
+            return true;
+        }
+        return false;
+    };
+
+    // Add enough exceptions, one at a time and in bulk, that the index is resized several times.
+
+    for (int i = 0; i < 1000; i++)
+        force.addException(i, i+1, 0.0, 1.0, 0.0);
+    vector<int> particles1, particles2;
+    vector<double> chargeProds, sigmas, epsilons;
+    for (int i = 0; i < 1000; i++) {
+        particles1.push_back(i);
+        particles2.push_back(i+2);
+        chargeProds.push_back(0.1);
+        sigmas.push_back(1.0);
+        epsilons.push_back(0.2);
+    }
+    ASSERT_EQUAL(1000, force.addExceptions(particles1, particles2, chargeProds, sigmas, epsilons));
+    ASSERT_EQUAL(2000, force.getNumExceptions());
+
+    // Pairs are duplicates regardless of the order of the particles.
+
+    for (int i = 0; i < 1000; i += 37) {
+        ASSERT(throwsException([&] () {force.addException(i+1, i, 0.0, 1.0, 0.0);}));
+        ASSERT(throwsException([&] () {force.addException(i, i+2, 0.0, 1.0, 0.0);}));
+    }
+    ASSERT_EQUAL(5, force.addException(6, 5, 0.5, 1.5, 2.5, true));
+    int particle1, particle2;
+    double chargeProd, sigma, epsilon;
+    force.getExceptionParameters(5, particle1, particle2, chargeProd, sigma, epsilon);
+    ASSERT_EQUAL(0.5, chargeProd);
+
+    // A bulk add that duplicates an existing exception, or contains the same pair twice, should be rejected
+    // without adding anything.
+
+    ASSERT(throwsException([&] () {force.addExceptions({1500, 1501, 700}, {1600, 1601, 701}, {0, 0, 0}, {1, 1, 1}, {0, 0, 0});}));
+    ASSERT(throwsException([&] () {force.addExceptions({1500, 1501, 1600}, {1600, 1601, 1500}, {0, 0, 0}, {1, 1, 1}, {0, 0, 0});}));
+    ASSERT(throwsException([&] () {force.createExceptionsFromBonds({{1500, 1501}, {1501, 1502}, {3, 4}}, 0.5, 0.5);}));
+    ASSERT_EQUAL(2000, force.getNumExceptions());
+    ASSERT_EQUAL(2000, force.addExceptions({1500, 1501}, {1600, 1601}, {0, 0}, {1, 1}, {0, 0}));
+    ASSERT(throwsException([&] () {force.addException(1600, 1500, 0.0, 1.0, 0.0);}));
+    ASSERT_EQUAL(2002, force.getNumExceptions());
+}
+
+/**
+ * Check whether adding an exception for two particles is rejected as a duplicate.
+ */
+bool findsDuplicate(NonbondedForce& force, int particle1, int particle2) {
+    try {
+        force.addException(particle1, particle2, 0.0, 1.0, 0.0);
+    }
+    catch (const OpenMMException& ex) {
+        return true;
+    }
+    return false;
+}
+
+void testBulkParameters() {
+    NonbondedForce force;
+    ASSERT_EQUAL(0, force.addParticles({0.1, 0.2, 0.3, 0.4}, {1.1, 1.2, 1.3, 1.4}, {2.1, 2.2, 2.3, 2.4}));
+    force.setParticleParameters(1, {-0.2, -0.3}, {0.5, 0.6}, {0.7, 0.8});
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(1, 3, charges, sigmas, epsilons);
+    ASSERT_EQUAL(3, charges.size());
+    for (int i = 0; i < 3; i++) {
+        double charge, sigma, epsilon;
+        force.getParticleParameters(i+1, charge, sigma, epsilon);
+        ASSERT_EQUAL(charge, charges[i]);
+        ASSERT_EQUAL(sigma, sigmas[i]);
+        ASSERT_EQUAL(epsilon, epsilons[i]);
+    }
+    ASSERT_EQUAL(0, force.addExceptions({0, 1}, {1, 2}, {0.5, 0.6}, {0.7, 0.8}, {0.9, 1.0}));
+    force.setExceptionParameters(1, {1}, {3}, {0.1}, {0.2}, {0.3});
+    vector<int> particles1, particles2;
+    vector<double> chargeProds;
+    force.getExceptionParameters(0, 2, particles1, particles2, chargeProds, sigmas, epsilons);
+    ASSERT_EQUAL(1, particles1[1]);
+    ASSERT_EQUAL(3, particles2[1]);
+    ASSERT_EQUAL(0.1, chargeProds[1]);
+    ASSERT_EQUAL(0.2, sigmas[1]);
+    ASSERT_EQUAL(0.3, epsilons[1]);
+
+    // Changing the particles of an exception frees its old pair and claims the new one.  Two exceptions in
+    // the same range may also exchange their pairs.
+
+    ASSERT(findsDuplicate(force, 3, 1));
+    ASSERT_EQUAL(2, force.addException(2, 1, 0.0, 1.0, 0.0));
+    force.setExceptionParameters(0, {1, 0}, {3, 1}, {0.0, 0.0}, {1.0, 1.0}, {0.0, 0.0});
+    ASSERT(findsDuplicate(force, 0, 1));
+    force.setExceptionParameters(0, {0, 1}, {1, 3}, {0.5, 0.1}, {0.7, 0.2}, {0.9, 0.3});
+    force.setExceptionParameters(2, 2, 3, 0.0, 1.0, 0.0);
+    ASSERT(findsDuplicate(force, 3, 2));
+    ASSERT_EQUAL(3, force.addException(1, 2, 0.0, 1.0, 0.0));
+
+    // Changing the particles of an exception to those of another one should be rejected.
+
+    bool threwException = false;
+    try {
+        force.setExceptionParameters(1, {0, 2}, {1, 3}, {0.0, 0.0}, {1.0, 1.0}, {0.0, 0.0});
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    force.getExceptionParameters(1, particles1[0], particles2[0], chargeProds[0], sigmas[0], epsilons[0]);
+    ASSERT_EQUAL(1, particles1[0]);
+    ASSERT_EQUAL(3, particles2[0]);
+    threwException = false;
+    try {
+        force.setExceptionParameters(3, 0, 1, 0.0, 1.0, 0.0);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    ASSERT(findsDuplicate(force, 2, 1));
+
+    // Duplicate pairs and mismatched or out of range arrays should be rejected without modifying the force.
+
+    threwException = false;
+    try {
+        force.addExceptions({2, 1}, {3, 0}, {0.0, 0.0}, {1.0, 1.0}, {0.0, 0.0});
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    ASSERT_EQUAL(4, force.getNumExceptions());
+    threwException = false;
+    try {
+        force.addParticles({0.1, 0.2}, {1.0}, {1.0, 1.0});
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    ASSERT_EQUAL(4, force.getNumParticles());
+    threwException = false;
+    try {
+        force.getParticleParameters(3, 2, charges, sigmas, epsilons);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
 
 void runPlatformTests() {
+    testComputeEnergies(NonbondedForce::NoCutoff);
+    testComputeEnergies(NonbondedForce::CutoffPeriodic);
+    testComputeEnergies(NonbondedForce::Ewald);
+    testComputeEnergies(NonbondedForce::PME);
+    testThreadsAreDeterministic(NonbondedForce::NoCutoff);
+    testThreadsAreDeterministic(NonbondedForce::CutoffPeriodic);
+    testThreadsAreDeterministic(NonbondedForce::PME);
+    testFixedPointOverflow();
+    testTimingStatistics();
+    testThreadStatistics();
+    testPMETuning();
+    testPMETuningCache();
+    testCreateExceptionsFromBonds(1000);
+    testCreateExceptionsFromBonds(120000);
+    testSortExclusions();
+    testDuplicateExceptions();
+    testBulkParameters();
 }
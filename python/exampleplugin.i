@@ -13,25 +13,149 @@
 namespace std {
   %template(vectord) vector<double>;
   %template(vectori) vector<int>;
+  %template(vectorvectord) vector<vector<double> >;
 };
 
 %{
 #include "ExampleForce.h"
+#include "NonbondedForce.h"
 #include "OpenMM.h"
 #include "OpenMMAmoeba.h"
 #include "OpenMMDrude.h"
 #include "openmm/RPMDIntegrator.h"
 #include "openmm/RPMDMonteCarloBarostat.h"
+#include <cstring>
 %}
 
 %pythoncode %{
+import numpy
 import simtk.openmm as mm
 import simtk.unit as unit
+
+def _asArray(values, dtype, columns):
+    """Convert a sequence, NumPy array, or Quantity to a contiguous array with the given type and number of columns.
+
+    The input must have shape (n, columns).  A single row of length columns, or an empty sequence, is also
+    accepted.  Anything else raises a ValueError rather than being silently reinterpreted.
+    """
+    if unit.is_quantity(values):
+        values = values.value_in_unit_system(unit.md_unit_system)
+    array = numpy.ascontiguousarray(values, dtype=dtype)
+    if array.ndim == 1 and array.shape[0] in (0, columns):
+        array = array.reshape(-1, columns)
+    if array.ndim != 2 or array.shape[1] != columns:
+        raise ValueError('Expected an array of shape (n, %d), but got one of shape %s' % (columns, array.shape))
+    return array
+%}
+
+/*
+ * Access the memory of NumPy arrays (or any other object supporting the buffer protocol)
+ * directly, so whole arrays of parameters can be transferred without Python level loops.
+*/
+%{
+namespace {
+
+/**
+ * Check whether a buffer protocol format string describes a single native element whose type
+ * code is one of the ones in formats.  A byte order prefix is accepted as long as it matches
+ * the native byte order.
+ */
+bool isFormat(const char* format, const char* formats) {
+    if (format == NULL)
+        format = "B";
+    const int one = 1;
+    bool littleEndian = (*(const char*) &one == 1);
+    if (format[0] == '@' || format[0] == '=' || (format[0] == '<' && littleEndian) || ((format[0] == '>' || format[0] == '!') && !littleEndian))
+        format++;
+    return (format[0] != 0 && format[1] == 0 && strchr(formats, format[0]) != NULL);
+}
+
+/**
+ * Holds the buffer of an array of doubles (formats "d") or 32 bit ints (formats "il", since
+ * some platforms report int32 arrays as long) that has the given number of columns.
+ */
+class ArrayBuffer {
+public:
+    ArrayBuffer(PyObject* object, const char* formats, size_t itemSize, int columns, bool writable) {
+        int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+        if (writable)
+            flags |= PyBUF_WRITABLE;
+        if (PyObject_GetBuffer(object, &view, flags) != 0) {
+            PyErr_Clear();
+            throw OpenMM::OpenMMException("Expected a contiguous array");
+        }
+        if ((size_t) view.itemsize != itemSize || !isFormat(view.format, formats) || view.len%(itemSize*columns) != 0) {
+            PyBuffer_Release(&view);
+            throw OpenMM::OpenMMException("The array has the wrong type or shape");
+        }
+        rows = view.len/(itemSize*columns);
+    }
+    ~ArrayBuffer() {
+        PyBuffer_Release(&view);
+    }
+    template <class T>
+    T* data() {
+        return (T*) view.buf;
+    }
+    int rows;
+private:
+    Py_buffer view;
+};
+
+void unpackParticles(ArrayBuffer& buffer, std::vector<double>& charges, std::vector<double>& sigmas, std::vector<double>& epsilons) {
+    const double* data = buffer.data<double>();
+    charges.resize(buffer.rows);
+    sigmas.resize(buffer.rows);
+    epsilons.resize(buffer.rows);
+    for (int i = 0; i < buffer.rows; i++) {
+        charges[i] = data[3*i];
+        sigmas[i] = data[3*i+1];
+        epsilons[i] = data[3*i+2];
+    }
+}
+
+void unpackExceptions(ArrayBuffer& particleBuffer, ArrayBuffer& parameterBuffer, std::vector<int>& particles1, std::vector<int>& particles2,
+                      std::vector<double>& chargeProds, std::vector<double>& sigmas, std::vector<double>& epsilons) {
+    if (particleBuffer.rows != parameterBuffer.rows)
+        throw OpenMM::OpenMMException("The arrays of particles and parameters must have the same length");
+    const int* particles = particleBuffer.data<int>();
+    particles1.resize(particleBuffer.rows);
+    particles2.resize(particleBuffer.rows);
+    for (int i = 0; i < particleBuffer.rows; i++) {
+        particles1[i] = particles[2*i];
+        particles2[i] = particles[2*i+1];
+    }
+    unpackParticles(parameterBuffer, chargeProds, sigmas, epsilons);
+}
+
+}
 %}
 
 /*
  * Add units to function outputs.
 */
+%pythonappend ExamplePlugin::NonbondedForce::getParticleParameters(int index, double& charge, double& sigma,
+                                                                  double& epsilon) const %{
+    val[0] = unit.Quantity(val[0], unit.elementary_charge)
+    val[1] = unit.Quantity(val[1], unit.nanometer)
+    val[2] = unit.Quantity(val[2], unit.kilojoule_per_mole)
+%}
+
+%pythonappend ExamplePlugin::NonbondedForce::getExceptionParameters(int index, int& particle1, int& particle2, double& chargeProd,
+                                                                   double& sigma, double& epsilon) const %{
+    val[2] = unit.Quantity(val[2], unit.elementary_charge**2)
+    val[3] = unit.Quantity(val[3], unit.nanometer)
+    val[4] = unit.Quantity(val[4], unit.kilojoule_per_mole)
+%}
+
+%pythonappend ExamplePlugin::NonbondedForce::getCutoffDistance() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend ExamplePlugin::NonbondedForce::getSwitchingDistance() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
 %pythonappend ExamplePlugin::ExampleForce::getBondParameters(int index, int& particle1, int& particle2,
                                                              double& length, double& k) const %{
     val[2] = unit.Quantity(val[2], unit.nanometer)
@@ -50,6 +174,49 @@ import simtk.unit as unit
     }
 }
 
+/*
+ * Release the GIL while executing methods that can take a long time, so other Python
+ * threads (for example, ones driving other Contexts) can run at the same time.  The GIL
+ * is reacquired before any exception is converted.
+*/
+%{
+namespace {
+
+class ReleaseGIL {
+public:
+    ReleaseGIL() {
+        state = PyEval_SaveThread();
+    }
+    ~ReleaseGIL() {
+        PyEval_RestoreThread(state);
+    }
+private:
+    PyThreadState* state;
+};
+
+}
+%}
+
+%define RELEASE_GIL(method)
+%exception method {
+    try {
+        ReleaseGIL release;
+        $action
+    } catch (std::exception &e) {
+        PyErr_SetString(PyExc_Exception, const_cast<char*>(e.what()));
+        return NULL;
+    }
+}
+%enddef
+
+RELEASE_GIL(ExamplePlugin::ExampleForce::updateParametersInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::updateParametersInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::updateChargesInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::getPMEParametersInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::getLJPMEParametersInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::estimateForceErrorInContext);
+RELEASE_GIL(ExamplePlugin::NonbondedForce::computeEnergiesInContext);
+
 
 namespace ExamplePlugin {
 
@@ -93,4 +260,374 @@ public:
     }
 };
 
+class NonbondedForce : public OpenMM::Force {
+public:
+    enum NonbondedMethod {
+        NoCutoff = 0,
+        CutoffNonPeriodic = 1,
+        CutoffPeriodic = 2,
+        Ewald = 3,
+        PME = 4,
+        LJPME = 5
+    };
+
+    NonbondedForce();
+
+    int getNumParticles() const;
+
+    int getNumExceptions() const;
+
+    int getNumGlobalParameters() const;
+
+    int getNumParticleParameterOffsets() const;
+
+    int getNumExceptionParameterOffsets() const;
+
+    NonbondedMethod getNonbondedMethod() const;
+
+    void setNonbondedMethod(NonbondedMethod method);
+
+    double getCutoffDistance() const;
+
+    void setCutoffDistance(double distance);
+
+    bool getUseSwitchingFunction() const;
+
+    void setUseSwitchingFunction(bool use);
+
+    double getSwitchingDistance() const;
+
+    void setSwitchingDistance(double distance);
+
+    double getReactionFieldDielectric() const;
+
+    void setReactionFieldDielectric(double dielectric);
+
+    double getEwaldErrorTolerance() const;
+
+    void setEwaldErrorTolerance(double tol);
+
+    void setPMEParameters(double alpha, int nx, int ny, int nz);
+
+    void setLJPMEParameters(double alpha, int nx, int ny, int nz);
+
+    bool getUsePMETuning() const;
+
+    void setUsePMETuning(bool use);
+
+    const std::string& getPMETuningCacheFile() const;
+
+    void setPMETuningCacheFile(const std::string& file);
+
+    int addParticle(double charge, double sigma, double epsilon);
+
+    void setParticleParameters(int index, double charge, double sigma, double epsilon);
+
+    int addException(int particle1, int particle2, double chargeProd, double sigma, double epsilon, bool replace = false);
+
+    void setExceptionParameters(int index, int particle1, int particle2, double chargeProd, double sigma, double epsilon);
+
+    int addGlobalParameter(const std::string& name, double defaultValue);
+
+    const std::string& getGlobalParameterName(int index) const;
+
+    void setGlobalParameterName(int index, const std::string& name);
+
+    double getGlobalParameterDefaultValue(int index) const;
+
+    void setGlobalParameterDefaultValue(int index, double defaultValue);
+
+    int addParticleParameterOffset(const std::string& parameter, int particleIndex, double chargeScale, double sigmaScale, double epsilonScale);
+
+    void setParticleParameterOffset(int index, const std::string& parameter, int particleIndex, double chargeScale, double sigmaScale, double epsilonScale);
+
+    int addExceptionParameterOffset(const std::string& parameter, int exceptionIndex, double chargeProdScale, double sigmaScale, double epsilonScale);
+
+    void setExceptionParameterOffset(int index, const std::string& parameter, int exceptionIndex, double chargeProdScale, double sigmaScale, double epsilonScale);
+
+    bool getUseDispersionCorrection() const;
+
+    void setUseDispersionCorrection(bool useCorrection);
+
+    int getReciprocalSpaceForceGroup() const;
+
+    void setReciprocalSpaceForceGroup(int group);
+
+    bool getExceptionsUsePeriodicBoundaryConditions() const;
+
+    void setExceptionsUsePeriodicBoundaryConditions(bool periodic);
+
+    bool usesPeriodicBoundaryConditions() const;
+
+    void updateParametersInContext(OpenMM::Context& context);
+
+    void updateParametersInContext(OpenMM::Context& context, int firstParticle, int lastParticle, int firstException, int lastException);
+
+    void updateParametersInContext(OpenMM::Context& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+
+    void updateChargesInContext(OpenMM::Context& context, const std::vector<int>& particles, const std::vector<int>& exceptions);
+
+    void setNumThreadsInContext(OpenMM::Context& context, int numThreads);
+
+    int getNumThreadsInContext(const OpenMM::Context& context) const;
+
+    void setTimingEnabledInContext(OpenMM::Context& context, bool enabled);
+
+    void resetTimingStatisticsInContext(OpenMM::Context& context);
+
+    /*
+     * The reference parameters to these functions are output values.
+     * Marking them as such will cause swig to return a tuple.
+    */
+    %apply int& OUTPUT {int& nx};
+    %apply int& OUTPUT {int& ny};
+    %apply int& OUTPUT {int& nz};
+    %apply double& OUTPUT {double& alpha};
+    void getPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+    void getLJPMEParameters(double& alpha, int& nx, int& ny, int& nz) const;
+    void getPMEParametersInContext(const OpenMM::Context& context, double& alpha, int& nx, int& ny, int& nz) const;
+    void getLJPMEParametersInContext(const OpenMM::Context& context, double& alpha, int& nx, int& ny, int& nz) const;
+    %clear int& nx;
+    %clear int& ny;
+    %clear int& nz;
+    %clear double& alpha;
+
+    %extend {
+        /*
+         * Return the energies instead of filling in an output argument.
+        */
+        std::vector<double> computeEnergiesInContext(OpenMM::Context& context, const std::vector<std::vector<double> >& parameterValues) {
+            std::vector<double> energies;
+            self->computeEnergiesInContext(context, parameterValues, energies);
+            return energies;
+        }
+
+        /*
+         * Return the timing statistics as a tuple of a dict mapping each phase to its time in seconds,
+         * and the number of evaluations.
+        */
+        PyObject* getTimingStatisticsInContext(const OpenMM::Context& context) const {
+            std::map<std::string, double> times;
+            int numEvaluations;
+            self->getTimingStatisticsInContext(context, times, numEvaluations);
+            PyObject* dict = PyDict_New();
+            for (auto& time : times) {
+                PyObject* value = PyFloat_FromDouble(time.second);
+                PyDict_SetItemString(dict, time.first.c_str(), value);
+                Py_DECREF(value);
+            }
+            return Py_BuildValue("(Ni)", dict, numEvaluations);
+        }
+
+        /*
+         * Return the thread statistics as a tuple of lists (blocks, interactions, busyTimes, waitTimes)
+         * followed by the imbalance factor.
+        */
+        PyObject* getThreadStatisticsInContext(const OpenMM::Context& context, bool lastEvaluation=false) const {
+            std::vector<int> blocks;
+            std::vector<long long> interactions;
+            std::vector<double> busyTimes, waitTimes;
+            double imbalance;
+            self->getThreadStatisticsInContext(context, blocks, interactions, busyTimes, waitTimes, imbalance, lastEvaluation);
+            int numThreads = blocks.size();
+            PyObject* blockList = PyList_New(numThreads);
+            PyObject* interactionList = PyList_New(numThreads);
+            PyObject* busyList = PyList_New(numThreads);
+            PyObject* waitList = PyList_New(numThreads);
+            for (int i = 0; i < numThreads; i++) {
+                PyList_SET_ITEM(blockList, i, PyLong_FromLong(blocks[i]));
+                PyList_SET_ITEM(interactionList, i, PyLong_FromLongLong(interactions[i]));
+                PyList_SET_ITEM(busyList, i, PyFloat_FromDouble(busyTimes[i]));
+                PyList_SET_ITEM(waitList, i, PyFloat_FromDouble(waitTimes[i]));
+            }
+            return Py_BuildValue("(NNNNd)", blockList, interactionList, busyList, waitList, imbalance);
+        }
+    }
+
+    %apply double& OUTPUT {double& rmsError};
+    %apply double& OUTPUT {double& rmsForce};
+    void estimateForceErrorInContext(const OpenMM::Context& context, double& rmsError, double& rmsForce, int numSamples=100) const;
+    %clear double& rmsError;
+    %clear double& rmsForce;
+
+    %apply double& OUTPUT {double& charge};
+    %apply double& OUTPUT {double& sigma};
+    %apply double& OUTPUT {double& epsilon};
+    void getParticleParameters(int index, double& charge, double& sigma, double& epsilon) const;
+    %clear double& charge;
+
+    %apply int& OUTPUT {int& particle1};
+    %apply int& OUTPUT {int& particle2};
+    %apply double& OUTPUT {double& chargeProd};
+    void getExceptionParameters(int index, int& particle1, int& particle2, double& chargeProd, double& sigma, double& epsilon) const;
+    %clear int& particle1;
+    %clear int& particle2;
+    %clear double& chargeProd;
+    %clear double& sigma;
+    %clear double& epsilon;
+
+    %apply std::string& OUTPUT {std::string& parameter};
+    %apply int& OUTPUT {int& particleIndex};
+    %apply int& OUTPUT {int& exceptionIndex};
+    %apply double& OUTPUT {double& chargeScale};
+    %apply double& OUTPUT {double& chargeProdScale};
+    %apply double& OUTPUT {double& sigmaScale};
+    %apply double& OUTPUT {double& epsilonScale};
+    void getParticleParameterOffset(int index, std::string& parameter, int& particleIndex, double& chargeScale, double& sigmaScale, double& epsilonScale) const;
+    void getExceptionParameterOffset(int index, std::string& parameter, int& exceptionIndex, double& chargeProdScale, double& sigmaScale, double& epsilonScale) const;
+    %clear std::string& parameter;
+    %clear int& particleIndex;
+    %clear int& exceptionIndex;
+    %clear double& chargeScale;
+    %clear double& chargeProdScale;
+    %clear double& sigmaScale;
+    %clear double& epsilonScale;
+
+    %extend {
+        /*
+         * Add methods for casting a Force to a NonbondedForce.
+        */
+        static ExamplePlugin::NonbondedForce& cast(OpenMM::Force& force) {
+            return dynamic_cast<ExamplePlugin::NonbondedForce&>(force);
+        }
+
+        static bool isinstance(OpenMM::Force& force) {
+            return (dynamic_cast<ExamplePlugin::NonbondedForce*>(&force) != NULL);
+        }
+
+        /*
+         * Bulk access to particles and exceptions.  These work directly on the memory of the arrays
+         * passed to them and are called by the array methods defined below.  The GIL is released
+         * once the buffers have been acquired.
+        */
+        int _addParticlesFromBuffer(PyObject* parameters) {
+            ArrayBuffer buffer(parameters, "d", sizeof(double), 3, false);
+            std::vector<double> charges, sigmas, epsilons;
+            ReleaseGIL release;
+            unpackParticles(buffer, charges, sigmas, epsilons);
+            return self->addParticles(charges, sigmas, epsilons);
+        }
+
+        void _setParticleParametersFromBuffer(int firstIndex, PyObject* parameters) {
+            ArrayBuffer buffer(parameters, "d", sizeof(double), 3, false);
+            std::vector<double> charges, sigmas, epsilons;
+            ReleaseGIL release;
+            unpackParticles(buffer, charges, sigmas, epsilons);
+            self->setParticleParameters(firstIndex, charges, sigmas, epsilons);
+        }
+
+        void _getParticleParametersToBuffer(int firstIndex, PyObject* parameters) {
+            ArrayBuffer buffer(parameters, "d", sizeof(double), 3, true);
+            std::vector<double> charges, sigmas, epsilons;
+            ReleaseGIL release;
+            self->getParticleParameters(firstIndex, buffer.rows, charges, sigmas, epsilons);
+            double* data = buffer.data<double>();
+            for (int i = 0; i < buffer.rows; i++) {
+                data[3*i] = charges[i];
+                data[3*i+1] = sigmas[i];
+                data[3*i+2] = epsilons[i];
+            }
+        }
+
+        int _addExceptionsFromBuffer(PyObject* particles, PyObject* parameters) {
+            ArrayBuffer particleBuffer(particles, "il", sizeof(int), 2, false);
+            ArrayBuffer parameterBuffer(parameters, "d", sizeof(double), 3, false);
+            std::vector<int> particles1, particles2;
+            std::vector<double> chargeProds, sigmas, epsilons;
+            ReleaseGIL release;
+            unpackExceptions(particleBuffer, parameterBuffer, particles1, particles2, chargeProds, sigmas, epsilons);
+            return self->addExceptions(particles1, particles2, chargeProds, sigmas, epsilons);
+        }
+
+        void _setExceptionParametersFromBuffer(int firstIndex, PyObject* particles, PyObject* parameters) {
+            ArrayBuffer particleBuffer(particles, "il", sizeof(int), 2, false);
+            ArrayBuffer parameterBuffer(parameters, "d", sizeof(double), 3, false);
+            std::vector<int> particles1, particles2;
+            std::vector<double> chargeProds, sigmas, epsilons;
+            ReleaseGIL release;
+            unpackExceptions(particleBuffer, parameterBuffer, particles1, particles2, chargeProds, sigmas, epsilons);
+            self->setExceptionParameters(firstIndex, particles1, particles2, chargeProds, sigmas, epsilons);
+        }
+
+        void _getExceptionParametersToBuffer(int firstIndex, PyObject* particles, PyObject* parameters) {
+            ArrayBuffer particleBuffer(particles, "il", sizeof(int), 2, true);
+            ArrayBuffer parameterBuffer(parameters, "d", sizeof(double), 3, true);
+            if (particleBuffer.rows != parameterBuffer.rows)
+                throw OpenMM::OpenMMException("The arrays of particles and parameters must have the same length");
+            std::vector<int> particles1, particles2;
+            std::vector<double> chargeProds, sigmas, epsilons;
+            ReleaseGIL release;
+            self->getExceptionParameters(firstIndex, particleBuffer.rows, particles1, particles2, chargeProds, sigmas, epsilons);
+            int* particleData = particleBuffer.data<int>();
+            double* parameterData = parameterBuffer.data<double>();
+            for (int i = 0; i < particleBuffer.rows; i++) {
+                particleData[2*i] = particles1[i];
+                particleData[2*i+1] = particles2[i];
+                parameterData[3*i] = chargeProds[i];
+                parameterData[3*i+1] = sigmas[i];
+                parameterData[3*i+2] = epsilons[i];
+            }
+        }
+
+        void _createExceptionsFromBondsBuffer(PyObject* bonds, double coulomb14Scale, double lj14Scale) {
+            ArrayBuffer buffer(bonds, "il", sizeof(int), 2, false);
+            const int* data = buffer.data<int>();
+            ReleaseGIL release;
+            std::vector<std::pair<int, int> > bondPairs(buffer.rows);
+            for (int i = 0; i < buffer.rows; i++)
+                bondPairs[i] = std::make_pair(data[2*i], data[2*i+1]);
+            self->createExceptionsFromBonds(bondPairs, coulomb14Scale, lj14Scale);
+        }
+
+        %pythoncode %{
+            def createExceptionsFromBonds(self, bonds, coulomb14Scale, lj14Scale):
+                """Identify exceptions based on the molecular topology.  bonds is a sequence of pairs of
+                particle indices, or an array of shape (n, 2).  Particles separated by one or two bonds are
+                excluded, and those separated by three bonds have their Coulomb and Lennard-Jones interactions
+                scaled by coulomb14Scale and lj14Scale."""
+                self._createExceptionsFromBondsBuffer(_asArray(bonds, numpy.int32, 2), coulomb14Scale, lj14Scale)
+
+            def addParticlesArray(self, parameters):
+                """Add many particles at once.  parameters is an array of shape (n, 3) whose columns are
+                charge, sigma, and epsilon.  Returns the index of the first particle that was added."""
+                return self._addParticlesFromBuffer(_asArray(parameters, numpy.float64, 3))
+
+            def setParticleParametersArray(self, parameters, firstIndex=0):
+                """Set the parameters of a consecutive range of particles from an array of shape (n, 3)
+                whose columns are charge, sigma, and epsilon."""
+                self._setParticleParametersFromBuffer(firstIndex, _asArray(parameters, numpy.float64, 3))
+
+            def getParticleParametersArray(self, firstIndex=0, numParticles=None):
+                """Get the parameters of a consecutive range of particles as an array of shape (n, 3)
+                whose columns are charge, sigma, and epsilon."""
+                if numParticles is None:
+                    numParticles = self.getNumParticles()-firstIndex
+                parameters = numpy.empty((numParticles, 3), dtype=numpy.float64)
+                self._getParticleParametersToBuffer(firstIndex, parameters)
+                return parameters
+
+            def addExceptionsArray(self, particles, parameters):
+                """Add many exceptions at once.  particles is an array of shape (n, 2) containing the
+                pairs of particles, and parameters is an array of shape (n, 3) whose columns are chargeProd,
+                sigma, and epsilon.  Returns the index of the first exception that was added."""
+                return self._addExceptionsFromBuffer(_asArray(particles, numpy.int32, 2), _asArray(parameters, numpy.float64, 3))
+
+            def setExceptionParametersArray(self, particles, parameters, firstIndex=0):
+                """Set the particles and parameters of a consecutive range of exceptions from arrays of
+                shape (n, 2) and (n, 3)."""
+                self._setExceptionParametersFromBuffer(firstIndex, _asArray(particles, numpy.int32, 2), _asArray(parameters, numpy.float64, 3))
+
+            def getExceptionParametersArray(self, firstIndex=0, numExceptions=None):
+                """Get the particles and parameters of a consecutive range of exceptions.  Returns a tuple
+                of two arrays with shapes (n, 2) and (n, 3)."""
+                if numExceptions is None:
+                    numExceptions = self.getNumExceptions()-firstIndex
+                particles = numpy.empty((numExceptions, 2), dtype=numpy.int32)
+                parameters = numpy.empty((numExceptions, 3), dtype=numpy.float64)
+                self._getExceptionParametersToBuffer(firstIndex, particles, parameters)
+                return (particles, parameters)
+        %}
+    }
+};
+
 }
@@ -28,5 +28,6 @@ extension = Extension(name='_exampleplugin',
 setup(name='exampleplugin',
       version='1.0',
       py_modules=['exampleplugin'],
+      requires=['numpy'],
       ext_modules=[extension],
      )
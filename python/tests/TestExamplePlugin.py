@@ -0,0 +1,186 @@
+import unittest
+
+import numpy
+import simtk.openmm as mm
+import simtk.unit as unit
+from exampleplugin import NonbondedForce
+
+
+class TestNonbondedForceArrays(unittest.TestCase):
+    """Test the array based methods of NonbondedForce."""
+
+    def createParticles(self, numParticles):
+        parameters = numpy.empty((numParticles, 3))
+        parameters[:,0] = numpy.linspace(-1.0, 1.0, numParticles)
+        parameters[:,1] = 0.3
+        parameters[:,2] = numpy.linspace(0.1, 1.0, numParticles)
+        return parameters
+
+    def testParticleArrays(self):
+        force = NonbondedForce()
+        parameters = self.createParticles(10)
+        self.assertEqual(0, force.addParticlesArray(parameters))
+        self.assertEqual(10, force.addParticlesArray(parameters[:5]))
+        self.assertEqual(15, force.getNumParticles())
+        for i in range(10):
+            charge, sigma, epsilon = force.getParticleParameters(i)
+            self.assertEqual(parameters[i,0], charge.value_in_unit(unit.elementary_charge))
+            self.assertEqual(parameters[i,1], sigma.value_in_unit(unit.nanometer))
+            self.assertEqual(parameters[i,2], epsilon.value_in_unit(unit.kilojoule_per_mole))
+        numpy.testing.assert_array_equal(parameters[:5], force.getParticleParametersArray(10))
+        force.setParticleParametersArray(2*parameters[:3], 4)
+        numpy.testing.assert_array_equal(2*parameters[:3], force.getParticleParametersArray(4, 3))
+        numpy.testing.assert_array_equal(parameters[7:], force.getParticleParametersArray(7, 3))
+
+        # Lists should be converted.
+
+        force.setParticleParametersArray([[0.5, 0.2, 0.1]], 0)
+        numpy.testing.assert_array_equal([[0.5, 0.2, 0.1]], force.getParticleParametersArray(0, 1))
+
+    def testExceptionArrays(self):
+        force = NonbondedForce()
+        force.addParticlesArray(self.createParticles(10))
+        particles = numpy.array([[0, 1], [2, 3], [4, 5]], dtype=numpy.int32)
+        parameters = numpy.array([[0.1, 0.2, 0.3], [0.4, 0.5, 0.6], [0.7, 0.8, 0.9]])
+        self.assertEqual(0, force.addExceptionsArray(particles, parameters))
+        self.assertEqual(3, force.getNumExceptions())
+        p, q = force.getExceptionParametersArray()
+        numpy.testing.assert_array_equal(particles, p)
+        numpy.testing.assert_array_equal(parameters, q)
+        force.setExceptionParametersArray(particles[1:], 2*parameters[1:], 1)
+        p, q = force.getExceptionParametersArray(1, 2)
+        numpy.testing.assert_array_equal(particles[1:], p)
+        numpy.testing.assert_array_equal(2*parameters[1:], q)
+        with self.assertRaises(Exception):
+            force.addExceptionsArray(particles, parameters[:2])
+
+    def testWrongTypes(self):
+        """The buffer methods must reject arrays whose element type does not match, even if the size does."""
+        force = NonbondedForce()
+        force.addParticlesArray(self.createParticles(4))
+        with self.assertRaises(Exception):
+            force._addParticlesFromBuffer(numpy.zeros((2, 3), dtype=numpy.int64))
+        with self.assertRaises(Exception):
+            force._addParticlesFromBuffer(numpy.zeros((2, 3), dtype=numpy.float32))
+        with self.assertRaises(Exception):
+            force._addExceptionsFromBuffer(numpy.zeros((2, 2), dtype=numpy.float32), numpy.zeros((2, 3)))
+        with self.assertRaises(Exception):
+            force._addExceptionsFromBuffer(numpy.zeros((2, 2), dtype=numpy.uint32), numpy.zeros((2, 3)))
+        with self.assertRaises(Exception):
+            force._getParticleParametersToBuffer(0, numpy.zeros((4, 3), dtype=numpy.int64))
+        with self.assertRaises(Exception):
+            force._addParticlesFromBuffer(numpy.zeros((2, 3), dtype='>f8' if numpy.little_endian else '<f8'))
+        with self.assertRaises(Exception):
+            force._addParticlesFromBuffer(numpy.zeros((6, 3))[::2])
+        with self.assertRaises(Exception):
+            force._addParticlesFromBuffer(numpy.zeros(4))
+        self.assertEqual(4, force.getNumParticles())
+        self.assertEqual(0, force.getNumExceptions())
+
+        # The public methods convert their arguments.
+
+        force.addParticlesArray(numpy.zeros((2, 3), dtype=numpy.float32))
+        force.addExceptionsArray(numpy.array([[0, 1]], dtype=numpy.int64), [[0.0, 1.0, 0.0]])
+        self.assertEqual(6, force.getNumParticles())
+        self.assertEqual(1, force.getNumExceptions())
+
+    def testCreateExceptionsFromBonds(self):
+        bonds = [(0, 1), (1, 2), (2, 3), (3, 4)]
+        force1 = NonbondedForce()
+        force1.addParticlesArray(self.createParticles(5))
+        force1.createExceptionsFromBonds(bonds, 0.5, 0.25)
+        force2 = NonbondedForce()
+        force2.addParticlesArray(self.createParticles(5))
+        force2.createExceptionsFromBonds(numpy.array(bonds, dtype=numpy.int64), 0.5, 0.25)
+        self.assertEqual(9, force1.getNumExceptions())
+        p1, q1 = force1.getExceptionParametersArray()
+        p2, q2 = force2.getExceptionParametersArray()
+        numpy.testing.assert_array_equal(p1, p2)
+        numpy.testing.assert_array_equal(q1, q2)
+        with self.assertRaises(Exception):
+            force1.createExceptionsFromBonds([(0, 5)], 0.5, 0.25)
+
+    def testArrayShapes(self):
+        """Arrays with the wrong shape must be rejected instead of being reshaped."""
+        force = NonbondedForce()
+        force.addParticlesArray([0.5, 0.2, 0.1])
+        force.addParticlesArray(numpy.zeros((0, 3)))
+        self.assertEqual(1, force.getNumParticles())
+        for parameters in [numpy.zeros(6), numpy.zeros((3, 2)), numpy.zeros((2, 6)), numpy.zeros((1, 2, 3))]:
+            with self.assertRaises(ValueError):
+                force.addParticlesArray(parameters)
+        with self.assertRaises(ValueError):
+            force.addExceptionsArray([0, 0, 0, 0], numpy.zeros((2, 3)))
+        with self.assertRaises(ValueError):
+            force.createExceptionsFromBonds(numpy.zeros((2, 3), dtype=numpy.int32), 0.5, 0.25)
+        self.assertEqual(1, force.getNumParticles())
+        self.assertEqual(0, force.getNumExceptions())
+
+    def testLargeArrays(self):
+        """The parameters of a million particles should survive a round trip through the array methods."""
+        numParticles = 1000000
+        parameters = self.createParticles(numParticles)
+        force = NonbondedForce()
+        force.addParticlesArray(parameters)
+        numpy.testing.assert_array_equal(parameters, force.getParticleParametersArray())
+
+
+class TestNonbondedForceStatistics(unittest.TestCase):
+    """Test the methods for controlling threads and collecting timing statistics in a Context."""
+
+    def createContext(self, numParticles=200, boxSize=2.5):
+        system = mm.System()
+        system.setDefaultPeriodicBoxVectors(mm.Vec3(boxSize, 0, 0), mm.Vec3(0, boxSize, 0), mm.Vec3(0, 0, boxSize))
+        force = NonbondedForce()
+        force.setNonbondedMethod(NonbondedForce.PME)
+        force.setCutoffDistance(1.0)
+        force.setReciprocalSpaceForceGroup(1)
+        parameters = numpy.zeros((numParticles, 3))
+        parameters[:,0] = numpy.where(numpy.arange(numParticles)%2 == 0, 0.5, -0.5)
+        parameters[:,1] = 0.2
+        parameters[:,2] = 0.5
+        force.addParticlesArray(parameters)
+        for i in range(numParticles):
+            system.addParticle(1.0)
+        system.addForce(force)
+        context = mm.Context(system, mm.VerletIntegrator(0.001), mm.Platform.getPlatformByName('Reference'))
+        context.setPositions(numpy.random.RandomState(0).random_sample((numParticles, 3))*boxSize)
+        return context, force
+
+    def testThreads(self):
+        context, force = self.createContext()
+        self.assertEqual(0, force.getNumThreadsInContext(context))
+        force.setNumThreadsInContext(context, 3)
+        self.assertEqual(3, force.getNumThreadsInContext(context))
+        with self.assertRaises(Exception):
+            force.setNumThreadsInContext(context, -1)
+
+    def testTimingStatistics(self):
+        context, force = self.createContext()
+        force.setNumThreadsInContext(context, 2)
+        force.setTimingEnabledInContext(context, True)
+        for i in range(3):
+            context.getState(getForces=True)
+        times, numEvaluations = force.getTimingStatisticsInContext(context)
+        self.assertEqual(3, numEvaluations)
+        self.assertGreater(times['direct'], 0.0)
+        self.assertGreater(times['reciprocal'], 0.0)
+        blocks, interactions, busyTimes, waitTimes, imbalance = force.getThreadStatisticsInContext(context)
+        self.assertEqual(2, len(blocks))
+        self.assertEqual(2, len(interactions))
+        self.assertEqual(2, len(busyTimes))
+        self.assertEqual(2, len(waitTimes))
+        self.assertGreater(sum(interactions), 0)
+        self.assertGreaterEqual(imbalance, 1.0-1e-10)
+        lastInteractions = force.getThreadStatisticsInContext(context, True)[1]
+        self.assertEqual(2, len(lastInteractions))
+        self.assertEqual(sum(interactions), 3*sum(lastInteractions))
+        force.resetTimingStatisticsInContext(context)
+        times, numEvaluations = force.getTimingStatisticsInContext(context)
+        self.assertEqual(0, numEvaluations)
+        self.assertEqual(0.0, sum(times.values()))
+        self.assertEqual(0, len(force.getThreadStatisticsInContext(context)[0]))
+
+
+if __name__ == '__main__':
+    unittest.main()
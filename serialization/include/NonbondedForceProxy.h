@@ -1,5 +1,5 @@
-#ifndef OPENMM_NONBONDEDFORCE_PROXY_H_
-#define OPENMM_NONBONDEDFORCE_PROXY_H_
+#ifndef OPENMM_EXAMPLE_NONBONDEDFORCE_PROXY_H_
+#define OPENMM_EXAMPLE_NONBONDEDFORCE_PROXY_H_
 
 /* -------------------------------------------------------------------------- *
  *                                   OpenMM                                   *
@@ -32,22 +32,34 @@
  * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
  * -------------------------------------------------------------------------- */
 
-#include "openmm/internal/windowsExport.h"
+#include "internal/windowsExportExample.h"
+#include "NonbondedForce.h"
 #include "openmm/serialization/SerializationProxy.h"
 
-namespace OpenMM {
+namespace ExamplePlugin {
 
 /**
- * This is a proxy for serializing NonbondedForce objects.
+ * This is a proxy for serializing NonbondedForce objects.  It is registered under the type name
+ * "ExampleNonbondedForce" so that it does not replace the proxy for OpenMM's own NonbondedForce.
  */
 
-class OPENMM_EXPORT NonbondedForceProxy : public SerializationProxy {
+class OPENMM_EXPORT_EXAMPLE NonbondedForceProxy : public OpenMM::SerializationProxy {
 public:
     NonbondedForceProxy();
-    void serialize(const void* object, SerializationNode& node) const;
-    void* deserialize(const SerializationNode& node) const;
+    void serialize(const void* object, OpenMM::SerializationNode& node) const;
+    void* deserialize(const OpenMM::SerializationNode& node) const;
+    /**
+     * Serialize everything about a NonbondedForce except its particles and exceptions.  This is used by
+     * StreamSerializer, which writes the particles and exceptions separately.
+     */
+    static void serializeSettings(const NonbondedForce& force, OpenMM::SerializationNode& node);
+    /**
+     * Restore the settings written by serializeSettings() into a NonbondedForce, and return the version number
+     * of the serialized data.
+     */
+    static int deserializeSettings(const OpenMM::SerializationNode& node, NonbondedForce& force);
 };
 
-} // namespace OpenMM
+} // namespace ExamplePlugin
 
-#endif /*OPENMM_NONBONDEDFORCE_PROXY_H_*/
+#endif /*OPENMM_EXAMPLE_NONBONDEDFORCE_PROXY_H_*/
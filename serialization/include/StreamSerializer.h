@@ -0,0 +1,116 @@
+#ifndef OPENMM_EXAMPLE_STREAM_SERIALIZER_H_
+#define OPENMM_EXAMPLE_STREAM_SERIALIZER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2010-2020 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+
+#include "internal/windowsExportExample.h"
+#include "ExampleForce.h"
+#include "NonbondedForce.h"
+#include <iosfwd>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/**
+ * This class writes forces to a binary stream and reads them back, without ever holding the whole serialized
+ * representation in memory.  XmlSerializer first builds a SerializationNode tree for the entire force, which for
+ * a large system can take more memory than the force itself.  StreamSerializer instead writes the per-particle,
+ * per-exception, and per-bond data in chunks as it goes, and adds each chunk to the force as soon as it is read,
+ * so the extra memory needed is proportional to the chunk size rather than the size of the system.
+ *
+ * The settings of a NonbondedForce are stored in the same form as NonbondedForceProxy uses, so the two formats
+ * always support the same features.  All numbers are stored in little endian order.  Streams should be opened in
+ * binary mode.
+ */
+class OPENMM_EXPORT_EXAMPLE StreamSerializer {
+public:
+    /**
+     * The number of items written in each chunk if no other value is specified.
+     */
+    static const int DefaultChunkSize = 65536;
+    /**
+     * Write a NonbondedForce to a stream.
+     *
+     * @param force      the force to write
+     * @param stream     the stream to write it to
+     * @param chunkSize  the maximum number of particles or exceptions to write in each chunk
+     */
+    static void serialize(const NonbondedForce& force, std::ostream& stream, int chunkSize=DefaultChunkSize);
+    /**
+     * Write an ExampleForce to a stream.
+     *
+     * @param force      the force to write
+     * @param stream     the stream to write it to
+     * @param chunkSize  the maximum number of bonds to write in each chunk
+     */
+    static void serialize(const ExampleForce& force, std::ostream& stream, int chunkSize=DefaultChunkSize);
+    /**
+     * Read a force that was written by serialize().  The caller takes ownership of the returned object, which
+     * can be cast to NonbondedForce or ExampleForce depending on what was written.
+     *
+     * @param stream     the stream to read from
+     */
+    static OpenMM::Force* deserialize(std::istream& stream);
+    /**
+     * Write a patch that converts one NonbondedForce into another.  Only the particles, exceptions, parameter
+     * offsets, and global parameter default values that differ between the two forces are written, so the size
+     * of the patch is proportional to the number of changes rather than the size of the system.  Everything else
+     * about the forces, including the numbers of particles, exceptions, and offsets and the particles each
+     * exception applies to, must be identical.
+     *
+     * @param base    the force the patch will be applied to
+     * @param target  the force that applying the patch should produce
+     * @param stream  the stream to write the patch to
+     */
+    static void serializePatch(const NonbondedForce& base, const NonbondedForce& target, std::ostream& stream);
+    /**
+     * Apply a patch that was written by serializePatch().  The patch records a hash of the force it was created
+     * from, and an exception is thrown if it does not match the force it is being applied to.  The whole patch is
+     * checked before anything is modified, so if an exception is thrown, the force is left unchanged.
+     *
+     * To copy the changes to an existing Context, pass the indices returned by this method to
+     * NonbondedForce::updateParametersInContext().  The cost of that is proportional to the number of changes.
+     * Parameter offsets cannot be updated that way, and changes to global parameter default values only affect
+     * Contexts created afterward.
+     *
+     * @param force            the force to apply the patch to
+     * @param stream           the stream to read the patch from
+     * @param[out] particles   the indices of the particles that were modified, in increasing order
+     * @param[out] exceptions  the indices of the exceptions that were modified, in increasing order
+     */
+    static void applyPatch(NonbondedForce& force, std::istream& stream, std::vector<int>& particles, std::vector<int>& exceptions);
+};
+
+} // namespace ExamplePlugin
+
+#endif /*OPENMM_EXAMPLE_STREAM_SERIALIZER_H_*/
@@ -40,6 +40,8 @@
 
 #include "ExampleForce.h"
 #include "ExampleForceProxy.h"
+#include "NonbondedForce.h"
+#include "NonbondedForceProxy.h"
 #include "openmm/serialization/SerializationProxy.h"
 
 #if defined(WIN32)
@@ -59,4 +61,5 @@ using namespace OpenMM;
 
 extern "C" OPENMM_EXPORT_EXAMPLE void registerExampleSerializationProxies() {
     SerializationProxy::registerProxy(typeid(ExampleForce), new ExampleForceProxy());
+    SerializationProxy::registerProxy(typeid(ExamplePlugin::NonbondedForce), new NonbondedForceProxy());
 }
@@ -29,21 +29,233 @@
  * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
  * -------------------------------------------------------------------------- */
 
-#include "openmm/serialization/NonbondedForceProxy.h"
+#include "NonbondedForceProxy.h"
+#include "NonbondedForce.h"
+#include "PackedArrays.h"
 #include "openmm/serialization/SerializationNode.h"
 #include "openmm/Force.h"
-#include "openmm/NonbondedForce.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
 #include <sstream>
 
+using namespace ExamplePlugin;
 using namespace OpenMM;
 using namespace std;
 
-NonbondedForceProxy::NonbondedForceProxy() : SerializationProxy("NonbondedForce") {
+/*
+ * Starting with version 5, the parameters of particles, exceptions, and offsets are not stored as one child
+ * node per item.  Instead, each list is stored as a single node with a "count" property and a "data" property.
+ * The data contains one packed array for each field, in order.  Each array holds count values as little endian
+ * 32 bit integers or 64 bit doubles, and the whole block is encoded in base 64 so it can be embedded in XML.
+ */
+
+static const char* Base64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static string encodeBase64(const string& bytes) {
+    string encoded;
+    encoded.reserve(4*((bytes.size()+2)/3));
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        int length = min((size_t) 3, bytes.size()-i);
+        unsigned int block = 0;
+        for (int j = 0; j < 3; j++)
+            block = (block<<8) | (j < length ? (unsigned char) bytes[i+j] : 0);
+        for (int j = 0; j < 4; j++)
+            encoded += (j <= length ? Base64Chars[(block>>(18-6*j))&63] : '=');
+    }
+    return encoded;
 }
 
-void NonbondedForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 4);
-    const NonbondedForce& force = *reinterpret_cast<const NonbondedForce*>(object);
+static string decodeBase64(const string& encoded) {
+    int values[256];
+    fill(values, values+256, -1);
+    for (int i = 0; i < 64; i++)
+        values[(unsigned char) Base64Chars[i]] = i;
+    if (encoded.size()%4 != 0)
+        throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+    string bytes;
+    bytes.reserve(3*(encoded.size()/4));
+    for (size_t i = 0; i < encoded.size(); i += 4) {
+        unsigned int block = 0;
+        int length = 3;
+        for (int j = 0; j < 4; j++) {
+            char c = encoded[i+j];
+            int value = values[(unsigned char) c];
+            if (c == '=' && i+4 == encoded.size() && j >= 2) {
+                value = 0;
+                length = min(length, j-1);
+            }
+            else if (value == -1 || length < 3)
+                throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+            block = (block<<6) | value;
+        }
+        for (int j = 0; j < length; j++)
+            bytes += (char) ((block>>(16-8*j))&255);
+    }
+    return bytes;
+}
+
+/*
+ * A list of parameters may instead be stored as a table of the distinct combinations of values plus the index of
+ * each item's combination.  The node then has a "types" property giving the size of the table.  The table's columns
+ * come first, followed by the indices, which are 8, 16, or 32 bit unsigned integers depending on the number of
+ * types.  This is only used when it makes the data smaller.
+ */
+
+template <class T>
+static void appendIndices(string& bytes, const vector<int>& indices) {
+    appendArray(bytes, vector<T>(indices.begin(), indices.end()));
+}
+
+template <class T>
+static void extractIndices(const string& bytes, size_t& offset, int count, vector<int>& indices) {
+    vector<T> values;
+    extractArray(bytes, offset, count, values);
+    indices.assign(values.begin(), values.end());
+}
+
+static int getIndexSize(int numTypes) {
+    return (numTypes <= 256 ? 1 : (numTypes <= 65536 ? 2 : 4));
+}
+
+static void appendParameters(string& bytes, SerializationNode& node, const vector<double>& values1, const vector<double>& values2, const vector<double>& values3) {
+    // Identify the types by the bit patterns of the values, so that values like -0.0 are preserved exactly.
+
+    int count = values1.size();
+    map<array<long long, 3>, int> typeIndex;
+    vector<int> indices(count);
+    vector<double> types1, types2, types3;
+    for (int i = 0; i < count; i++) {
+        array<long long, 3> key;
+        memcpy(&key[0], &values1[i], sizeof(double));
+        memcpy(&key[1], &values2[i], sizeof(double));
+        memcpy(&key[2], &values3[i], sizeof(double));
+        auto type = typeIndex.find(key);
+        if (type == typeIndex.end()) {
+            type = typeIndex.insert(make_pair(key, (int) types1.size())).first;
+            types1.push_back(values1[i]);
+            types2.push_back(values2[i]);
+            types3.push_back(values3[i]);
+        }
+        indices[i] = type->second;
+    }
+    int numTypes = types1.size();
+    int indexSize = getIndexSize(numTypes);
+    if ((long long) numTypes*3*sizeof(double)+(long long) count*indexSize >= (long long) count*3*sizeof(double)) {
+        appendArray(bytes, values1);
+        appendArray(bytes, values2);
+        appendArray(bytes, values3);
+        return;
+    }
+    node.setIntProperty("types", numTypes);
+    appendArray(bytes, types1);
+    appendArray(bytes, types2);
+    appendArray(bytes, types3);
+    if (indexSize == 1)
+        appendIndices<unsigned char>(bytes, indices);
+    else if (indexSize == 2)
+        appendIndices<unsigned short>(bytes, indices);
+    else
+        appendIndices<int>(bytes, indices);
+}
+
+static void extractParameters(const string& bytes, size_t& offset, const SerializationNode& node, int count, vector<double>& values1, vector<double>& values2, vector<double>& values3) {
+    if (!node.hasProperty("types")) {
+        extractArray(bytes, offset, count, values1);
+        extractArray(bytes, offset, count, values2);
+        extractArray(bytes, offset, count, values3);
+        return;
+    }
+    int numTypes = node.getIntProperty("types");
+    if (numTypes < 0)
+        throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+    vector<double> types1, types2, types3;
+    extractArray(bytes, offset, numTypes, types1);
+    extractArray(bytes, offset, numTypes, types2);
+    extractArray(bytes, offset, numTypes, types3);
+    vector<int> indices;
+    int indexSize = getIndexSize(numTypes);
+    if (indexSize == 1)
+        extractIndices<unsigned char>(bytes, offset, count, indices);
+    else if (indexSize == 2)
+        extractIndices<unsigned short>(bytes, offset, count, indices);
+    else
+        extractIndices<int>(bytes, offset, count, indices);
+    values1.resize(count);
+    values2.resize(count);
+    values3.resize(count);
+    for (int i = 0; i < count; i++) {
+        int type = indices[i];
+        if (type < 0 || type >= numTypes)
+            throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+        values1[i] = types1[type];
+        values2[i] = types2[type];
+        values3[i] = types3[type];
+    }
+}
+
+static int getPackedData(const SerializationNode& node, string& bytes) {
+    int count = node.getIntProperty("count");
+    if (count < 0)
+        throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+    bytes = decodeBase64(node.getStringProperty("data"));
+    return count;
+}
+
+/**
+ * Offsets refer to global parameters by name.  The names are stored once each as child nodes, and each
+ * offset stores the index of its name.
+ */
+static void serializeOffsets(SerializationNode& node, const vector<string>& parameters, const vector<int>& indices,
+                             const vector<double>& chargeScales, const vector<double>& sigmaScales, const vector<double>& epsilonScales) {
+    map<string, int> nameIndex;
+    vector<int> parameterIndices(parameters.size());
+    for (int i = 0; i < (int) parameters.size(); i++) {
+        auto name = nameIndex.find(parameters[i]);
+        if (name == nameIndex.end()) {
+            name = nameIndex.insert(make_pair(parameters[i], (int) nameIndex.size())).first;
+            node.createChildNode("Parameter").setStringProperty("name", parameters[i]);
+        }
+        parameterIndices[i] = name->second;
+    }
+    string bytes;
+    appendArray(bytes, parameterIndices);
+    appendArray(bytes, indices);
+    appendArray(bytes, chargeScales);
+    appendArray(bytes, sigmaScales);
+    appendArray(bytes, epsilonScales);
+    node.setIntProperty("count", parameters.size());
+    node.setStringProperty("data", encodeBase64(bytes));
+}
+
+static void deserializeOffsets(const SerializationNode& node, vector<string>& parameters, vector<int>& indices,
+                               vector<double>& chargeScales, vector<double>& sigmaScales, vector<double>& epsilonScales) {
+    vector<string> names;
+    for (auto& parameter : node.getChildren())
+        names.push_back(parameter.getStringProperty("name"));
+    string bytes;
+    int count = getPackedData(node, bytes);
+    size_t offset = 0;
+    vector<int> parameterIndices;
+    extractArray(bytes, offset, count, parameterIndices);
+    extractArray(bytes, offset, count, indices);
+    extractArray(bytes, offset, count, chargeScales);
+    extractArray(bytes, offset, count, sigmaScales);
+    extractArray(bytes, offset, count, epsilonScales);
+    parameters.resize(count);
+    for (int i = 0; i < count; i++) {
+        if (parameterIndices[i] < 0 || parameterIndices[i] >= (int) names.size())
+            throw OpenMMException("NonbondedForceProxy: Invalid packed data");
+        parameters[i] = names[parameterIndices[i]];
+    }
+}
+
+NonbondedForceProxy::NonbondedForceProxy() : SerializationProxy("ExampleNonbondedForce") {
+}
+
+void NonbondedForceProxy::serializeSettings(const NonbondedForce& force, SerializationNode& node) {
+    node.setIntProperty("version", 5);
     node.setIntProperty("forceGroup", force.getForceGroup());
     node.setIntProperty("method", (int) force.getNonbondedMethod());
     node.setDoubleProperty("cutoff", force.getCutoffDistance());
@@ -53,6 +265,7 @@ void NonbondedForceProxy::serialize(const void* object, SerializationNode& node)
     node.setDoubleProperty("rfDielectric", force.getReactionFieldDielectric());
     node.setIntProperty("dispersionCorrection", force.getUseDispersionCorrection());
     node.setIntProperty("exceptionsUsePeriodic", force.getExceptionsUsePeriodicBoundaryConditions());
+    node.setBoolProperty("usePMETuning", force.getUsePMETuning());
     double alpha;
     int nx, ny, nz;
     force.getPMEParameters(alpha, nx, ny, nz);
@@ -69,83 +282,148 @@ void NonbondedForceProxy::serialize(const void* object, SerializationNode& node)
     SerializationNode& globalParams = node.createChildNode("GlobalParameters");
     for (int i = 0; i < force.getNumGlobalParameters(); i++)
         globalParams.createChildNode("Parameter").setStringProperty("name", force.getGlobalParameterName(i)).setDoubleProperty("default", force.getGlobalParameterDefaultValue(i));
-    SerializationNode& particleOffsets = node.createChildNode("ParticleOffsets");
-    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
-        int particle;
-        double chargeScale, sigmaScale, epsilonScale;
-        string parameter;
-        force.getParticleParameterOffset(i, parameter, particle, chargeScale, sigmaScale, epsilonScale);
-        particleOffsets.createChildNode("Offset").setStringProperty("parameter", parameter).setIntProperty("particle", particle).setDoubleProperty("q", chargeScale).setDoubleProperty("sig", sigmaScale).setDoubleProperty("eps", epsilonScale);
-    }
-    SerializationNode& exceptionOffsets = node.createChildNode("ExceptionOffsets");
-    for (int i = 0; i < force.getNumExceptionParameterOffsets(); i++) {
-        int exception;
-        double chargeProdScale, sigmaScale, epsilonScale;
-        string parameter;
-        force.getExceptionParameterOffset(i, parameter, exception, chargeProdScale, sigmaScale, epsilonScale);
-        exceptionOffsets.createChildNode("Offset").setStringProperty("parameter", parameter).setIntProperty("exception", exception).setDoubleProperty("q", chargeProdScale).setDoubleProperty("sig", sigmaScale).setDoubleProperty("eps", epsilonScale);
-    }
+    int numOffsets = force.getNumParticleParameterOffsets();
+    vector<string> parameters(numOffsets);
+    vector<int> indices(numOffsets);
+    vector<double> chargeScales(numOffsets), sigmaScales(numOffsets), epsilonScales(numOffsets);
+    for (int i = 0; i < numOffsets; i++)
+        force.getParticleParameterOffset(i, parameters[i], indices[i], chargeScales[i], sigmaScales[i], epsilonScales[i]);
+    serializeOffsets(node.createChildNode("ParticleOffsets"), parameters, indices, chargeScales, sigmaScales, epsilonScales);
+    numOffsets = force.getNumExceptionParameterOffsets();
+    parameters.resize(numOffsets);
+    indices.resize(numOffsets);
+    chargeScales.resize(numOffsets);
+    sigmaScales.resize(numOffsets);
+    epsilonScales.resize(numOffsets);
+    for (int i = 0; i < numOffsets; i++)
+        force.getExceptionParameterOffset(i, parameters[i], indices[i], chargeScales[i], sigmaScales[i], epsilonScales[i]);
+    serializeOffsets(node.createChildNode("ExceptionOffsets"), parameters, indices, chargeScales, sigmaScales, epsilonScales);
+}
+
+void NonbondedForceProxy::serialize(const void* object, SerializationNode& node) const {
+    const NonbondedForce& force = *reinterpret_cast<const NonbondedForce*>(object);
+    serializeSettings(force, node);
+    vector<double> charges, sigmas, epsilons;
+    force.getParticleParameters(0, force.getNumParticles(), charges, sigmas, epsilons);
+    string bytes;
     SerializationNode& particles = node.createChildNode("Particles");
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge, sigma, epsilon;
-        force.getParticleParameters(i, charge, sigma, epsilon);
-        particles.createChildNode("Particle").setDoubleProperty("q", charge).setDoubleProperty("sig", sigma).setDoubleProperty("eps", epsilon);
-    }
+    appendParameters(bytes, particles, charges, sigmas, epsilons);
+    particles.setIntProperty("count", charges.size()).setStringProperty("data", encodeBase64(bytes));
+    vector<int> particles1, particles2;
+    vector<double> chargeProds;
+    force.getExceptionParameters(0, force.getNumExceptions(), particles1, particles2, chargeProds, sigmas, epsilons);
+    bytes.clear();
     SerializationNode& exceptions = node.createChildNode("Exceptions");
-    for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        exceptions.createChildNode("Exception").setIntProperty("p1", particle1).setIntProperty("p2", particle2).setDoubleProperty("q", chargeProd).setDoubleProperty("sig", sigma).setDoubleProperty("eps", epsilon);
-    }
+    appendArray(bytes, particles1);
+    appendArray(bytes, particles2);
+    appendParameters(bytes, exceptions, chargeProds, sigmas, epsilons);
+    exceptions.setIntProperty("count", particles1.size()).setStringProperty("data", encodeBase64(bytes));
 }
 
-void* NonbondedForceProxy::deserialize(const SerializationNode& node) const {
+int NonbondedForceProxy::deserializeSettings(const SerializationNode& node, NonbondedForce& force) {
     int version = node.getIntProperty("version");
-    if (version < 1 || version > 4)
+    if (version < 1 || version > 5)
         throw OpenMMException("Unsupported version number");
-    NonbondedForce* force = new NonbondedForce();
-    try {
-        force->setForceGroup(node.getIntProperty("forceGroup", 0));
-        force->setNonbondedMethod((NonbondedForce::NonbondedMethod) node.getIntProperty("method"));
-        force->setCutoffDistance(node.getDoubleProperty("cutoff"));
-        force->setUseSwitchingFunction(node.getBoolProperty("useSwitchingFunction", false));
-        force->setSwitchingDistance(node.getDoubleProperty("switchingDistance", -1.0));
-        force->setEwaldErrorTolerance(node.getDoubleProperty("ewaldTolerance"));
-        force->setReactionFieldDielectric(node.getDoubleProperty("rfDielectric"));
-        force->setUseDispersionCorrection(node.getIntProperty("dispersionCorrection"));
-        double alpha = node.getDoubleProperty("alpha", 0.0);
-        int nx = node.getIntProperty("nx", 0);
-        int ny = node.getIntProperty("ny", 0);
-        int nz = node.getIntProperty("nz", 0);
-        force->setPMEParameters(alpha, nx, ny, nz);
-        if (version >= 2) {
-            alpha = node.getDoubleProperty("ljAlpha", 0.0);
-            nx = node.getIntProperty("ljnx", 0);
-            ny = node.getIntProperty("ljny", 0);
-            nz = node.getIntProperty("ljnz", 0);
-            force->setLJPMEParameters(alpha, nx, ny, nz);
+    force.setForceGroup(node.getIntProperty("forceGroup", 0));
+    force.setNonbondedMethod((NonbondedForce::NonbondedMethod) node.getIntProperty("method"));
+    force.setCutoffDistance(node.getDoubleProperty("cutoff"));
+    force.setUseSwitchingFunction(node.getBoolProperty("useSwitchingFunction", false));
+    force.setSwitchingDistance(node.getDoubleProperty("switchingDistance", -1.0));
+    force.setEwaldErrorTolerance(node.getDoubleProperty("ewaldTolerance"));
+    force.setReactionFieldDielectric(node.getDoubleProperty("rfDielectric"));
+    force.setUseDispersionCorrection(node.getIntProperty("dispersionCorrection"));
+    double alpha = node.getDoubleProperty("alpha", 0.0);
+    int nx = node.getIntProperty("nx", 0);
+    int ny = node.getIntProperty("ny", 0);
+    int nz = node.getIntProperty("nz", 0);
+    force.setPMEParameters(alpha, nx, ny, nz);
+    if (version >= 2) {
+        alpha = node.getDoubleProperty("ljAlpha", 0.0);
+        nx = node.getIntProperty("ljnx", 0);
+        ny = node.getIntProperty("ljny", 0);
+        nz = node.getIntProperty("ljnz", 0);
+        force.setLJPMEParameters(alpha, nx, ny, nz);
+    }
+    force.setReciprocalSpaceForceGroup(node.getIntProperty("recipForceGroup", -1));
+    if (version >= 3) {
+        const SerializationNode& globalParams = node.getChildNode("GlobalParameters");
+        for (auto& parameter : globalParams.getChildren())
+            force.addGlobalParameter(parameter.getStringProperty("name"), parameter.getDoubleProperty("default"));
+        const SerializationNode& particleOffsets = node.getChildNode("ParticleOffsets");
+        const SerializationNode& exceptionOffsets = node.getChildNode("ExceptionOffsets");
+        if (version >= 5) {
+            vector<string> parameters;
+            vector<int> indices;
+            vector<double> chargeScales, sigmaScales, epsilonScales;
+            deserializeOffsets(particleOffsets, parameters, indices, chargeScales, sigmaScales, epsilonScales);
+            for (int i = 0; i < (int) parameters.size(); i++)
+                force.addParticleParameterOffset(parameters[i], indices[i], chargeScales[i], sigmaScales[i], epsilonScales[i]);
+            deserializeOffsets(exceptionOffsets, parameters, indices, chargeScales, sigmaScales, epsilonScales);
+            for (int i = 0; i < (int) parameters.size(); i++)
+                force.addExceptionParameterOffset(parameters[i], indices[i], chargeScales[i], sigmaScales[i], epsilonScales[i]);
         }
-        force->setReciprocalSpaceForceGroup(node.getIntProperty("recipForceGroup", -1));
-        if (version >= 3) {
-            const SerializationNode& globalParams = node.getChildNode("GlobalParameters");
-            for (auto& parameter : globalParams.getChildren())
-                force->addGlobalParameter(parameter.getStringProperty("name"), parameter.getDoubleProperty("default"));
-            const SerializationNode& particleOffsets = node.getChildNode("ParticleOffsets");
+        else {
             for (auto& offset : particleOffsets.getChildren())
-                force->addParticleParameterOffset(offset.getStringProperty("parameter"), offset.getIntProperty("particle"), offset.getDoubleProperty("q"), offset.getDoubleProperty("sig"), offset.getDoubleProperty("eps"));
-            const SerializationNode& exceptionOffsets = node.getChildNode("ExceptionOffsets");
+                force.addParticleParameterOffset(offset.getStringProperty("parameter"), offset.getIntProperty("particle"), offset.getDoubleProperty("q"), offset.getDoubleProperty("sig"), offset.getDoubleProperty("eps"));
             for (auto& offset : exceptionOffsets.getChildren())
-                force->addExceptionParameterOffset(offset.getStringProperty("parameter"), offset.getIntProperty("exception"), offset.getDoubleProperty("q"), offset.getDoubleProperty("sig"), offset.getDoubleProperty("eps"));
+                force.addExceptionParameterOffset(offset.getStringProperty("parameter"), offset.getIntProperty("exception"), offset.getDoubleProperty("q"), offset.getDoubleProperty("sig"), offset.getDoubleProperty("eps"));
         }
-        if (version >= 4)
-            force->setExceptionsUsePeriodicBoundaryConditions(node.getIntProperty("exceptionsUsePeriodic"));
+    }
+    if (version >= 4)
+        force.setExceptionsUsePeriodicBoundaryConditions(node.getIntProperty("exceptionsUsePeriodic"));
+    if (version >= 5)
+        force.setUsePMETuning(node.getBoolProperty("usePMETuning"));
+    return version;
+}
+
+void* NonbondedForceProxy::deserialize(const SerializationNode& node) const {
+    NonbondedForce* force = new NonbondedForce();
+    try {
+        int version = deserializeSettings(node, *force);
         const SerializationNode& particles = node.getChildNode("Particles");
-        for (auto& particle : particles.getChildren())
-            force->addParticle(particle.getDoubleProperty("q"), particle.getDoubleProperty("sig"), particle.getDoubleProperty("eps"));
         const SerializationNode& exceptions = node.getChildNode("Exceptions");
-        for (auto& exception : exceptions.getChildren())
-            force->addException(exception.getIntProperty("p1"), exception.getIntProperty("p2"), exception.getDoubleProperty("q"), exception.getDoubleProperty("sig"), exception.getDoubleProperty("eps"));
+        vector<double> charges, sigmas, epsilons;
+        vector<int> particles1, particles2;
+        vector<double> chargeProds;
+        if (version >= 5) {
+            string bytes;
+            int numParticles = getPackedData(particles, bytes);
+            size_t offset = 0;
+            extractParameters(bytes, offset, particles, numParticles, charges, sigmas, epsilons);
+            force->addParticles(charges, sigmas, epsilons);
+            int numExceptions = getPackedData(exceptions, bytes);
+            offset = 0;
+            extractArray(bytes, offset, numExceptions, particles1);
+            extractArray(bytes, offset, numExceptions, particles2);
+            extractParameters(bytes, offset, exceptions, numExceptions, chargeProds, sigmas, epsilons);
+        }
+        else {
+            charges.reserve(particles.getChildren().size());
+            sigmas.reserve(particles.getChildren().size());
+            epsilons.reserve(particles.getChildren().size());
+            for (auto& particle : particles.getChildren()) {
+                charges.push_back(particle.getDoubleProperty("q"));
+                sigmas.push_back(particle.getDoubleProperty("sig"));
+                epsilons.push_back(particle.getDoubleProperty("eps"));
+            }
+            force->addParticles(charges, sigmas, epsilons);
+            int numExceptions = exceptions.getChildren().size();
+            particles1.reserve(numExceptions);
+            particles2.reserve(numExceptions);
+            chargeProds.reserve(numExceptions);
+            sigmas.clear();
+            sigmas.reserve(numExceptions);
+            epsilons.clear();
+            epsilons.reserve(numExceptions);
+            for (auto& exception : exceptions.getChildren()) {
+                particles1.push_back(exception.getIntProperty("p1"));
+                particles2.push_back(exception.getIntProperty("p2"));
+                chargeProds.push_back(exception.getDoubleProperty("q"));
+                sigmas.push_back(exception.getDoubleProperty("sig"));
+                epsilons.push_back(exception.getDoubleProperty("eps"));
+            }
+        }
+        force->addExceptions(particles1, particles2, chargeProds, sigmas, epsilons);
     }
     catch (...) {
         delete force;
@@ -0,0 +1,83 @@
+#ifndef OPENMM_EXAMPLE_PACKEDARRAYS_H_
+#define OPENMM_EXAMPLE_PACKEDARRAYS_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2010-2020 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ExamplePlugin {
+
+/*
+ * These functions convert arrays of numbers to and from packed little endian binary data, which is used by the
+ * serialization proxies and the StreamSerializer.  Integers are always stored as 32 bits.
+ */
+
+static_assert(sizeof(int) == 4, "Packed arrays assume 32 bit integers");
+
+inline bool isLittleEndian() {
+    const int one = 1;
+    return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+template <class T>
+void appendArray(std::string& bytes, const std::vector<T>& values) {
+    size_t start = bytes.size();
+    bytes.resize(start+values.size()*sizeof(T));
+    if (values.size() > 0)
+        std::memcpy(&bytes[start], values.data(), values.size()*sizeof(T));
+    if (!isLittleEndian())
+        for (size_t i = start; i < bytes.size(); i += sizeof(T))
+            std::reverse(bytes.begin()+i, bytes.begin()+i+sizeof(T));
+}
+
+template <class T>
+void extractArray(const std::string& bytes, size_t& offset, int count, std::vector<T>& values) {
+    if (bytes.size()-offset < count*sizeof(T))
+        throw OpenMM::OpenMMException("Serialized data is too short");
+    values.resize(count);
+    if (count > 0)
+        std::memcpy(values.data(), &bytes[offset], count*sizeof(T));
+    if (!isLittleEndian())
+        for (T& value : values) {
+            char* valueBytes = reinterpret_cast<char*>(&value);
+            std::reverse(valueBytes, valueBytes+sizeof(T));
+        }
+    offset += count*sizeof(T);
+}
+
+} // namespace ExamplePlugin
+
+#endif /*OPENMM_EXAMPLE_PACKEDARRAYS_H_*/
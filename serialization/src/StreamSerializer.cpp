@@ -0,0 +1,547 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2010-2020 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+
+#include "StreamSerializer.h"
+#include "NonbondedForceProxy.h"
+#include "PackedArrays.h"
+#include "internal/NonbondedForceImpl.h"
+#include "openmm/serialization/SerializationNode.h"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <set>
+
+using namespace ExamplePlugin;
+using namespace OpenMM;
+using namespace std;
+
+/*
+ * A stream begins with a magic string and a format version, followed by the type name of the force and a
+ * SerializationNode holding its settings.  Then come the lists of items, each one a series of chunks.  A chunk
+ * is a 32 bit count followed by one packed array per field, and a list ends with a chunk whose count is 0.
+ */
+
+static const char Magic[] = "OMMXSTRM";
+static const char PatchMagic[] = "OMMXPTCH";
+static const int FormatVersion = 1;
+
+static void writeBytes(ostream& stream, const string& bytes) {
+    stream.write(bytes.data(), bytes.size());
+    if (!stream)
+        throw OpenMMException("StreamSerializer: Failed to write to stream");
+}
+
+static void readBytes(istream& stream, size_t size, string& bytes) {
+    // Sizes come from the stream itself, so read in blocks rather than allocating the whole size up front.  A
+    // corrupt size then fails at the end of the stream instead of trying to allocate an enormous buffer.
+
+    const size_t BlockSize = 1<<20;
+    bytes.clear();
+    while (bytes.size() < size) {
+        size_t start = bytes.size();
+        size_t length = min(BlockSize, size-start);
+        bytes.resize(start+length);
+        stream.read(&bytes[start], length);
+        if (!stream)
+            throw OpenMMException("StreamSerializer: Unexpected end of stream");
+    }
+    if (!stream)
+        throw OpenMMException("StreamSerializer: Unexpected end of stream");
+}
+
+static void writeInt(ostream& stream, int value) {
+    string bytes;
+    appendArray(bytes, vector<int>(1, value));
+    writeBytes(stream, bytes);
+}
+
+static int readInt(istream& stream) {
+    string bytes;
+    readBytes(stream, sizeof(int), bytes);
+    size_t offset = 0;
+    vector<int> value;
+    extractArray(bytes, offset, 1, value);
+    return value[0];
+}
+
+static void writeString(ostream& stream, const string& value) {
+    writeInt(stream, value.size());
+    writeBytes(stream, value);
+}
+
+static string readString(istream& stream) {
+    int length = readInt(stream);
+    if (length < 0)
+        throw OpenMMException("StreamSerializer: Invalid data in stream");
+    string value;
+    readBytes(stream, length, value);
+    return value;
+}
+
+static void writeNode(ostream& stream, const SerializationNode& node) {
+    writeString(stream, node.getName());
+    writeInt(stream, node.getProperties().size());
+    for (auto& property : node.getProperties()) {
+        writeString(stream, property.first);
+        writeString(stream, property.second);
+    }
+    writeInt(stream, node.getChildren().size());
+    for (auto& child : node.getChildren())
+        writeNode(stream, child);
+}
+
+static void readNode(istream& stream, SerializationNode& node) {
+    node.setName(readString(stream));
+    int numProperties = readInt(stream);
+    for (int i = 0; i < numProperties; i++) {
+        string name = readString(stream);
+        node.setStringProperty(name, readString(stream));
+    }
+    int numChildren = readInt(stream);
+    for (int i = 0; i < numChildren; i++)
+        readNode(stream, node.createChildNode(""));
+}
+
+/**
+ * Read the count at the start of a chunk, followed by the chunk's data, which holds the given number of bytes
+ * for each item.
+ */
+static int readChunk(istream& stream, size_t itemSize, string& bytes) {
+    int count = readInt(stream);
+    if (count < 0)
+        throw OpenMMException("StreamSerializer: Invalid data in stream");
+    readBytes(stream, count*itemSize, bytes);
+    return count;
+}
+
+static void writeHeader(ostream& stream, const string& type, const SerializationNode& settings) {
+    writeBytes(stream, string(Magic, 8));
+    writeInt(stream, FormatVersion);
+    writeString(stream, type);
+    writeNode(stream, settings);
+}
+
+void StreamSerializer::serialize(const NonbondedForce& force, ostream& stream, int chunkSize) {
+    if (chunkSize <= 0)
+        throw OpenMMException("StreamSerializer: The chunk size must be positive");
+    SerializationNode settings;
+    settings.setName("Settings");
+    NonbondedForceProxy::serializeSettings(force, settings);
+    writeHeader(stream, "ExampleNonbondedForce", settings);
+    vector<double> charges, sigmas, epsilons;
+    string bytes;
+    for (int start = 0; start < force.getNumParticles(); start += chunkSize) {
+        int count = min(chunkSize, force.getNumParticles()-start);
+        force.getParticleParameters(start, count, charges, sigmas, epsilons);
+        bytes.clear();
+        appendArray(bytes, vector<int>(1, count));
+        appendArray(bytes, charges);
+        appendArray(bytes, sigmas);
+        appendArray(bytes, epsilons);
+        writeBytes(stream, bytes);
+    }
+    writeInt(stream, 0);
+    vector<int> particles1, particles2;
+    vector<double> chargeProds;
+    for (int start = 0; start < force.getNumExceptions(); start += chunkSize) {
+        int count = min(chunkSize, force.getNumExceptions()-start);
+        force.getExceptionParameters(start, count, particles1, particles2, chargeProds, sigmas, epsilons);
+        bytes.clear();
+        appendArray(bytes, vector<int>(1, count));
+        appendArray(bytes, particles1);
+        appendArray(bytes, particles2);
+        appendArray(bytes, chargeProds);
+        appendArray(bytes, sigmas);
+        appendArray(bytes, epsilons);
+        writeBytes(stream, bytes);
+    }
+    writeInt(stream, 0);
+}
+
+void StreamSerializer::serialize(const ExampleForce& force, ostream& stream, int chunkSize) {
+    if (chunkSize <= 0)
+        throw OpenMMException("StreamSerializer: The chunk size must be positive");
+    SerializationNode settings;
+    settings.setName("Settings");
+    settings.setIntProperty("version", 1);
+    settings.setIntProperty("forceGroup", force.getForceGroup());
+    writeHeader(stream, "ExampleForce", settings);
+    vector<int> particles1, particles2;
+    vector<double> lengths, ks;
+    string bytes;
+    for (int start = 0; start < force.getNumBonds(); start += chunkSize) {
+        int count = min(chunkSize, force.getNumBonds()-start);
+        particles1.resize(count);
+        particles2.resize(count);
+        lengths.resize(count);
+        ks.resize(count);
+        for (int i = 0; i < count; i++)
+            force.getBondParameters(start+i, particles1[i], particles2[i], lengths[i], ks[i]);
+        bytes.clear();
+        appendArray(bytes, vector<int>(1, count));
+        appendArray(bytes, particles1);
+        appendArray(bytes, particles2);
+        appendArray(bytes, lengths);
+        appendArray(bytes, ks);
+        writeBytes(stream, bytes);
+    }
+    writeInt(stream, 0);
+}
+
+static NonbondedForce* deserializeNonbondedForce(istream& stream, const SerializationNode& settings) {
+    NonbondedForce* force = new NonbondedForce();
+    try {
+        NonbondedForceProxy::deserializeSettings(settings, *force);
+        vector<double> charges, sigmas, epsilons;
+        string bytes;
+        while (true) {
+            int count = readChunk(stream, 3*sizeof(double), bytes);
+            if (count == 0)
+                break;
+            size_t offset = 0;
+            extractArray(bytes, offset, count, charges);
+            extractArray(bytes, offset, count, sigmas);
+            extractArray(bytes, offset, count, epsilons);
+            force->addParticles(charges, sigmas, epsilons);
+        }
+        vector<int> particles1, particles2;
+        vector<double> chargeProds;
+        while (true) {
+            int count = readChunk(stream, 2*sizeof(int)+3*sizeof(double), bytes);
+            if (count == 0)
+                break;
+            size_t offset = 0;
+            extractArray(bytes, offset, count, particles1);
+            extractArray(bytes, offset, count, particles2);
+            extractArray(bytes, offset, count, chargeProds);
+            extractArray(bytes, offset, count, sigmas);
+            extractArray(bytes, offset, count, epsilons);
+            force->addExceptions(particles1, particles2, chargeProds, sigmas, epsilons);
+        }
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
+
+static ExampleForce* deserializeExampleForce(istream& stream, const SerializationNode& settings) {
+    if (settings.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    ExampleForce* force = new ExampleForce();
+    try {
+        force->setForceGroup(settings.getIntProperty("forceGroup", 0));
+        vector<int> particles1, particles2;
+        vector<double> lengths, ks;
+        string bytes;
+        while (true) {
+            int count = readChunk(stream, 2*sizeof(int)+2*sizeof(double), bytes);
+            if (count == 0)
+                break;
+            size_t offset = 0;
+            extractArray(bytes, offset, count, particles1);
+            extractArray(bytes, offset, count, particles2);
+            extractArray(bytes, offset, count, lengths);
+            extractArray(bytes, offset, count, ks);
+            for (int i = 0; i < count; i++)
+                force->addBond(particles1[i], particles2[i], lengths[i], ks[i]);
+        }
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
+
+Force* StreamSerializer::deserialize(istream& stream) {
+    string magic;
+    readBytes(stream, 8, magic);
+    if (magic != string(Magic, 8))
+        throw OpenMMException("StreamSerializer: The stream does not contain a serialized force");
+    if (readInt(stream) != FormatVersion)
+        throw OpenMMException("StreamSerializer: Unsupported format version");
+    string type = readString(stream);
+    SerializationNode settings;
+    readNode(stream, settings);
+    if (type == "ExampleNonbondedForce")
+        return deserializeNonbondedForce(stream, settings);
+    if (type == "ExampleForce")
+        return deserializeExampleForce(stream, settings);
+    throw OpenMMException("StreamSerializer: Unknown force type: "+type);
+}
+
+/*
+ * A patch begins with a magic string, the format version, and the hash of the base force.  It then contains
+ * one chunk each for the changed global parameter defaults, particles, exceptions, particle offsets, and
+ * exception offsets, in that order.  Each item in a chunk starts with the index of the thing it modifies.  The
+ * chunks for offsets are followed by the names of their global parameters.  Exceptions always keep their
+ * particles, so only their parameters are stored.
+ */
+
+static bool differ(double value1, double value2) {
+    // Compare bit patterns, so that even a change from 0.0 to -0.0 is included in the patch.
+
+    return memcmp(&value1, &value2, sizeof(double)) != 0;
+}
+
+template <class T>
+static void appendValue(string& bytes, T value) {
+    appendArray(bytes, vector<T>(1, value));
+}
+
+struct OffsetChanges {
+    vector<int> offsets, indices;
+    vector<double> scales1, scales2, scales3;
+    vector<string> parameters;
+    void add(int offset, const string& parameter, int index, double scale1, double scale2, double scale3) {
+        offsets.push_back(offset);
+        parameters.push_back(parameter);
+        indices.push_back(index);
+        scales1.push_back(scale1);
+        scales2.push_back(scale2);
+        scales3.push_back(scale3);
+    }
+};
+
+static void writeOffsetChanges(ostream& stream, const OffsetChanges& changes) {
+    string bytes;
+    appendValue<int>(bytes, changes.offsets.size());
+    appendArray(bytes, changes.offsets);
+    appendArray(bytes, changes.indices);
+    appendArray(bytes, changes.scales1);
+    appendArray(bytes, changes.scales2);
+    appendArray(bytes, changes.scales3);
+    writeBytes(stream, bytes);
+    for (const string& parameter : changes.parameters)
+        writeString(stream, parameter);
+}
+
+static void readOffsetChanges(istream& stream, int numOffsets, OffsetChanges& changes) {
+    string bytes;
+    int count = readChunk(stream, 2*sizeof(int)+3*sizeof(double), bytes);
+    size_t offset = 0;
+    extractArray(bytes, offset, count, changes.offsets);
+    extractArray(bytes, offset, count, changes.indices);
+    extractArray(bytes, offset, count, changes.scales1);
+    extractArray(bytes, offset, count, changes.scales2);
+    extractArray(bytes, offset, count, changes.scales3);
+    changes.parameters.resize(count);
+    for (int i = 0; i < count; i++) {
+        changes.parameters[i] = readString(stream);
+        if (changes.offsets[i] < 0 || changes.offsets[i] >= numOffsets)
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+    }
+}
+
+void StreamSerializer::serializePatch(const NonbondedForce& base, const NonbondedForce& target, ostream& stream) {
+    if (NonbondedForceImpl::computeHash(base, false) != NonbondedForceImpl::computeHash(target, false))
+        throw OpenMMException("StreamSerializer: A patch can only change parameters.  All other settings of the two forces must be identical.");
+    string bytes(PatchMagic, 8);
+    appendValue<int>(bytes, FormatVersion);
+    appendValue<long long>(bytes, NonbondedForceImpl::computeHash(base));
+
+    // Global parameter default values.
+
+    vector<int> indices;
+    vector<double> values;
+    for (int i = 0; i < base.getNumGlobalParameters(); i++)
+        if (differ(base.getGlobalParameterDefaultValue(i), target.getGlobalParameterDefaultValue(i))) {
+            indices.push_back(i);
+            values.push_back(target.getGlobalParameterDefaultValue(i));
+        }
+    appendValue<int>(bytes, indices.size());
+    appendArray(bytes, indices);
+    appendArray(bytes, values);
+
+    // Particles.
+
+    int numParticles = base.getNumParticles();
+    vector<double> charges1, sigmas1, epsilons1, charges2, sigmas2, epsilons2;
+    base.getParticleParameters(0, numParticles, charges1, sigmas1, epsilons1);
+    target.getParticleParameters(0, numParticles, charges2, sigmas2, epsilons2);
+    indices.clear();
+    vector<double> charges, sigmas, epsilons;
+    for (int i = 0; i < numParticles; i++)
+        if (differ(charges1[i], charges2[i]) || differ(sigmas1[i], sigmas2[i]) || differ(epsilons1[i], epsilons2[i])) {
+            indices.push_back(i);
+            charges.push_back(charges2[i]);
+            sigmas.push_back(sigmas2[i]);
+            epsilons.push_back(epsilons2[i]);
+        }
+    appendValue<int>(bytes, indices.size());
+    appendArray(bytes, indices);
+    appendArray(bytes, charges);
+    appendArray(bytes, sigmas);
+    appendArray(bytes, epsilons);
+
+    // Exceptions.
+
+    int numExceptions = base.getNumExceptions();
+    vector<int> particles11, particles21, particles12, particles22;
+    base.getExceptionParameters(0, numExceptions, particles11, particles21, charges1, sigmas1, epsilons1);
+    target.getExceptionParameters(0, numExceptions, particles12, particles22, charges2, sigmas2, epsilons2);
+    indices.clear();
+    charges.clear();
+    sigmas.clear();
+    epsilons.clear();
+    for (int i = 0; i < numExceptions; i++) {
+        if (particles11[i] != particles12[i] || particles21[i] != particles22[i])
+            throw OpenMMException("StreamSerializer: A patch cannot change which particles an exception applies to.");
+        if (differ(charges1[i], charges2[i]) || differ(sigmas1[i], sigmas2[i]) || differ(epsilons1[i], epsilons2[i])) {
+            indices.push_back(i);
+            charges.push_back(charges2[i]);
+            sigmas.push_back(sigmas2[i]);
+            epsilons.push_back(epsilons2[i]);
+        }
+    }
+    appendValue<int>(bytes, indices.size());
+    appendArray(bytes, indices);
+    appendArray(bytes, charges);
+    appendArray(bytes, sigmas);
+    appendArray(bytes, epsilons);
+    writeBytes(stream, bytes);
+
+    // Parameter offsets.
+
+    OffsetChanges particleOffsets, exceptionOffsets;
+    for (int i = 0; i < base.getNumParticleParameterOffsets(); i++) {
+        string parameter1, parameter2;
+        int index1, index2;
+        double scales1[3], scales2[3];
+        base.getParticleParameterOffset(i, parameter1, index1, scales1[0], scales1[1], scales1[2]);
+        target.getParticleParameterOffset(i, parameter2, index2, scales2[0], scales2[1], scales2[2]);
+        if (parameter1 != parameter2 || index1 != index2 || memcmp(scales1, scales2, sizeof(scales1)) != 0)
+            particleOffsets.add(i, parameter2, index2, scales2[0], scales2[1], scales2[2]);
+    }
+    for (int i = 0; i < base.getNumExceptionParameterOffsets(); i++) {
+        string parameter1, parameter2;
+        int index1, index2;
+        double scales1[3], scales2[3];
+        base.getExceptionParameterOffset(i, parameter1, index1, scales1[0], scales1[1], scales1[2]);
+        target.getExceptionParameterOffset(i, parameter2, index2, scales2[0], scales2[1], scales2[2]);
+        if (parameter1 != parameter2 || index1 != index2 || memcmp(scales1, scales2, sizeof(scales1)) != 0)
+            exceptionOffsets.add(i, parameter2, index2, scales2[0], scales2[1], scales2[2]);
+    }
+    writeOffsetChanges(stream, particleOffsets);
+    writeOffsetChanges(stream, exceptionOffsets);
+}
+
+void StreamSerializer::applyPatch(NonbondedForce& force, istream& stream, vector<int>& particles, vector<int>& exceptions) {
+    // Read the whole patch and check every index and name in it before modifying the force, so an invalid patch
+    // leaves it unchanged.
+
+    string bytes;
+    readBytes(stream, 8, bytes);
+    if (bytes != string(PatchMagic, 8))
+        throw OpenMMException("StreamSerializer: The stream does not contain a patch");
+    if (readInt(stream) != FormatVersion)
+        throw OpenMMException("StreamSerializer: Unsupported format version");
+    readBytes(stream, sizeof(long long), bytes);
+    size_t offset = 0;
+    vector<long long> baseHash;
+    extractArray(bytes, offset, 1, baseHash);
+    if ((unsigned long long) baseHash[0] != NonbondedForceImpl::computeHash(force))
+        throw OpenMMException("StreamSerializer: The patch was created for a different force");
+    vector<int> globalIndices;
+    vector<double> defaultValues;
+    int count = readChunk(stream, sizeof(int)+sizeof(double), bytes);
+    offset = 0;
+    extractArray(bytes, offset, count, globalIndices);
+    extractArray(bytes, offset, count, defaultValues);
+    vector<int> particleIndices;
+    vector<double> charges, sigmas, epsilons;
+    count = readChunk(stream, sizeof(int)+3*sizeof(double), bytes);
+    offset = 0;
+    extractArray(bytes, offset, count, particleIndices);
+    extractArray(bytes, offset, count, charges);
+    extractArray(bytes, offset, count, sigmas);
+    extractArray(bytes, offset, count, epsilons);
+    vector<int> exceptionIndices;
+    vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+    count = readChunk(stream, sizeof(int)+3*sizeof(double), bytes);
+    offset = 0;
+    extractArray(bytes, offset, count, exceptionIndices);
+    extractArray(bytes, offset, count, chargeProds);
+    extractArray(bytes, offset, count, exceptionSigmas);
+    extractArray(bytes, offset, count, exceptionEpsilons);
+    OffsetChanges particleOffsets, exceptionOffsets;
+    readOffsetChanges(stream, force.getNumParticleParameterOffsets(), particleOffsets);
+    readOffsetChanges(stream, force.getNumExceptionParameterOffsets(), exceptionOffsets);
+    for (int index : globalIndices)
+        if (index < 0 || index >= force.getNumGlobalParameters())
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+    for (int index : particleIndices)
+        if (index < 0 || index >= force.getNumParticles())
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+    for (int index : exceptionIndices)
+        if (index < 0 || index >= force.getNumExceptions())
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+    set<string> globalParameters;
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        globalParameters.insert(force.getGlobalParameterName(i));
+    for (int i = 0; i < (int) particleOffsets.offsets.size(); i++)
+        if (globalParameters.find(particleOffsets.parameters[i]) == globalParameters.end() ||
+                particleOffsets.indices[i] < 0 || particleOffsets.indices[i] >= force.getNumParticles())
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+    for (int i = 0; i < (int) exceptionOffsets.offsets.size(); i++)
+        if (globalParameters.find(exceptionOffsets.parameters[i]) == globalParameters.end() ||
+                exceptionOffsets.indices[i] < 0 || exceptionOffsets.indices[i] >= force.getNumExceptions())
+            throw OpenMMException("StreamSerializer: Invalid data in patch");
+
+    // Apply the changes.  Everything has been checked, so none of these calls can fail.
+
+    for (int i = 0; i < (int) globalIndices.size(); i++)
+        force.setGlobalParameterDefaultValue(globalIndices[i], defaultValues[i]);
+    for (int i = 0; i < (int) particleIndices.size(); i++)
+        force.setParticleParameters(particleIndices[i], charges[i], sigmas[i], epsilons[i]);
+    for (int i = 0; i < (int) exceptionIndices.size(); i++) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force.getExceptionParameters(exceptionIndices[i], particle1, particle2, chargeProd, sigma, epsilon);
+        force.setExceptionParameters(exceptionIndices[i], particle1, particle2, chargeProds[i], exceptionSigmas[i], exceptionEpsilons[i]);
+    }
+    for (int i = 0; i < (int) particleOffsets.offsets.size(); i++)
+        force.setParticleParameterOffset(particleOffsets.offsets[i], particleOffsets.parameters[i], particleOffsets.indices[i],
+                particleOffsets.scales1[i], particleOffsets.scales2[i], particleOffsets.scales3[i]);
+    for (int i = 0; i < (int) exceptionOffsets.offsets.size(); i++)
+        force.setExceptionParameterOffset(exceptionOffsets.offsets[i], exceptionOffsets.parameters[i], exceptionOffsets.indices[i],
+                exceptionOffsets.scales1[i], exceptionOffsets.scales2[i], exceptionOffsets.scales3[i]);
+    particles = particleIndices;
+    sort(particles.begin(), particles.end());
+    particles.erase(unique(particles.begin(), particles.end()), particles.end());
+    exceptions = exceptionIndices;
+    sort(exceptions.begin(), exceptions.end());
+    exceptions.erase(unique(exceptions.begin(), exceptions.end()), exceptions.end());
+}
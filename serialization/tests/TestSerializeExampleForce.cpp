@@ -30,6 +30,7 @@
  * -------------------------------------------------------------------------- */
 
 #include "ExampleForce.h"
+#include "StreamSerializer.h"
 #include "openmm/Platform.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "openmm/serialization/XmlSerializer.h"
@@ -73,10 +74,41 @@ void testSerialization() {
     }
 }
 
+void testStreamSerialization() {
+    // Create a Force with enough bonds to fill several chunks.
+
+    ExampleForce force;
+    force.setForceGroup(2);
+    for (int i = 0; i < 10; i++)
+        force.addBond(i, i+1, 0.1*i, 1.0/(i+1));
+
+    // Write it to a stream and read it back.
+
+    stringstream buffer;
+    StreamSerializer::serialize(force, buffer, 3);
+    ExampleForce* copy = dynamic_cast<ExampleForce*>(StreamSerializer::deserialize(buffer));
+    ASSERT(copy != NULL);
+    ExampleForce& force2 = *copy;
+    ASSERT_EQUAL(force.getForceGroup(), force2.getForceGroup());
+    ASSERT_EQUAL(force.getNumBonds(), force2.getNumBonds());
+    for (int i = 0; i < force.getNumBonds(); i++) {
+        int a1, a2, b1, b2;
+        double da, db, ka, kb;
+        force.getBondParameters(i, a1, a2, da, ka);
+        force2.getBondParameters(i, b1, b2, db, kb);
+        ASSERT_EQUAL(a1, b1);
+        ASSERT_EQUAL(a2, b2);
+        ASSERT_EQUAL(da, db);
+        ASSERT_EQUAL(ka, kb);
+    }
+    delete copy;
+}
+
 int main() {
     try {
         registerExampleSerializationProxies();
         testSerialization();
+        testStreamSerialization();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
@@ -29,15 +29,83 @@
  * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
  * -------------------------------------------------------------------------- */
 
+#include "NonbondedForce.h"
+#include "StreamSerializer.h"
 #include "openmm/internal/AssertionUtilities.h"
-#include "openmm/NonbondedForce.h"
 #include "openmm/serialization/XmlSerializer.h"
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
+using namespace ExamplePlugin;
 using namespace OpenMM;
 using namespace std;
 
+extern "C" void registerExampleSerializationProxies();
+
+/**
+ * Check that two forces have identical global parameters, particles, exceptions, and offsets.  Values are
+ * compared exactly, including the sign of zero.
+ */
+void compareParameters(const NonbondedForce& force1, const NonbondedForce& force2) {
+    ASSERT_EQUAL(force1.getNumGlobalParameters(), force2.getNumGlobalParameters());
+    for (int i = 0; i < force1.getNumGlobalParameters(); i++) {
+        ASSERT_EQUAL(force1.getGlobalParameterName(i), force2.getGlobalParameterName(i));
+        ASSERT_EQUAL(force1.getGlobalParameterDefaultValue(i), force2.getGlobalParameterDefaultValue(i));
+    }
+    ASSERT_EQUAL(force1.getNumParticles(), force2.getNumParticles());
+    vector<double> charges1, sigmas1, epsilons1, charges2, sigmas2, epsilons2;
+    force1.getParticleParameters(0, force1.getNumParticles(), charges1, sigmas1, epsilons1);
+    force2.getParticleParameters(0, force2.getNumParticles(), charges2, sigmas2, epsilons2);
+    for (int i = 0; i < force1.getNumParticles(); i++) {
+        ASSERT_EQUAL(charges1[i], charges2[i]);
+        ASSERT_EQUAL(signbit(charges1[i]), signbit(charges2[i]));
+        ASSERT_EQUAL(sigmas1[i], sigmas2[i]);
+        ASSERT_EQUAL(epsilons1[i], epsilons2[i]);
+    }
+    ASSERT_EQUAL(force1.getNumExceptions(), force2.getNumExceptions());
+    vector<int> particles11, particles21, particles12, particles22;
+    force1.getExceptionParameters(0, force1.getNumExceptions(), particles11, particles21, charges1, sigmas1, epsilons1);
+    force2.getExceptionParameters(0, force2.getNumExceptions(), particles12, particles22, charges2, sigmas2, epsilons2);
+    for (int i = 0; i < force1.getNumExceptions(); i++) {
+        ASSERT_EQUAL(particles11[i], particles12[i]);
+        ASSERT_EQUAL(particles21[i], particles22[i]);
+        ASSERT_EQUAL(charges1[i], charges2[i]);
+        ASSERT_EQUAL(signbit(charges1[i]), signbit(charges2[i]));
+        ASSERT_EQUAL(sigmas1[i], sigmas2[i]);
+        ASSERT_EQUAL(epsilons1[i], epsilons2[i]);
+    }
+    ASSERT_EQUAL(force1.getNumParticleParameterOffsets(), force2.getNumParticleParameterOffsets());
+    for (int i = 0; i < force1.getNumParticleParameterOffsets(); i++) {
+        int index1, index2;
+        string param1, param2;
+        double charge1, sigma1, epsilon1;
+        double charge2, sigma2, epsilon2;
+        force1.getParticleParameterOffset(i, param1, index1, charge1, sigma1, epsilon1);
+        force2.getParticleParameterOffset(i, param2, index2, charge2, sigma2, epsilon2);
+        ASSERT_EQUAL(index1, index2);
+        ASSERT_EQUAL(param1, param2);
+        ASSERT_EQUAL(charge1, charge2);
+        ASSERT_EQUAL(sigma1, sigma2);
+        ASSERT_EQUAL(epsilon1, epsilon2);
+    }
+    ASSERT_EQUAL(force1.getNumExceptionParameterOffsets(), force2.getNumExceptionParameterOffsets());
+    for (int i = 0; i < force1.getNumExceptionParameterOffsets(); i++) {
+        int index1, index2;
+        string param1, param2;
+        double charge1, sigma1, epsilon1;
+        double charge2, sigma2, epsilon2;
+        force1.getExceptionParameterOffset(i, param1, index1, charge1, sigma1, epsilon1);
+        force2.getExceptionParameterOffset(i, param2, index2, charge2, sigma2, epsilon2);
+        ASSERT_EQUAL(index1, index2);
+        ASSERT_EQUAL(param1, param2);
+        ASSERT_EQUAL(charge1, charge2);
+        ASSERT_EQUAL(sigma1, sigma2);
+        ASSERT_EQUAL(epsilon1, epsilon2);
+    }
+}
+
 void testSerialization() {
     // Create a Force.
 
@@ -51,6 +119,7 @@ void testSerialization() {
     force.setReactionFieldDielectric(50.0);
     force.setUseDispersionCorrection(false);
     force.setExceptionsUsePeriodicBoundaryConditions(true);
+    force.setUsePMETuning(true);
     double alpha = 0.5;
     int nx = 3, ny = 5, nz = 7;
     force.setPMEParameters(alpha, nx, ny, nz);
@@ -58,10 +127,9 @@ void testSerialization() {
     int dnx = 4, dny = 6, dnz = 7;
     force.setLJPMEParameters(dalpha, dnx, dny, dnz);
     force.addParticle(1, 0.1, 0.01);
-    force.addParticle(0.5, 0.2, 0.02);
-    force.addParticle(-0.5, 0.3, 0.03);
+    force.addParticles({0.5, -0.5}, {0.2, 0.3}, {0.02, 0.03});
     force.addException(0, 1, 2, 0.5, 0.1);
-    force.addException(1, 2, 0.2, 0.4, 0.2);
+    force.addExceptions({1}, {2}, {0.2}, {0.4}, {0.2});
     force.addGlobalParameter("scale1", 1.0);
     force.addGlobalParameter("scale2", 2.0);
     force.addParticleParameterOffset("scale1", 2, 1.5, 2.0, 2.5);
@@ -85,11 +153,7 @@ void testSerialization() {
     ASSERT_EQUAL(force.getReactionFieldDielectric(), force2.getReactionFieldDielectric());
     ASSERT_EQUAL(force.getUseDispersionCorrection(), force2.getUseDispersionCorrection());
     ASSERT_EQUAL(force.getExceptionsUsePeriodicBoundaryConditions(), force2.getExceptionsUsePeriodicBoundaryConditions());
-    ASSERT_EQUAL(force.getNumParticles(), force2.getNumParticles());
-    ASSERT_EQUAL(force.getNumExceptions(), force2.getNumExceptions());
-    ASSERT_EQUAL(force.getNumGlobalParameters(), force2.getNumGlobalParameters());
-    ASSERT_EQUAL(force.getNumParticleParameterOffsets(), force2.getNumParticleParameterOffsets());
-    ASSERT_EQUAL(force.getNumExceptionParameterOffsets(), force2.getNumExceptionParameterOffsets());
+    ASSERT_EQUAL(force.getUsePMETuning(), force2.getUsePMETuning());
     double alpha2;
     int nx2, ny2, nz2;
     force2.getPMEParameters(alpha2, nx2, ny2, nz2);
@@ -104,63 +168,310 @@ void testSerialization() {
     ASSERT_EQUAL(dnx, dnx2);
     ASSERT_EQUAL(dny, dny2);
     ASSERT_EQUAL(dnz, dnz2);
-    for (int i = 0; i < force.getNumGlobalParameters(); i++) {
-        ASSERT_EQUAL(force.getGlobalParameterName(i), force2.getGlobalParameterName(i));
-        ASSERT_EQUAL(force.getGlobalParameterDefaultValue(i), force2.getGlobalParameterDefaultValue(i));
+    compareParameters(force, force2);
+    delete copy;
+}
+
+void testPackedArrays() {
+    // Create a force whose parameters cannot be represented exactly in decimal.
+
+    const int numParticles = 1000;
+    NonbondedForce force;
+    vector<double> charges(numParticles), sigmas(numParticles), epsilons(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        charges[i] = (i%3 == 0 ? -0.0 : 1.0/(i+3));
+        sigmas[i] = 0.1+sqrt(i);
+        epsilons[i] = (i%7 == 0 ? 1e-310 : exp(-i*0.01));
     }
-    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
-        int index1, index2;
-        string param1, param2;
-        double charge1, sigma1, epsilon1;
-        double charge2, sigma2, epsilon2;
-        force.getParticleParameterOffset(i, param1, index1, charge1, sigma1, epsilon1);
-        force2.getParticleParameterOffset(i, param2, index2, charge2, sigma2, epsilon2);
-        ASSERT_EQUAL(index1, index1);
-        ASSERT_EQUAL(param1, param2);
-        ASSERT_EQUAL(charge1, charge2);
-        ASSERT_EQUAL(sigma1, sigma2);
-        ASSERT_EQUAL(epsilon1, epsilon2);
+    force.addParticles(charges, sigmas, epsilons);
+    vector<int> particles1, particles2;
+    vector<double> chargeProds;
+    for (int i = 1; i < numParticles; i++) {
+        particles1.push_back(i-1);
+        particles2.push_back(i);
+        chargeProds.push_back(charges[i-1]*charges[i]);
     }
-    for (int i = 0; i < force.getNumExceptionParameterOffsets(); i++) {
-        int index1, index2;
-        string param1, param2;
-        double charge1, sigma1, epsilon1;
-        double charge2, sigma2, epsilon2;
-        force.getExceptionParameterOffset(i, param1, index1, charge1, sigma1, epsilon1);
-        force2.getExceptionParameterOffset(i, param2, index2, charge2, sigma2, epsilon2);
-        ASSERT_EQUAL(index1, index1);
-        ASSERT_EQUAL(param1, param2);
-        ASSERT_EQUAL(charge1, charge2);
-        ASSERT_EQUAL(sigma1, sigma2);
-        ASSERT_EQUAL(epsilon1, epsilon2);
+    force.addExceptions(particles1, particles2, chargeProds, vector<double>(sigmas.begin()+1, sigmas.end()), vector<double>(epsilons.begin()+1, epsilons.end()));
+    force.addGlobalParameter("lambda", 0.5);
+    force.addGlobalParameter("mu", 0.0);
+    for (int i = 0; i < 10; i++) {
+        force.addParticleParameterOffset(i%2 == 0 ? "lambda" : "mu", i, 1.0/(i+1), 0.0, -0.5);
+        force.addExceptionParameterOffset("mu", 2*i, 0.25, 1.0/3.0, 0.0);
     }
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge1, sigma1, epsilon1;
-        double charge2, sigma2, epsilon2;
-        force.getParticleParameters(i, charge1, sigma1, epsilon1);
-        force2.getParticleParameters(i, charge2, sigma2, epsilon2);
-        ASSERT_EQUAL(charge1, charge2);
-        ASSERT_EQUAL(sigma1, sigma2);
-        ASSERT_EQUAL(epsilon1, epsilon2);
+
+    // The packed arrays should take much less space than one element per particle and exception.
+
+    stringstream buffer;
+    XmlSerializer::serialize<NonbondedForce>(&force, "Force", buffer);
+    ASSERT(buffer.str().size() < 50*(force.getNumParticles()+force.getNumExceptions()));
+    NonbondedForce* copy = XmlSerializer::deserialize<NonbondedForce>(buffer);
+
+    // Every value should be restored exactly.
+
+    compareParameters(force, *copy);
+    delete copy;
+}
+
+void testParameterTypes() {
+    // Create forces in which many particles and exceptions share the same parameters.  The second one has
+    // enough types to need 16 bit indices.
+
+    for (int numTypes : {3, 1000}) {
+        const int numParticles = 20000;
+        NonbondedForce force;
+        vector<double> charges(numParticles), sigmas(numParticles), epsilons(numParticles);
+        for (int i = 0; i < numParticles; i++) {
+            int type = (i*7)%numTypes;
+            charges[i] = (type == 0 ? -0.0 : 1.0/(type+3));
+            sigmas[i] = 0.1+sqrt(type);
+            epsilons[i] = exp(-type*0.01);
+        }
+        force.addParticles(charges, sigmas, epsilons);
+        vector<int> particles1, particles2;
+        vector<double> chargeProds, exceptionSigmas, exceptionEpsilons;
+        for (int i = 1; i < numParticles; i++) {
+            particles1.push_back(i-1);
+            particles2.push_back(i);
+            chargeProds.push_back(i%2 == 0 ? 0.0 : 0.5*charges[i-1]*charges[i]);
+            exceptionSigmas.push_back(i%2 == 0 ? 1.0 : 0.3);
+            exceptionEpsilons.push_back(i%2 == 0 ? 0.0 : 0.25);
+        }
+        force.addExceptions(particles1, particles2, chargeProds, exceptionSigmas, exceptionEpsilons);
+
+        // Storing the types should make the output much smaller than writing every value.
+
+        stringstream buffer;
+        XmlSerializer::serialize<NonbondedForce>(&force, "Force", buffer);
+        ASSERT(buffer.str().size() < 20*(force.getNumParticles()+force.getNumExceptions()));
+        NonbondedForce* copy = XmlSerializer::deserialize<NonbondedForce>(buffer);
+        compareParameters(force, *copy);
+        delete copy;
     }
-    ASSERT_EQUAL(force.getNumExceptions(), force2.getNumExceptions());
-    for (int i = 0; i < force.getNumExceptions(); i++) {
-        int a1, a2, b1, b2;
-        double charge1, sigma1, epsilon1;
-        double charge2, sigma2, epsilon2;
-        force.getExceptionParameters(i, a1, b1, charge1, sigma1, epsilon1);
-        force2.getExceptionParameters(i, a2, b2, charge2, sigma2, epsilon2);
-        ASSERT_EQUAL(a1, a2);
-        ASSERT_EQUAL(b1, b2);
-        ASSERT_EQUAL(charge1, charge2);
-        ASSERT_EQUAL(sigma1, sigma2);
-        ASSERT_EQUAL(epsilon1, epsilon2);
+}
+
+void testStreamSerialization() {
+    // Create a Force with enough particles and exceptions to fill several chunks.
+
+    NonbondedForce force;
+    force.setNonbondedMethod(NonbondedForce::PME);
+    force.setCutoffDistance(1.2);
+    force.setEwaldErrorTolerance(1e-4);
+    force.setUsePMETuning(true);
+    force.addGlobalParameter("lambda", 0.5);
+    for (int i = 0; i < 100; i++)
+        force.addParticle(i%2 == 0 ? 0.5 : -0.5, 0.1+0.01*i, 1.0/(i+1));
+    for (int i = 0; i < 99; i++)
+        force.addException(i, i+1, 0.1*i, 0.3, 0.2);
+    force.addParticleParameterOffset("lambda", 5, 0.5, 0.0, 0.0);
+    force.addExceptionParameterOffset("lambda", 7, 0.25, 0.0, 0.0);
+
+    // Write it to a stream and read it back.
+
+    stringstream buffer;
+    StreamSerializer::serialize(force, buffer, 16);
+    NonbondedForce* copy = dynamic_cast<NonbondedForce*>(StreamSerializer::deserialize(buffer));
+    ASSERT(copy != NULL);
+    NonbondedForce& force2 = *copy;
+    ASSERT_EQUAL(force.getNonbondedMethod(), force2.getNonbondedMethod());
+    ASSERT_EQUAL(force.getCutoffDistance(), force2.getCutoffDistance());
+    ASSERT_EQUAL(force.getEwaldErrorTolerance(), force2.getEwaldErrorTolerance());
+    ASSERT_EQUAL(force.getUsePMETuning(), force2.getUsePMETuning());
+    compareParameters(force, force2);
+    delete copy;
+
+    // A truncated stream should be rejected.
+
+    string data = buffer.str();
+    stringstream truncated(data.substr(0, data.size()-10));
+    bool threwException = false;
+    try {
+        delete StreamSerializer::deserialize(truncated);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+
+    // So should a stream whose first chunk claims to hold far more items than it does.  Find the chunk by
+    // serializing a force with the same settings but no particles or exceptions, which leaves only the header
+    // and two empty chunks.
+
+    stringstream emptyBuffer;
+    NonbondedForce settingsOnly;
+    settingsOnly.setNonbondedMethod(force.getNonbondedMethod());
+    settingsOnly.setCutoffDistance(force.getCutoffDistance());
+    settingsOnly.setEwaldErrorTolerance(force.getEwaldErrorTolerance());
+    settingsOnly.setUsePMETuning(force.getUsePMETuning());
+    settingsOnly.addGlobalParameter("lambda", 0.5);
+    settingsOnly.addParticleParameterOffset("lambda", 5, 0.5, 0.0, 0.0);
+    settingsOnly.addExceptionParameterOffset("lambda", 7, 0.25, 0.0, 0.0);
+    StreamSerializer::serialize(settingsOnly, emptyBuffer, 16);
+    size_t headerSize = emptyBuffer.str().size()-2*sizeof(int);
+    ASSERT(data.compare(0, headerSize, emptyBuffer.str(), 0, headerSize) == 0);
+    string corrupt = data;
+    corrupt[headerSize] = (char) 0xff;
+    corrupt[headerSize+1] = (char) 0xff;
+    corrupt[headerSize+2] = (char) 0xff;
+    corrupt[headerSize+3] = (char) 0x7f;
+    stringstream corruptStream(corrupt);
+    threwException = false;
+    try {
+        delete StreamSerializer::deserialize(corruptStream);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testPatch() {
+    NonbondedForce base;
+    base.setNonbondedMethod(NonbondedForce::PME);
+    base.addGlobalParameter("lambda", 0.5);
+    base.addGlobalParameter("mu", 1.0);
+    for (int i = 0; i < 50; i++)
+        base.addParticle(i%2 == 0 ? 0.5 : -0.5, 0.1+0.01*i, 1.0/(i+1));
+    for (int i = 0; i < 49; i++)
+        base.addException(i, i+1, 0.1*i, 0.3, 0.2);
+    base.addParticleParameterOffset("lambda", 5, 0.5, 0.0, 0.0);
+    base.addExceptionParameterOffset("lambda", 7, 0.25, 0.0, 0.0);
+
+    // Modify a few parameters and create a patch.
+
+    NonbondedForce target = base;
+    target.setGlobalParameterDefaultValue(1, 2.0);
+    target.setParticleParameters(30, -0.2, 0.3, 0.4);
+    target.setParticleParameters(10, 0.2, 0.3, 0.4);
+    target.setExceptionParameters(20, 20, 21, 0.0, 0.5, 0.0);
+    target.setExceptionParameterOffset(0, "mu", 8, 0.0, 0.1, 0.0);
+    stringstream buffer;
+    StreamSerializer::serializePatch(base, target, buffer);
+    string patch = buffer.str();
+
+    // Apply it and see if the result matches the target.
+
+    NonbondedForce force = base;
+    vector<int> particles, exceptions;
+    StreamSerializer::applyPatch(force, buffer, particles, exceptions);
+    ASSERT(particles == vector<int>({10, 30}));
+    ASSERT(exceptions == vector<int>({20}));
+    compareParameters(target, force);
+
+    // Applying the patch a second time should fail, since the force no longer matches the base.
+
+    stringstream buffer2(patch);
+    bool threwException = false;
+    try {
+        StreamSerializer::applyPatch(force, buffer2, particles, exceptions);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
     }
+    ASSERT(threwException);
+
+    // A patch that refers to a global parameter that does not exist, or an offset that refers to an exception that
+    // does not exist, should be rejected without modifying the force.  The patch ends with the changed exception
+    // offset: its index, the index of its exception, three scales, and the length and name of its parameter.
+
+    string badName = patch;
+    badName.replace(badName.size()-2, 2, "zz");
+    string badIndex = patch;
+    int exception = 1000;
+    memcpy(&badIndex[badIndex.size()-2-sizeof(int)-3*sizeof(double)-sizeof(int)], &exception, sizeof(int));
+    for (const string& badPatch : {badName, badIndex}) {
+        NonbondedForce force2 = base;
+        stringstream badBuffer(badPatch);
+        threwException = false;
+        try {
+            StreamSerializer::applyPatch(force2, badBuffer, particles, exceptions);
+        }
+        catch (const OpenMMException& ex) {
+            threwException = true;
+        }
+        ASSERT(threwException);
+        compareParameters(base, force2);
+    }
+
+    // Changing anything other than parameters should also fail.  That includes the particles of an exception.
+
+    target.setExceptionParameters(20, 20, 22, 0.0, 0.5, 0.0);
+    threwException = false;
+    try {
+        StreamSerializer::serializePatch(base, target, buffer);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    target.setExceptionParameters(20, 20, 21, 0.0, 0.5, 0.0);
+    target.setCutoffDistance(1.5);
+    threwException = false;
+    try {
+        StreamSerializer::serializePatch(base, target, buffer);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testChildNodeFormat() {
+    // Versions before 5 stored one child node per particle, exception, and offset.  Make sure such a document
+    // can still be read.
+
+    string xml =
+        "<Force type=\"ExampleNonbondedForce\" version=\"4\" forceGroup=\"2\" method=\"4\" cutoff=\"1.1\" switchingDistance=\"-1\" "
+        "ewaldTolerance=\"0.0005\" rfDielectric=\"78.3\" dispersionCorrection=\"1\" exceptionsUsePeriodic=\"1\" alpha=\"0\" nx=\"0\" "
+        "ny=\"0\" nz=\"0\" ljAlpha=\"0\" ljnx=\"0\" ljny=\"0\" ljnz=\"0\" recipForceGroup=\"-1\">\n"
+        "<GlobalParameters>\n"
+        "<Parameter name=\"lambda\" default=\"0.5\"/>\n"
+        "</GlobalParameters>\n"
+        "<ParticleOffsets>\n"
+        "<Offset parameter=\"lambda\" particle=\"2\" q=\"0.5\" sig=\"0\" eps=\"0.25\"/>\n"
+        "</ParticleOffsets>\n"
+        "<ExceptionOffsets>\n"
+        "<Offset parameter=\"lambda\" exception=\"1\" q=\"-0.1\" sig=\"0\" eps=\"0\"/>\n"
+        "</ExceptionOffsets>\n"
+        "<Particles>\n"
+        "<Particle q=\"0.5\" sig=\"0.3\" eps=\"0.2\"/>\n"
+        "<Particle q=\"-0.5\" sig=\"0.35\" eps=\"0.1\"/>\n"
+        "<Particle q=\"0.25\" sig=\"0.4\" eps=\"0.3\"/>\n"
+        "</Particles>\n"
+        "<Exceptions>\n"
+        "<Exception p1=\"0\" p2=\"1\" q=\"0\" sig=\"1\" eps=\"0\"/>\n"
+        "<Exception p1=\"1\" p2=\"2\" q=\"-0.0625\" sig=\"0.375\" eps=\"0.15\"/>\n"
+        "</Exceptions>\n"
+        "</Force>\n";
+    NonbondedForce expected;
+    expected.addGlobalParameter("lambda", 0.5);
+    expected.addParticle(0.5, 0.3, 0.2);
+    expected.addParticle(-0.5, 0.35, 0.1);
+    expected.addParticle(0.25, 0.4, 0.3);
+    expected.addException(0, 1, 0.0, 1.0, 0.0);
+    expected.addException(1, 2, -0.0625, 0.375, 0.15);
+    expected.addParticleParameterOffset("lambda", 2, 0.5, 0.0, 0.25);
+    expected.addExceptionParameterOffset("lambda", 1, -0.1, 0.0, 0.0);
+    stringstream buffer(xml);
+    NonbondedForce* force = XmlSerializer::deserialize<NonbondedForce>(buffer);
+    ASSERT_EQUAL(2, force->getForceGroup());
+    ASSERT_EQUAL(NonbondedForce::PME, force->getNonbondedMethod());
+    ASSERT_EQUAL(1.1, force->getCutoffDistance());
+    ASSERT_EQUAL(0.0005, force->getEwaldErrorTolerance());
+    ASSERT_EQUAL(true, force->getExceptionsUsePeriodicBoundaryConditions());
+    ASSERT_EQUAL(false, force->getUsePMETuning());
+    compareParameters(expected, *force);
+    delete force;
 }
 
 int main() {
     try {
+        registerExampleSerializationProxies();
         testSerialization();
+        testPackedArrays();
+        testParameterTypes();
+        testChildNodeFormat();
+        testStreamSerialization();
+        testPatch();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
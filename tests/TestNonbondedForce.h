@@ -29,19 +29,25 @@
  * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
  * -------------------------------------------------------------------------- */
 
+#include "NonbondedForce.h"
+#include "internal/NonbondedForceImpl.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "openmm/Context.h"
 #include "openmm/reference/ReferencePlatform.h"
 #include "openmm/HarmonicBondForce.h"
-#include "openmm/NonbondedForce.h"
 #include "openmm/System.h"
 #include "openmm/VerletIntegrator.h"
 #include "openmm/reference/SimTKOpenMMRealType.h"
 #include "sfmt/SFMT.h"
+#include <algorithm>
 #include <iostream>
+#include <functional>
 #include <iomanip>
+#include <map>
+#include <set>
 #include <vector>
 
+using namespace ExamplePlugin;
 using namespace OpenMM;
 using namespace std;
 
@@ -460,7 +466,7 @@ void testLargeSystem() {
     const double cutoff = 2.0;
     const double boxSize = 20.0;
     const double tol = 2e-3;
-    ReferencePlatform reference;
+    Platform& reference = Platform::getPlatformByName("Reference");
     System system;
     for (int i = 0; i < numParticles; i++)
         system.addParticle(1.0);
@@ -666,7 +672,7 @@ void testChangingParameters() {
     const double cutoff = 2.0;
     const double boxSize = 20.0;
     const double tol = 2e-3;
-    ReferencePlatform reference;
+    Platform& reference = Platform::getPlatformByName("Reference");
     System system;
     for (int i = 0; i < numParticles; i++)
         system.addParticle(1.0);
@@ -893,6 +899,516 @@ void testParameterOffsets() {
     ASSERT_EQUAL_TOL(energy, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
 }
 
+void testNeighborListUpdates(NonbondedForce::NonbondedMethod method) {
+    // Particles are placed on a jittered grid so none of them overlap.
+
+    const int gridSize = 6;
+    const int numParticles = gridSize*gridSize*gridSize;
+    const double spacing = 0.5;
+    double boxSize = gridSize*spacing;
+    System system;
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(method);
+    force->setCutoffDistance(1.0);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions;
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                int index = system.addParticle(1.0);
+                force->addParticle(index%2 == 0 ? 0.2 : -0.2, 0.2, 0.5);
+                positions.push_back(Vec3(i*spacing+0.1*genrand_real2(sfmt), j*spacing+0.1*genrand_real2(sfmt), k*spacing+0.1*genrand_real2(sfmt)));
+            }
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    system.addForce(force);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // A new Context has to build its neighbor list from scratch, so it gives the expected result.
+
+    auto checkAgainstNewContext = [&] () {
+        State state = context.getState(State::Forces | State::Energy);
+        VerletIntegrator integrator2(0.001);
+        Context context2(system, integrator2, platform);
+        context2.setPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+        context2.setPositions(positions);
+        State state2 = context2.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(state2.getPotentialEnergy(), state.getPotentialEnergy(), 1e-5);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state2.getForces()[i], state.getForces()[i], 1e-5);
+    };
+    auto displace = [&] (double distance, int stride) {
+        for (int i = 0; i < numParticles; i += stride) {
+            Vec3 direction(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5);
+            positions[i] += direction*(distance/sqrt(direction.dot(direction)));
+        }
+        context.setPositions(positions);
+    };
+    checkAgainstNewContext();
+
+    // The Reference platform uses a skin of 0.1 nm.  Moves smaller than half of it reuse the existing list,
+    // even when several of them add up.
+
+    displace(0.02, 1);
+    checkAgainstNewContext();
+    displace(0.02, 1);
+    checkAgainstNewContext();
+
+    // A larger move requires the list to be rebuilt.
+
+    displace(0.08, 7);
+    checkAgainstNewContext();
+    displace(0.01, 1);
+    checkAgainstNewContext();
+
+    // So does changing the periodic box.
+
+    if (method != NonbondedForce::CutoffNonPeriodic) {
+        double scale = 1.03;
+        boxSize *= scale;
+        for (Vec3& pos : positions)
+            pos *= scale;
+        context.setPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+        context.setPositions(positions);
+        checkAgainstNewContext();
+        displace(0.02, 1);
+        checkAgainstNewContext();
+    }
+}
+
+/**
+ * Compute the energy of a NonbondedForce with no cutoff directly from its definition, applying its parameter
+ * offsets with the specified values of the global parameters.
+ */
+double computeEnergyWithOffsets(const NonbondedForce& force, const vector<Vec3>& positions, const map<string, double>& values) {
+    int numParticles = force.getNumParticles();
+    vector<double> charge(numParticles), sigma(numParticles), epsilon(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        force.getParticleParameters(i, charge[i], sigma[i], epsilon[i]);
+    for (int i = 0; i < force.getNumParticleParameterOffsets(); i++) {
+        string param;
+        int particle;
+        double chargeScale, sigmaScale, epsilonScale;
+        force.getParticleParameterOffset(i, param, particle, chargeScale, sigmaScale, epsilonScale);
+        double value = values.at(param);
+        charge[particle] += value*chargeScale;
+        sigma[particle] += value*sigmaScale;
+        epsilon[particle] += value*epsilonScale;
+    }
+    int numExceptions = force.getNumExceptions();
+    vector<int> particle1(numExceptions), particle2(numExceptions);
+    vector<double> chargeProd(numExceptions), exceptionSigma(numExceptions), exceptionEpsilon(numExceptions);
+    for (int i = 0; i < numExceptions; i++)
+        force.getExceptionParameters(i, particle1[i], particle2[i], chargeProd[i], exceptionSigma[i], exceptionEpsilon[i]);
+    for (int i = 0; i < force.getNumExceptionParameterOffsets(); i++) {
+        string param;
+        int exception;
+        double chargeProdScale, sigmaScale, epsilonScale;
+        force.getExceptionParameterOffset(i, param, exception, chargeProdScale, sigmaScale, epsilonScale);
+        double value = values.at(param);
+        chargeProd[exception] += value*chargeProdScale;
+        exceptionSigma[exception] += value*sigmaScale;
+        exceptionEpsilon[exception] += value*epsilonScale;
+    }
+    auto pairEnergy = [&] (int i, int j, double chargeProd, double sigma, double epsilon) {
+        Vec3 delta = positions[j]-positions[i];
+        double r = sqrt(delta.dot(delta));
+        double x = sigma/r;
+        return ONE_4PI_EPS0*chargeProd/r + 4.0*epsilon*(pow(x, 12.0)-pow(x, 6.0));
+    };
+    double energy = 0.0;
+    set<pair<int, int> > excluded;
+    for (int i = 0; i < numExceptions; i++) {
+        excluded.insert(make_pair(min(particle1[i], particle2[i]), max(particle1[i], particle2[i])));
+        energy += pairEnergy(particle1[i], particle2[i], chargeProd[i], exceptionSigma[i], exceptionEpsilon[i]);
+    }
+    for (int i = 0; i < numParticles; i++)
+        for (int j = i+1; j < numParticles; j++)
+            if (excluded.find(make_pair(i, j)) == excluded.end())
+                energy += pairEnergy(i, j, charge[i]*charge[j], 0.5*(sigma[i]+sigma[j]), sqrt(epsilon[i]*epsilon[j]));
+    return energy;
+}
+
+void testChangingOffsetParameters() {
+    // Particle 0 and exception 0 have several offsets for the same parameter, which must be added together.
+
+    System system;
+    for (int i = 0; i < 4; i++)
+        system.addParticle(1.0);
+    NonbondedForce* force = new NonbondedForce();
+    force->addParticle(0.2, 0.3, 0.5);
+    force->addParticle(-0.4, 0.35, 0.6);
+    force->addParticle(0.3, 0.4, 0.4);
+    force->addParticle(-0.1, 0.3, 0.5);
+    force->addException(1, 2, 0.1, 0.3, 0.2);
+    force->addException(0, 3, 0.0, 1.0, 0.0);
+    force->addGlobalParameter("a", 0.0);
+    force->addGlobalParameter("b", 0.0);
+    force->addParticleParameterOffset("a", 0, 0.5, 0.1, 0.2);
+    force->addParticleParameterOffset("b", 0, -0.3, 0.05, 0.0);
+    force->addParticleParameterOffset("a", 0, 0.25, 0.0, 0.1);
+    force->addParticleParameterOffset("b", 1, 0.1, 0.0, 0.3);
+    force->addExceptionParameterOffset("a", 0, 0.2, 0.01, 0.1);
+    force->addExceptionParameterOffset("b", 0, 0.1, 0.0, 0.05);
+    force->addExceptionParameterOffset("a", 0, 0.05, 0.02, 0.0);
+    system.addForce(force);
+    vector<Vec3> positions = {Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(2, 0, 0), Vec3(0, 1.5, 0)};
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    map<string, double> values = {{"a", 0.0}, {"b", 0.0}};
+    ASSERT_EQUAL_TOL(computeEnergyWithOffsets(*force, positions, values), context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // Change one parameter at a time, so only the particles and exceptions that depend on it get updated.
+
+    vector<pair<string, double> > changes = {{"a", 0.5}, {"b", -0.3}, {"a", 1.0}, {"a", 0.0}, {"b", 0.7}, {"b", 0.7}};
+    for (auto& change : changes) {
+        context.setParameter(change.first, change.second);
+        values[change.first] = change.second;
+        ASSERT_EQUAL_TOL(computeEnergyWithOffsets(*force, positions, values), context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    }
+
+    // Changing the base parameters should combine them with the current values of the global parameters.
+
+    force->setParticleParameters(0, 0.1, 0.32, 0.45);
+    force->setParticleParameters(2, 0.15, 0.45, 0.3);
+    force->setExceptionParameters(0, 1, 2, 0.2, 0.3, 0.1);
+    force->updateParametersInContext(context);
+    ASSERT_EQUAL_TOL(computeEnergyWithOffsets(*force, positions, values), context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    context.setParameter("a", 0.3);
+    values["a"] = 0.3;
+    ASSERT_EQUAL_TOL(computeEnergyWithOffsets(*force, positions, values), context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+}
+
+/**
+ * Create a System containing a NonbondedForce whose particle and exception parameters depend on two
+ * global parameters through offsets.  It is shared by the tests of methods that deal with offsets.
+ * If offsets is false, the global parameters and offsets are omitted, so the System only has fixed
+ * parameters.
+ */
+NonbondedForce* createSystemWithOffsets(System& system, vector<Vec3>& positions, NonbondedForce::NonbondedMethod method, bool offsets=true) {
+    const int gridSize = 4;
+    const double spacing = 0.75;
+    const double boxSize = gridSize*spacing;
+    NonbondedForce* force = new NonbondedForce();
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    positions.clear();
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                int index = system.addParticle(1.0);
+                force->addParticle(index%2 == 0 ? 0.5 : -0.5, 0.25+0.05*(index%3), 0.4+0.1*(index%4));
+                positions.push_back(Vec3(i*spacing+0.1*genrand_real2(sfmt), j*spacing+0.1*genrand_real2(sfmt), k*spacing+0.1*genrand_real2(sfmt)));
+            }
+
+    // Even numbered exceptions are 1-4 interactions, odd numbered ones are exclusions.
+
+    int numParticles = system.getNumParticles();
+    for (int i = 0; i+2 < numParticles; i += 4) {
+        force->addException(i, i+1, 0.1, 0.3, 0.2);
+        force->addException(i+1, i+2, 0.0, 1.0, 0.0);
+    }
+    if (offsets) {
+        force->addGlobalParameter("lambda", 0.5);
+        force->addGlobalParameter("eta", 0.2);
+        for (int i = 0; i < numParticles; i += 5)
+            force->addParticleParameterOffset("lambda", i, -0.4, 0.05, 0.1);
+        for (int i = 0; i < numParticles; i += 7)
+            force->addParticleParameterOffset("eta", i, 0.3, 0.0, 0.2);
+        force->addExceptionParameterOffset("lambda", 0, 0.5, 0.1, 0.3);
+        force->addExceptionParameterOffset("eta", 3, 0.2, 0.0, 0.0);
+    }
+    force->setNonbondedMethod(method);
+    force->setCutoffDistance(1.0);
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    system.addForce(force);
+    return force;
+}
+
+void testComputeEnergies(NonbondedForce::NonbondedMethod method) {
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, method);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    double initialEnergy = context.getState(State::Energy).getPotentialEnergy();
+    vector<vector<double> > allStates = {{0.0, 0.0}, {0.5, 0.2}, {1.0, 0.0}, {0.3, 0.9}, {1.0, 1.0}, {-0.2, 0.6}, {0.8, -0.1}, {0.1, 0.4}};
+
+    // With few states every one is evaluated directly, while with many the reciprocal space energy
+    // is reconstructed from a basis.  Check both.
+
+    for (int numStates : {2, (int) allStates.size()}) {
+        vector<vector<double> > states(allStates.begin(), allStates.begin()+numStates);
+        vector<double> energies;
+        force->computeEnergiesInContext(context, states, energies);
+        ASSERT_EQUAL(numStates, (int) energies.size());
+
+        // The parameters stored in the Context should not have changed.
+
+        ASSERT_EQUAL(0.5, context.getParameter("lambda"));
+        ASSERT_EQUAL(0.2, context.getParameter("eta"));
+        ASSERT_EQUAL_TOL(initialEnergy, context.getState(State::Energy).getPotentialEnergy(), 1e-10);
+
+        // Compare each energy to setting the parameters and computing the energy the usual way.
+
+        for (int i = 0; i < numStates; i++) {
+            context.setParameter("lambda", states[i][0]);
+            context.setParameter("eta", states[i][1]);
+            ASSERT_EQUAL_TOL(context.getState(State::Energy).getPotentialEnergy(), energies[i], 1e-6);
+        }
+        context.setParameter("lambda", 0.5);
+        context.setParameter("eta", 0.2);
+    }
+}
+
+void testPartialParameterUpdates(NonbondedForce::NonbondedMethod method, bool offsets) {
+    // Modify a few particles and exceptions scattered through the System, then copy them to three Contexts:
+    // one with a full update, one with ranges, and one with lists of indices.  They should all agree with
+    // each other and with a Context created from scratch.  Without offsets, the Ewald self energy is updated
+    // incrementally rather than recomputed, so test both cases.
+
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, method, offsets);
+    force->setUseDispersionCorrection(true);
+    VerletIntegrator integrator1(0.001), integrator2(0.001), integrator3(0.001);
+    Context fullContext(system, integrator1, platform);
+    Context rangeContext(system, integrator2, platform);
+    Context listContext(system, integrator3, platform);
+    fullContext.setPositions(positions);
+    rangeContext.setPositions(positions);
+    listContext.setPositions(positions);
+    double initialEnergy = fullContext.getState(State::Energy).getPotentialEnergy();
+    vector<int> particles = {0, 17, 63};
+    vector<int> exceptions = {0, 12, 30};
+    for (int i : particles) {
+        double charge, sigma, epsilon;
+        force->getParticleParameters(i, charge, sigma, epsilon);
+        force->setParticleParameters(i, -charge, 1.1*sigma, 0.5*epsilon);
+    }
+    for (int i : exceptions) {
+        int particle1, particle2;
+        double chargeProd, sigma, epsilon;
+        force->getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
+        force->setExceptionParameters(i, particle1, particle2, chargeProd+0.2, 0.9*sigma, 2.0*epsilon);
+    }
+    force->updateParametersInContext(fullContext);
+    force->updateParametersInContext(rangeContext, particles.front(), particles.back(), exceptions.front(), exceptions.back());
+    force->updateParametersInContext(listContext, particles, exceptions);
+    State fullState = fullContext.getState(State::Forces | State::Energy);
+    ASSERT(fabs(fullState.getPotentialEnergy()-initialEnergy) > 1.0);
+    VerletIntegrator integrator4(0.001);
+    Context freshContext(system, integrator4, platform);
+    freshContext.setPositions(positions);
+    for (Context* context : {&rangeContext, &listContext, &freshContext}) {
+        State state = context->getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(fullState.getPotentialEnergy(), state.getPotentialEnergy(), 1e-5);
+        for (int i = 0; i < system.getNumParticles(); i++)
+            ASSERT_EQUAL_VEC(fullState.getForces()[i], state.getForces()[i], 1e-5);
+    }
+
+    // Indices that are out of range should be rejected.
+
+    bool threwException = false;
+    try {
+        force->updateParametersInContext(listContext, {system.getNumParticles()}, {});
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+void testUpdatingCharges(NonbondedForce::NonbondedMethod method, bool offsets) {
+    // Change the charges several times, copying them to one Context with updateChargesInContext() and to another
+    // with updateParametersInContext().  With Ewald and PME, the self energy is updated incrementally unless there
+    // are offsets, so also compare to a Context created from scratch after the last change.
+
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, method, offsets);
+    VerletIntegrator integrator1(0.001), integrator2(0.001);
+    Context chargeContext(system, integrator1, platform);
+    Context parameterContext(system, integrator2, platform);
+    chargeContext.setPositions(positions);
+    parameterContext.setPositions(positions);
+    vector<int> particles = {1, 8, 33, 62};
+    vector<int> exceptions = {2, 20};
+    for (int round = 0; round < 3; round++) {
+        for (int i : particles) {
+            double charge, sigma, epsilon;
+            force->getParticleParameters(i, charge, sigma, epsilon);
+            force->setParticleParameters(i, charge+0.3*(round+1), sigma, epsilon);
+        }
+        for (int i : exceptions) {
+            int particle1, particle2;
+            double chargeProd, sigma, epsilon;
+            force->getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
+            force->setExceptionParameters(i, particle1, particle2, chargeProd-0.1, sigma, epsilon);
+        }
+        force->updateChargesInContext(chargeContext, particles, exceptions);
+        force->updateParametersInContext(parameterContext, particles, exceptions);
+        State state1 = chargeContext.getState(State::Forces | State::Energy);
+        State state2 = parameterContext.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(state2.getPotentialEnergy(), state1.getPotentialEnergy(), 1e-5);
+        for (int i = 0; i < system.getNumParticles(); i++)
+            ASSERT_EQUAL_VEC(state2.getForces()[i], state1.getForces()[i], 1e-5);
+    }
+    VerletIntegrator integrator3(0.001);
+    Context freshContext(system, integrator3, platform);
+    freshContext.setPositions(positions);
+    State state1 = chargeContext.getState(State::Forces | State::Energy);
+    State state3 = freshContext.getState(State::Forces | State::Energy);
+    ASSERT_EQUAL_TOL(state3.getPotentialEnergy(), state1.getPotentialEnergy(), 1e-5);
+    for (int i = 0; i < system.getNumParticles(); i++)
+        ASSERT_EQUAL_VEC(state3.getForces()[i], state1.getForces()[i], 1e-5);
+}
+
+void testRejectedPartialUpdates() {
+    // A partial update that fails should leave the Context unchanged, even if some of the listed particles
+    // were valid.
+
+    System system;
+    vector<Vec3> positions;
+    NonbondedForce* force = createSystemWithOffsets(system, positions, NonbondedForce::PME, false);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    double initialEnergy = context.getState(State::Energy).getPotentialEnergy();
+    double charge, sigma, epsilon;
+    force->getParticleParameters(0, charge, sigma, epsilon);
+    force->setParticleParameters(0, -charge, sigma, 2.0*epsilon);
+    int particle1, particle2;
+    double chargeProd;
+    force->getExceptionParameters(2, particle1, particle2, chargeProd, sigma, epsilon);
+    force->setExceptionParameters(2, particle1, particle2+1, chargeProd, sigma, epsilon);
+    for (int update = 0; update < 2; update++) {
+        bool threwException = false;
+        try {
+            if (update == 0)
+                force->updateChargesInContext(context, {0}, {2});
+            else
+                force->updateParametersInContext(context, {0}, {2});
+        }
+        catch (const OpenMMException& ex) {
+            threwException = true;
+        }
+        ASSERT(threwException);
+        ASSERT_EQUAL_TOL(initialEnergy, context.getState(State::Energy).getPotentialEnergy(), 1e-6);
+    }
+}
+
+void testDispersionCorrectionUpdates() {
+    // Create two copies of the same System, one with the dispersion correction and one without.  The difference
+    // between their energies is the correction, which is compared to computing it from scratch.
+
+    System system1, system2;
+    vector<Vec3> positions;
+    NonbondedForce* force1 = createSystemWithOffsets(system1, positions, NonbondedForce::CutoffPeriodic);
+    NonbondedForce* force2 = createSystemWithOffsets(system2, positions, NonbondedForce::CutoffPeriodic);
+    force1->setUseDispersionCorrection(true);
+    force2->setUseDispersionCorrection(false);
+    VerletIntegrator integrator1(0.001), integrator2(0.001);
+    Context context1(system1, integrator1, platform);
+    Context context2(system2, integrator2, platform);
+    context1.setPositions(positions);
+    context2.setPositions(positions);
+    Vec3 a, b, c;
+    system1.getDefaultPeriodicBoxVectors(a, b, c);
+    double volume = a[0]*b[1]*c[2];
+    auto checkCorrection = [&] (double lambda) {
+        force1->setGlobalParameterDefaultValue(0, lambda);
+        double expected = NonbondedForceImpl::calcDispersionCorrection(system1, *force1)/volume;
+        context1.setParameter("lambda", lambda);
+        context2.setParameter("lambda", lambda);
+        double energy1 = context1.getState(State::Energy).getPotentialEnergy();
+        double energy2 = context2.getState(State::Energy).getPotentialEnergy();
+        ASSERT_EQUAL_TOL(expected, energy1-energy2, 1e-4);
+    };
+
+    // Changing lambda moves the particles that have offsets between classes.
+
+    for (double lambda : {0.5, 0.0, 0.25, 1.0, 0.5})
+        checkCorrection(lambda);
+
+    // Update particles one at a time.  The classes are rebuilt after more incremental updates than there are
+    // classes, which happens several times here.
+
+    for (int i = 0; i < 100; i++) {
+        int particle = (7*i)%system1.getNumParticles();
+        double charge, sigma, epsilon;
+        force1->getParticleParameters(particle, charge, sigma, epsilon);
+        sigma = 0.25+0.02*(i%6);
+        epsilon = 0.3+0.1*(i%5);
+        force1->setParticleParameters(particle, charge, sigma, epsilon);
+        force2->setParticleParameters(particle, charge, sigma, epsilon);
+        force1->updateParametersInContext(context1, {particle}, {});
+        force2->updateParametersInContext(context2, {particle}, {});
+        if (i%10 == 9)
+            checkCorrection(i%20 == 9 ? 0.5 : 0.8);
+    }
+}
+
+void testForceErrorEstimate(NonbondedForce::NonbondedMethod method) {
+    const int gridSize = 8;
+    const int numParticles = gridSize*gridSize*gridSize;
+    const double boxSize = 3.2;
+    const double spacing = boxSize/gridSize;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* force = new NonbondedForce();
+    force->setNonbondedMethod(method);
+    force->setCutoffDistance(1.0);
+    system.addForce(force);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<Vec3> positions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        force->addParticle(genrand_real2(sfmt) < 0.5 ? 0.5 : -0.5, 0.3, 0.5);
+        Vec3 jitter(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5);
+        positions[i] = Vec3(i%gridSize, (i/gridSize)%gridSize, i/(gridSize*gridSize))*spacing + jitter*0.1;
+    }
+    for (int i = 0; i < numParticles-1; i += 2)
+        force->addException(i, i+1, 0.0, 1.0, 0.0);
+
+    // The relative error should stay below the tolerance, and shrink as the tolerance does.
+
+    double lastError = 0.0;
+    for (double tolerance : {1e-3, 1e-4, 1e-5}) {
+        force->setEwaldErrorTolerance(tolerance);
+        VerletIntegrator integrator(0.001);
+        Context context(system, integrator, platform);
+        context.setPositions(positions);
+        double rmsError, rmsForce;
+        force->estimateForceErrorInContext(context, rmsError, rmsForce, 50);
+        ASSERT(rmsForce > 0.0);
+        ASSERT(rmsError/rmsForce < tolerance);
+        if (lastError > 0.0)
+            ASSERT(rmsError < lastError);
+        lastError = rmsError;
+    }
+
+    // The number of samples must be positive.
+
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    bool threwException = false;
+    try {
+        double rmsError, rmsForce;
+        force->estimateForceErrorInContext(context, rmsError, rmsForce, 0);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
 void runPlatformTests();
 
 int main(int argc, char* argv[]) {
@@ -908,11 +1424,29 @@ int main(int argc, char* argv[]) {
         testTriclinic();
         testLargeSystem();
         testDispersionCorrection();
+        testDispersionCorrectionUpdates();
         testChangingParameters();
         testSwitchingFunction(NonbondedForce::CutoffNonPeriodic);
         testSwitchingFunction(NonbondedForce::PME);
         testTwoForces();
         testParameterOffsets();
+        testChangingOffsetParameters();
+        testNeighborListUpdates(NonbondedForce::CutoffNonPeriodic);
+        testNeighborListUpdates(NonbondedForce::CutoffPeriodic);
+        testNeighborListUpdates(NonbondedForce::PME);
+        testPartialParameterUpdates(NonbondedForce::PME, true);
+        testPartialParameterUpdates(NonbondedForce::Ewald, false);
+        testPartialParameterUpdates(NonbondedForce::PME, false);
+        testPartialParameterUpdates(NonbondedForce::LJPME, false);
+        testUpdatingCharges(NonbondedForce::CutoffPeriodic, true);
+        testUpdatingCharges(NonbondedForce::Ewald, true);
+        testUpdatingCharges(NonbondedForce::PME, true);
+        testUpdatingCharges(NonbondedForce::Ewald, false);
+        testUpdatingCharges(NonbondedForce::PME, false);
+        testUpdatingCharges(NonbondedForce::LJPME, false);
+        testRejectedPartialUpdates();
+        testForceErrorEstimate(NonbondedForce::Ewald);
+        testForceErrorEstimate(NonbondedForce::PME);
         runPlatformTests();
     }
     catch(const exception& e) {